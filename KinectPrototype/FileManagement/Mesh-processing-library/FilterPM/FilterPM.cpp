@@ -15,6 +15,8 @@
 #include "VertexCache.h"
 #include "A3dStream.h"
 #include "StringOp.h"
+#include "Parallel.h"           // parallel_for_each()
+#include "BinaryIO.h"           // write_aligned_header(), write_little_endian()
 
 #define DEF_SR
 
@@ -29,11 +31,13 @@ namespace {
 const bool sdebug = getenv_bool("FILTERPM_DEBUG");
 
 bool nooutput = false;
+bool indexed = false;
 int verb = 1;
 bool gzip = false;
 string gfilename;
 
 PMesh pmesh;
+unique_ptr<MappedPMesh> mapped_pmesh; // if the input file is indexed
 unique_ptr<PMeshRStream> pmrs;
 unique_ptr<PMeshIter> pmi;
 
@@ -153,6 +157,38 @@ void do_outmesh() {
     nooutput = true;
 }
 
+// Output meshes at several levels of detail using a single traversal of the vsplit records.
+// Each target is a number of vertices, or a number of faces if prefixed by 'f'; its mesh is written to
+//  fileprefix.target.m (e.g. "fileprefix.f5000.m").  Targets listed from coarse to fine are reached in one forward
+//  pass.  The meshes are copied during the traversal, and then converted and written concurrently.
+void do_outlods(Args& args) {
+    Array<string> targets; {
+        std::istringstream iss(args.get_string());
+        for (string s; iss >> s; ) targets.push(s);
+    }
+    string fileprefix = args.get_filename();
+    Array<WMesh> meshes(targets.num());
+    {
+        HH_TIMER(_lods_goto);
+        for_int(i, targets.num()) {
+            const string& s = targets[i];
+            bool is_nfaces = s[0]=='f';
+            int n = Args::parse_int(s.substr(is_nfaces));
+            if (is_nfaces) pmi->goto_nfaces(n); else pmi->goto_nvertices(n);
+            meshes[i] = *pmi;
+            do_info();
+        }
+    }
+    HH_TIMER(_lods_write);
+    parallel_for_each(range(targets.num()), [&](const int i) {
+        GMesh gmesh; meshes[i].extract_gmesh(gmesh, pmi->rstream()._info);
+        meshes[i] = WMesh();
+        WFile fo(fileprefix + "." + targets[i] + ".m");
+        gmesh.write(fo());
+    });
+    nooutput = true;
+}
+
 void do_geom_nfaces(Args& args) {
     int nfaces = args.get_int();
     Geomorph geomorph; {
@@ -330,6 +366,66 @@ void do_srfly(Args& args) {
     nooutput = true;
 }
 
+// Write an extracted view as a line "SRIndexBuffer", a line "version=1 nvertices=n nfaces=m endian=little" (padded
+//  with spaces so that the data lies at a multiple of 16 bytes from the start of the first line), and then
+//  float[n][3] points, float[n][3] normals, and int[m][3] vertex indices, all in little-endian byte order.
+void write_index_buffers(std::ostream& os, CArrayView<Point> points, CArrayView<Vector> normals,
+                         CArrayView<Vec3<int>> faces) {
+    write_aligned_header(os, "SRIndexBuffer\n" +
+                         sform("version=1 nvertices=%d nfaces=%d endian=little", points.num(), faces.num()));
+    write_little_endian(os, points.data()->data(), size_t(points.num())*3);
+    write_little_endian(os, normals.data()->data(), size_t(normals.num())*3);
+    write_little_endian(os, faces.data()->data(), size_t(faces.num())*3);
+    assertx(os);
+}
+
+// Extract a view-dependent mesh for each frame of a file and write its index buffers to fileprefix.<i>.sri.
+// The views are adapted in sequence, each starting from the active front of the previous one (which is cheap for
+//  coherent views); the buffers of a group of views are then written concurrently.
+void do_srbatch(Args& args) {
+    RFile fiframes(args.get_filename());
+    float screen_thresh = args.get_float();
+    string fileprefix = args.get_filename();
+    Array<SRViewParams> views;
+    for (;;) {
+        Frame frame; int obn; float zoomx; bool bin;
+        if (!FrameIO::read(fiframes(), frame, obn, zoomx, bin)) break;
+        SRViewParams view;
+        view.set_frame(frame);
+        view.set_zooms(twice(zoomx));
+        view.set_screen_thresh(screen_thresh);
+        view.set_hither(0.f);
+        views.push(view);
+    }
+    read_srmesh();
+    HH_TIMER(_srbatch);
+    struct ViewBuffers { Array<Point> points; Array<Vector> normals; Array<Vec3<int>> faces; };
+    const int group_size = 4*get_max_threads();
+    Array<ViewBuffers> buffers(min(group_size, views.num()));
+    double adapt_time = 0.;
+    for (int i0 = 0; i0<views.num(); i0 += group_size) {
+        const int n = min(group_size, views.num()-i0);
+        {
+            Timer timer;
+            for_int(i, n) {
+                srmesh.set_view_params(views[i0+i]);
+                srmesh.adapt_refinement();
+                ViewBuffers& b = buffers[i];
+                srmesh.extract_indexed(b.points, b.normals, b.faces);
+                HH_SSTAT(Sbatchnfaces, b.faces.num());
+            }
+            timer.stop(); adapt_time += timer.real();
+        }
+        parallel_for_each(range(n), [&](const int i) {
+            WFile fo(sform("%s.%d.sri", fileprefix.c_str(), i0+i));
+            write_index_buffers(fo(), buffers[i].points, buffers[i].normals, buffers[i].faces);
+        });
+    }
+    showdf("%d views adapted and extracted in %.2fs: %.1f views/sec\n",
+           views.num(), adapt_time, views.num()/max(adapt_time, 1e-6));
+    nooutput = true;
+}
+
 void do_tosrm() {
     HH_TIMER(_tosrm);
     {
@@ -1498,11 +1594,13 @@ int main(int argc, const char** argv) {
     ARGSD(minfo,                ": output more stats on current mesh");
     ARGSD(outmesh,              ": output mesh");
     ARGSD(geom_nfaces,          "nf : output geomorph up to nf faces");
+    ARGSD(outlods,              "'nv1 nv2 fnf3 ...' fileprefix : write meshes to fileprefix.{nv1,fnf3}.m");
     ARGSC("",                   ":** Output selectively refined meshes and geomorphs");
     ARGSD(srout,                "'frame' srthresh : create SR mesh");
     ARGSD(srgeomorph,           "{'frame' srthresh} *2 : create SR geomorph");
     ARGSD(srfgeo,               "rtime ctime :  set fly parameters");
     ARGSD(srfly,                "file.frames scthresh : (for timing)");
+    ARGSD(srbatch,              "file.frames srthresh fileprefix : write SR index buffers for each frame");
     ARGSD(tosrm,                ": convert to .srm format");
     ARGSC("",                   ":** Modify progressive mesh");
     ARGSD(truncate_beyond,      ": truncate PM beyond current mesh");
@@ -1537,6 +1635,7 @@ int main(int argc, const char** argv) {
     ARGSD(polystream,           ": for progressive hull, refine polygons");
     ARGSD(uvsphtopos,           ": transfer uv longlat to sphere pos");
     ARGSF(nooutput,             ": do not output final PM");
+    ARGSF(indexed,              ": output PM with a vsplit index (for memory-mapped reading)");
     HH_TIMER(FilterPM);
     string arg0 = args.num() ? args.peek_string() : "";
     string filename = "-"; if (args.num() && (arg0=="-" || arg0[0]!='-')) filename = args.get_filename();
@@ -1556,6 +1655,11 @@ int main(int argc, const char** argv) {
         } else if (srm_input) {
             nooutput = true;
             pfi = &fi;
+        } else if (MappedPMesh::is_indexed(filename)) {
+            // Vsplit records are decoded from the memory-mapped file only as they are needed.
+            mapped_pmesh = make_unique<MappedPMesh>(filename);
+            pmrs = make_unique<PMeshRStream>(*mapped_pmesh, &pmesh);
+            pmi = make_unique<PMeshIter>(*pmrs);
         } else {
             pmrs = make_unique<PMeshRStream>(fi(), &pmesh);
             pmi = make_unique<PMeshIter>(*pmrs);
@@ -1564,10 +1668,15 @@ int main(int argc, const char** argv) {
     args.parse();
     if (!nooutput) {
         ensure_pm_loaded();
-        pmesh.write(std::cout);
+        if (indexed) {
+            pmesh.write_indexed(std::cout);
+        } else {
+            pmesh.write(std::cout);
+        }
     }
     pmi = nullptr;
     pmrs = nullptr;
+    mapped_pmesh = nullptr;
     hh_clean_up();
     return 0;
 }
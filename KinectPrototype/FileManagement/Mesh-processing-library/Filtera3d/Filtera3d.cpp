@@ -15,6 +15,7 @@
 #include "Array.h"
 #include "Vec.h"
 #include "MathOp.h"
+#include "BinaryPoints.h"       // for -tobinpts
 using namespace hh;
 
 namespace {
@@ -59,6 +60,9 @@ double frdelay = 0.;
 double eldelay = 0.;
 bool toasciit = false;          // "toascii" seems to be a reserved identifier in Win32
 bool tobinary = false;
+bool tobinpts = false;
+Array<Point> g_binpts;          // for tobinpts
+Array<Vector> g_binnors;
 int minverts = 0;
 
 int ndegen = 0;
@@ -239,7 +243,24 @@ void compute_stats(const A3dElem& el) {
 
 // output element
 void output_element(const A3dElem& el) {
-    if (!nooutput) oa3d.write(el);
+    if (nooutput) return;
+    if (tobinpts) {
+        if (el.type()==A3dElem::EType::point) {
+            g_binpts.push(el[0].p); g_binnors.push(el[0].n);
+        } else if (el.type()!=A3dElem::EType::comment) {
+            Warning("Non-point element not output by -tobinpts");
+        }
+        return;
+    }
+    oa3d.write(el);
+}
+
+void write_binpts() {
+    bool have_normals = false;
+    for (const Vector& n : g_binnors) { if (!is_zero(n)) { have_normals = true; break; } }
+    if (!have_normals) g_binnors.init(0);
+    write_binary_points(std::cout, g_binpts, g_binnors);
+    std::cout.flush();
 }
 
 // split element and output statistics
@@ -784,6 +805,7 @@ int main(int argc, const char** argv) {
     ARGSP(eldelay,              "fsec : pause after each element");
     ARGSF(toasciit,             ": make output be ascii text");
     ARGSF(tobinary,             ": make output be binary");
+    ARGSF(tobinpts,             ": output points in packed binary format (for Recon, Meshfit, Subdivfit)");
     string arg0 = args.num() ? args.peek_string() : "";
     string filename = "-"; if (args.num() && (arg0=="-" || arg0[0]!='-')) filename = args.get_filename();
     RFile is(filename);
@@ -823,6 +845,7 @@ int main(int argc, const char** argv) {
     if (toasciit) my_setenv("A3D_BINARY", "0");
     if (tobinary) my_setenv("A3D_BINARY", "1");
     process(ia3d);
+    if (tobinpts && !nooutput) write_binpts();
     hh_clean_up();
     return 0;
 }
@@ -3,6 +3,7 @@
 
 #include "Args.h"
 #include "GMesh.h"
+#include "CompactMesh.h"
 #include "MeshOp.h"             // Vnors, ...
 #include "A3dStream.h"
 #include "FileIO.h"
@@ -26,6 +27,7 @@
 #include "BinarySearch.h"
 #include "LLS.h"
 #include "MeshSearch.h"         // PolygonFaceSpatial
+#include "TriangleBvh.h"
 #include "Contour.h"
 #include "Facedistance.h"
 #include "Image.h"
@@ -33,6 +35,7 @@
 #include "StringOp.h"
 #include "RangeOp.h"
 #include "MathOp.h"
+#include "Parallel.h"           // parallel_for_each()
 #if !defined(HH_NO_SIMPLEX)
 #include "recipes.h"
 #endif
@@ -52,6 +55,7 @@ float cosangle = k_undefined_cosangle;
 float solidangle = 0.f;
 float checkflat = 0.f;
 bool nooutput = false;
+bool binarymesh = getenv_bool("MESH_BINARY"); // mesh output format
 bool nocleanup = false;
 bool bndmerge = false;
 float raymaxdispfrac = .03f;
@@ -683,6 +687,14 @@ void do_setb3d() {
     my_setenv("A3D_BINARY", "1");
 }
 
+void do_setbinarymesh() {
+    binarymesh = true;
+}
+
+void do_settextmesh() {
+    binarymesh = false;
+}
+
 
 // *** toa3d, tob3d
 
@@ -748,20 +760,20 @@ void do_merge(Args& args) {
 
 void do_outmesh() {
     HH_TIMER(_outmesh);
-    mesh.write(std::cout);
+    mesh.write(std::cout, binarymesh);
 }
 
 void do_addmesh() {
     HH_TIMER(_addmesh);
     A3dElem el(A3dElem::EType::endfile);
     oa3d.write(el);
-    mesh.write(std::cout);
+    mesh.write(std::cout, binarymesh);
 }
 
 void do_writemesh(Args& args) {
     string filename = args.get_filename();
     WFile fi(filename);
-    mesh.write(fi());
+    mesh.write(fi(), binarymesh);
 }
 
 void do_record() {
@@ -1173,6 +1185,25 @@ void do_silsubdiv() {
 
 // *** Taubin
 
+// Flat (CSR) vertex adjacency, extracted once so that smoothing sweeps run in parallel over contiguous arrays.
+struct VertexRings {
+    explicit VertexRings(const GMesh& m) {
+        Map<Vertex,int> mvi;
+        va.reserve(m.num_vertices());
+        for (Vertex v : m.vertices()) { mvi.enter(v, va.num()); va.push(v); }
+        ring_beg.init(va.num()+1);
+        ring_beg[0] = 0;
+        ring.reserve(m.num_edges()*2);
+        for_int(i, va.num()) {
+            for (Vertex vv : m.vertices(va[i])) ring.push(mvi.get(vv));
+            ring_beg[i+1] = ring.num();
+        }
+    }
+    Array<Vertex> va;
+    Array<int> ring_beg;        // neighbors of va[i] are ring[ring_beg[i]] .. ring[ring_beg[i+1]-1]
+    Array<int> ring;
+};
+
 void do_taubinsmooth(Args& args) {
     HH_TIMER(_taubinsmooth);
     int niter = args.get_int();
@@ -1186,34 +1217,34 @@ void do_taubinsmooth(Args& args) {
         //  as seen on cat mesh.
         lambda = 0.33f; mu = -0.34f;
     }
+    const VertexRings rings(mesh);
+    const int nv = rings.va.num();
+    Array<bool> is_new(nv);
     int nnewv = 0;
-    for (Vertex v : mesh.vertices()) {
-        if (GMesh::string_has_key(mesh.get_string(v), "newvertex")) nnewv++;
+    for_int(i, nv) {
+        is_new[i] = GMesh::string_has_key(mesh.get_string(rings.va[i]), "newvertex");
+        if (is_new[i]) nnewv++;
     }
     if (nnewv) Warning("Only smoothing new vertices");
-    Map<Vertex,Point> mvp;
-    for (Vertex v : mesh.vertices()) { mvp.enter(v, Point()); }
+    Array<Point> pa(nv), pnew(nv);
+    for_int(i, nv) { pa[i] = mesh.point(rings.va[i]); }
     // HH: introduced the factor *2 on niter on 1999-01-04.
-    for_int(i, niter*2) {
-        float disp = i%2==0 ? lambda : mu;
-        for (Vertex v : mesh.vertices()) {
+    for_int(iter, niter*2) {
+        float disp = iter%2==0 ? lambda : mu;
+        parallel_for_each(range(nv), [&](const int i) {
             Homogeneous h;
-            int n = 0;
-            for (Vertex vv : mesh.vertices(v)) {
-                h += mesh.point(vv);
-                n++;
-            }
-            h += float(-n)*Homogeneous(mesh.point(v));
+            const int n = rings.ring_beg[i+1]-rings.ring_beg[i];
+            for_intL(j, rings.ring_beg[i], rings.ring_beg[i+1]) { h += pa[rings.ring[j]]; }
+            h += float(-n)*Homogeneous(pa[i]);
             assertx(n);
             h /= float(n);
             Vector vec = to_Vector(h)*disp;
-            if (nnewv && !GMesh::string_has_key(mesh.get_string(v), "newvertex"))
-                vec = Vector(0.f, 0.f, 0.f);
-            Point p = mesh.point(v)+vec;
-            mvp.get(v) = p;
-        }
-        for (Vertex v : mesh.vertices()) { mesh.set_point(v, mvp.get(v)); }
+            if (nnewv && !is_new[i]) vec = Vector(0.f, 0.f, 0.f);
+            pnew[i] = pa[i]+vec;
+        }, uint64_t{100});
+        swap(pa, pnew);
     }
+    for_int(i, nv) { mesh.set_point(rings.va[i], pa[i]); }
 }
 
 // *** Desbrun
@@ -1238,6 +1269,7 @@ void do_desbrunsmooth(Args& args) {
     Map<Vertex,int> m_vi;
     for (Vertex v : mesh.vertices()) { m_vi.enter(v, a_v.num()); a_v.push(v); }
     SparseLLS lls(a_v.num(), a_v.num(), 3);
+    lls.set_preconditioned(true); // the system is diagonally dominant, so Jacobi PCG converges quickly
     lls.set_tolerance(1e-6f); lls.set_verbose(1);
     Array<int> nei_vi;
     Array<float> nei_w;
@@ -2380,6 +2412,155 @@ void do_stat() {
     nooutput = true;
 }
 
+// Same statistics as do_info(), for a nice triangle mesh held in a CompactMesh.
+void compact_info(const CompactMesh& cmesh) {
+    const int nv = cmesh.num_vertices(), nf = cmesh.num_faces(), nh = nf*3;
+    auto point = [&](int v) -> const Point& { return cmesh.point(v); };
+    Stat Sloops;                // number of edges in each boundary loop
+    {
+        Array<bool> visited(nh, false);
+        for_int(h0, nh) {
+            if (!cmesh.is_boundary_hedge(h0) || visited[h0]) continue;
+            int n = 0;
+            // The most clockwise outgoing half-edge of the next boundary vertex continues the loop.
+            for (int h = h0; !visited[h]; h = cmesh.vertex_hedge(cmesh.vertex2(h))) { visited[h] = true; n++; }
+            Sloops.enter(n);
+        }
+    }
+    Stat Scomps;                // number of faces in each edge-connected component
+    {
+        Array<bool> visited(nf, false);
+        Array<int> stack;
+        for_int(f0, nf) {
+            if (visited[f0]) continue;
+            visited[f0] = true; stack.push(f0);
+            int n = 0;
+            while (stack.num()) {
+                int f = stack.pop(); n++;
+                for_int(j, 3) {
+                    int ho = cmesh.opp(CompactMesh::hedge(f, j));
+                    if (ho<0 || visited[CompactMesh::hedge_face(ho)]) continue;
+                    visited[CompactMesh::hedge_face(ho)] = true; stack.push(CompactMesh::hedge_face(ho));
+                }
+            }
+            Scomps.enter(n);
+        }
+    }
+    {
+        const int ne = cmesh.num_edges(), nb = Sloops.inum(), nc = Scomps.inum();
+        int ec = nv-ne+nf;      // euler characteristic
+        float genus = (nc*2-ec-nb)/2.f;
+        int ncv = 0;            // (the mesh has no Edge records, so no sharp edges)
+        for_int(v, nv) { if (cmesh.vertex_flags(v).flag(GMesh::vflag_cusp)) ncv++; }
+        showdf("Genus: c=%d b=%d  v=%d f=%d e=%d  genus=%g%s\n", nc, nb, nv, nf, ne, genus,
+               ncv ? sform("  sharpe=0 cuspv=%d", ncv).c_str() : "");
+    }
+    { HH_STAT(Sbound); Sbound = std::move(Sloops); }
+    { HH_STAT(Scompf); Scompf = std::move(Scomps); }
+    {
+        HH_STAT(Snormsolida); HH_STAT(Ssolidang);
+        Array<Point> pa;
+        for_int(v, nv) {
+            if (cmesh.is_boundary(v) || cmesh.vertex_hedge(v)<0) continue;
+            pa.init(0);
+            for (int h = cmesh.vertex_hedge(v), h0 = h; ; ) {
+                pa.push(point(cmesh.vertex2(h)));
+                h = cmesh.ccw_hedge(h);
+                if (h==h0) break;
+            }
+            reverse(pa);        // clockwise order so that solid angle points toward inside of mesh
+            float solidang = solid_angle(point(v), pa);
+            Ssolidang.enter(solidang);
+            Snormsolida.enter( 1.f-solidang/TAU);
+        }
+    }
+    {
+        HH_STAT(Sfacearea);
+        for_int(f, nf) {
+            Vec3<int> va = cmesh.face_vertices(f);
+            Sfacearea.enter(sqrt(area2(point(va[0]), point(va[1]), point(va[2]))));
+        }
+        showdf("Area is %g\n", Sfacearea.sum());
+    }
+    {
+        HH_STAT(Selen);
+        for_int(h, nh) {
+            if (cmesh.opp(h)<h) Selen.enter(dist(point(cmesh.vertex1(h)), point(cmesh.vertex2(h))));
+        }
+    }
+    {
+        HH_STAT(Sfvertices);
+        for_int(f, nf) { Sfvertices.enter(3); }
+    }
+    {
+        HH_STAT(Sbvalence); HH_STAT(Sivalence); HH_STAT(Svalence);
+        for_int(v, nv) {
+            int degree = cmesh.degree(v);
+            Svalence.enter(degree);
+            if (!degree) continue;
+            if (cmesh.is_boundary(v)) Sbvalence.enter(degree);
+            else Sivalence.enter(degree);
+        }
+    }
+    {
+        double vol = 0.;
+        Point centroid(0.f, 0.f, 0.f);
+        if (nv) {
+            Homogeneous h;
+            for_int(v, nv) { h += point(v); }
+            centroid = to_Point(normalized(h));
+        }
+        for_int(f, nf) {
+            Vec3<int> va = cmesh.face_vertices(f);
+            vol += dot(cross(point(va[0])-centroid, point(va[1])-centroid), point(va[2])-centroid);
+        }
+        vol /= 6.f;
+        showdf("Volume is %g\n", vol);
+    }
+    {
+        Bbox bbox; bbox.clear();
+        for_int(v, nv) { bbox.union_with(point(v)); }
+        showdf("Bbox %g %g %g  %g %g %g\n", bbox[0][0], bbox[0][1], bbox[0][2], bbox[1][0], bbox[1][1], bbox[1][2]);
+    }
+    {
+        HH_STAT(Sdiha);
+        for_int(h, nh) {
+            int ho = cmesh.opp(h);
+            if (ho<h) continue;   // boundary edge, or interior edge visited from ho
+            float angcos = dihedral_angle_cos(point(cmesh.vertex1(h)), point(cmesh.vertex2(h)),
+                                              point(cmesh.vertex1(CompactMesh::prev(h))),
+                                              point(cmesh.vertex1(CompactMesh::prev(ho))));
+            if (angcos==-2.f) {
+                Warning("Edge dihedral undefined next to degenerate face");
+                angcos = 1.f;
+            }
+            Sdiha.enter(acos(angcos));
+        }
+    }
+}
+
+// For "Filtermesh file.m -stat", read a triangle mesh into a CompactMesh, which needs about a tenth of the
+//  memory of GMesh.  ret: false (having output nothing) if the mesh is not representable, e.g. has quads.
+bool compact_stat(const string& filename, ParseArgs& args) {
+    CompactMesh cmesh;
+    Array<string> comments;
+    {
+        RFile fi(filename);
+        HH_TIMER(_readmesh);
+        for (string sline; fi().peek()=='#'; ) {
+            assertx(my_getline(fi(), sline));
+            comments.push(sline);
+        }
+        if (!cmesh.read(fi()) || !cmesh.is_nice()) return false;
+        for (const string& sline : comments) {
+            if (sline.size()>1) showff("|%s\n", sline.substr(2).c_str());
+        }
+        showff("%s", args.header().c_str());
+    }
+    compact_info(cmesh);
+    return true;
+}
+
 Point get_dp(Vertex v) {
     Point dp;
     assertx(parse_key_vec(mesh.get_string(v), "domainp", dp));
@@ -2578,35 +2759,68 @@ float reduce_criterion(Edge e) {
     assertnever("");
 }
 
+// Queue entry for do_reduce(): the edge is identified by its vertex ids, because entries are never removed and may
+//  outlive the edge.  The entry is current only if stamp is still the newest stamp of the edge vertices and faces.
+struct ReduceEntry {
+    int vid1, vid2;
+    int stamp;
+};
+
 void do_reduce() {
     HH_TIMER(_reduce);
     assertx(reducecrit!=EReduceCriterion::undefined);
     // Also use: nfaces, maxcrit.
-    HPqueue<Edge> pqe; {
+    // Lazy deletion: rather than removing and re-entering the entries of the edges affected by a collapse, the
+    //  collapse stamps the vertices or faces whose changes affect the criterion, the affected edges are entered
+    //  once more, and the outdated entries are discarded when they reach the front of the queue.
+    int max_vid = 0, max_fid = 0;
+    for (Vertex v : mesh.vertices()) max_vid = max(max_vid, mesh.vertex_id(v));
+    for (Face f : mesh.faces()) max_fid = max(max_fid, mesh.face_id(f));
+    Array<int> vstamp(max_vid+1, 0), fstamp(max_fid+1, 0); // (faces are not created during the reduction)
+    auto edge_stamp = [&](Edge e) {
+        Face f2 = mesh.face2(e);
+        return max(max(vstamp[mesh.vertex_id(mesh.vertex1(e))], vstamp[mesh.vertex_id(mesh.vertex2(e))]),
+                   max(fstamp[mesh.face_id(mesh.face1(e))], f2 ? fstamp[mesh.face_id(f2)] : 0));
+    };
+    Pqueue<ReduceEntry> pqe;
+    auto enter_edge = [&](Edge e, float f) {
+        pqe.enter(ReduceEntry{mesh.vertex_id(mesh.vertex1(e)), mesh.vertex_id(mesh.vertex2(e)), edge_stamp(e)}, f);
+    };
+    {
         HH_TIMER(__initpq);
         HH_STAT(Sred);          // optional
-        for (Edge e : mesh.edges()) {
-            float f = reduce_criterion(e);
-            Sred.enter(f);
-            pqe.enter(e, f);
-        }
+        Array<Edge> ar_edges; ar_edges.reserve(mesh.num_edges());
+        for (Edge e : mesh.edges()) { ar_edges.push(e); }
+        Array<float> ar_crit(ar_edges.num());
+        // The criteria only read the mesh, so they are evaluated concurrently.
+        parallel_for_each(range(ar_edges.num()), [&](const int i) {
+            ar_crit[i] = reduce_criterion(ar_edges[i]);
+        }, k_omp_many_cycles_per_elem);
+        pqe.reserve(ar_edges.num());
+        for_int(i, ar_edges.num()) {
+            Edge e = ar_edges[i];
+            Sred.enter(ar_crit[i]);
+            pqe.enter_unsorted(ReduceEntry{mesh.vertex_id(mesh.vertex1(e)), mesh.vertex_id(mesh.vertex2(e)), 0},
+                               ar_crit[i]);
+        }
+        pqe.sort();
     }
     int nf = mesh.num_faces(), orig_nf = nf;
     int ne = mesh.num_edges(), orig_ne = ne;
-    int ncol = 0;
+    int ncol = 0, nstale = 0;
+    Array<Vertex> ar_nei;
+    Timer timer;                // collapse throughput
     for (;;) {
         if (nf<=nfaces) break;
         if (pqe.empty()) break;
         float crit = pqe.min_priority();
-        Edge e = pqe.remove_min();
+        ReduceEntry entry = pqe.remove_min();
+        Vertex v1 = mesh.id_retrieve_vertex(entry.vid1), v2 = mesh.id_retrieve_vertex(entry.vid2);
+        Edge e = v1 && v2 ? mesh.query_edge(v1, v2) : nullptr;
+        if (!e || edge_stamp(e)!=entry.stamp) { nstale++; continue; }
         if (crit>maxcrit) break;
         if (!mesh.nice_edge_collapse(e)) continue;
         // Do edge collapse.
-        for (Vertex v : mesh.vertices(e)) {
-            for (Edge e2 : mesh.edges(v)) {
-                pqe.remove(e2);
-            }
-        }
         int nfcol = mesh.face2(e) ? 2 : 1;
         nf -= nfcol;
         ne -= 1+nfcol;
@@ -2614,29 +2828,49 @@ void do_reduce() {
         Vertex vkept = mesh.vertex1(e);
         Point newp;
         if (reducecrit==EReduceCriterion::qem) {
-            Vertex v1 = mesh.vertex1(e), v2 = mesh.vertex2(e);
             bool isb1 = mesh.is_boundary(v1), isb2 = mesh.is_boundary(v2);
             int ii = isb1 && !isb2 ? 2 : isb2 && !isb1 ? 0 : 1; // ii==2:v1  ii==0:v2
             newp = interp(mesh.point(v1), mesh.point(v2), ii*.5f);
         }
-        mesh.collapse_edge(e);
+        mesh.collapse_edge(e);  // (the entries of the edges of the removed vertex v2 become outdated)
         if (reducecrit==EReduceCriterion::qem) mesh.set_point(vkept, newp);
+        // Update the edges adjacent to vkept and
+        //  - for qem, the edges adjacent to its neighbors (stamped through the neighbor vertices);
+        //  - for inscribed and volume, the edges opposite vkept (stamped through the faces adjacent to vkept).
+        vstamp[mesh.vertex_id(vkept)] = ncol;
+        if (reducecrit==EReduceCriterion::inscribed || reducecrit==EReduceCriterion::volume) {
+            for (Face f : mesh.faces(vkept)) fstamp[mesh.face_id(f)] = ncol;
+        }
+        ar_nei.init(0);
+        if (reducecrit==EReduceCriterion::qem) {
+            for (Vertex v : mesh.vertices(vkept)) {
+                vstamp[mesh.vertex_id(v)] = ncol;
+                ar_nei.push(v);
+            }
+        }
         for (Edge ee : mesh.edges(vkept)) {
-            pqe.enter_update(e, reduce_criterion(ee));
+            enter_edge(ee, reduce_criterion(ee));
         }
-        for (Face f : mesh.faces(vkept)) {
-            Edge ee = mesh.opp_edge(vkept, f);
-            pqe.enter_update(e, reduce_criterion(ee));
+        if (reducecrit==EReduceCriterion::inscribed || reducecrit==EReduceCriterion::volume) {
+            for (Face f : mesh.faces(vkept)) {
+                Edge ee = mesh.opp_edge(vkept, f);
+                enter_edge(ee, reduce_criterion(ee));
+            }
         }
-        if (reducecrit==EReduceCriterion::qem) {
-            for (Vertex v2 : mesh.vertices(vkept)) {
-                for (Edge ee : mesh.edges(v2)) {
-                    pqe.enter_update(ee, reduce_criterion(ee));
-                }
+        for (Vertex v : ar_nei) {
+            for (Edge ee : mesh.edges(v)) {
+                Vertex vo = mesh.opp_vertex(v, ee);
+                if (vo==vkept) continue; // already entered above
+                // An edge between two neighbors is entered from its vertex with the smaller id.
+                if (vstamp[mesh.vertex_id(vo)]==ncol && mesh.vertex_id(vo)<mesh.vertex_id(v)) continue;
+                enter_edge(ee, reduce_criterion(ee));
             }
         }
     }
-    showdf("Reduced %d times, deleted %d edges, %d faces\n", ncol, orig_ne-ne, orig_nf-nf);
+    timer.stop();
+    showdf("Reduced %d times, deleted %d edges, %d faces (%d outdated entries)\n",
+           ncol, orig_ne-ne, orig_nf-nf, nstale);
+    showdf("Collapses: %.0f/sec\n", ncol/max(timer.real(), 1e-6));
 }
 
 void do_lengthc() { reducecrit = EReduceCriterion::length; }
@@ -3783,6 +4017,51 @@ void do_subsamplegim(Args& args) {
     mesh.copy(nmesh);
 }
 
+// Report the throughput of the segment queries of do_shootrays() using the prior PolygonFaceSpatial uniform grid,
+//  the TriangleBvh one segment at a time, and the TriangleBvh with batched packets.
+void benchmark_shootrays(CArrayView<Polygon> ar_poly, const TriangleBvh& bvh, CArrayView<Vec2<Point>> segments,
+                         CArrayView<int> seg_tris, CArrayView<Point> seg_pints) {
+    Array<PolygonFace> ar_polyface; ar_polyface.reserve(ar_poly.num());
+    for (const Polygon& poly : ar_poly) { ar_polyface.push(PolygonFace(poly, nullptr)); }
+    PolygonFaceSpatial psp(120); {
+        Timer timer;
+        for (const PolygonFace& polyface : ar_polyface) { psp.enter(&polyface); }
+        timer.stop(); showdf("Grid build: %.3fs\n", timer.real());
+    }
+    const int nseg = segments.num();
+    // Count the segments whose intersection point differs from the batched result (ignoring ties between
+    //  overlapping widened triangles).
+    int ndiff = 0;
+    auto func_compare = [&](int i, bool found, const Point& pint) {
+        if (found!=(seg_tris[i]>=0) || (found && dist(pint, seg_pints[i])>1e-5f)) ndiff++;
+    };
+    {
+        Timer timer;
+        for_int(i, nseg) {
+            const PolygonFace* polyface; Point pint;
+            bool found = psp.first_along_segment(segments[i][0], segments[i][1], polyface, pint);
+            func_compare(i, found, pint);
+        }
+        timer.stop(); showdf("Grid:         %9.0f rays/sec\n", nseg/max(timer.real(), 1e-9));
+    }
+    {
+        Timer timer;
+        for_int(i, nseg) {
+            Point pint;
+            bool found = bvh.first_along_segment(segments[i][0], segments[i][1], pint)>=0;
+            func_compare(i, found, pint);
+        }
+        timer.stop(); showdf("BVH single:   %9.0f rays/sec\n", nseg/max(timer.real(), 1e-9));
+    }
+    {
+        Array<int> tris(nseg); Array<Point> pints(nseg);
+        Timer timer;
+        bvh.first_along_segments(segments, tris, pints);
+        timer.stop(); showdf("BVH packets:  %9.0f rays/sec\n", nseg/max(timer.real(), 1e-9));
+    }
+    showdf("Segments with a different intersection: %d\n", ndiff);
+}
+
 // Filtermesh ~/prevproj/2009/catwalk/data/manikin_ballerina_filter.ohull.nf10000.m -shootrays ~/prevproj/2009/catwalk/data/manikin_ballerina_filter.wids.m | G3dOGL -key DmDe -st ~/prevproj/2009/catwalk/data/manikin_ballerina_filter.s3d
 void do_shootrays(Args& args) {
     string filename = args.get_filename();
@@ -3796,19 +4075,23 @@ void do_shootrays(Args& args) {
     for (Vertex v : omesh.vertices()) { bb.union_with(omesh.point(v)); }
     Frame xform = bb.get_frame_to_small_cube(0.5f);
     Frame xformi = ~xform;
-    Array<PolygonFace> ar_polyface; ar_polyface.reserve(omesh.num_faces());
+    Array<Polygon> ar_poly; ar_poly.reserve(omesh.num_faces());
+    Array<Face> ar_face; ar_face.reserve(omesh.num_faces());
     bool has_blend = false;
-    PolygonFaceSpatial psp(120); {
-        HH_TIMER(__create_psp);
+    TriangleBvh bvh; {
+        HH_TIMER(__create_bvh);
         string str;
         for (Face f : omesh.faces()) {
             Polygon poly(3); omesh.polygon(f, poly); assertx(poly.num()==3);
             if (1) widen_triangle(poly, 1e-4f);
             for_int(i, 3) { poly[i] *= xform; }
-            ar_polyface.push(PolygonFace(std::move(poly), f));
+            ar_poly.push(std::move(poly));
+            ar_face.push(f);
             for (Corner c : omesh.corners(f)) { if (omesh.corner_key(str, c, "blendi")) has_blend = true; }
         }
-        for (PolygonFace& polyface : ar_polyface) { psp.enter(&polyface); }
+        Array<Vec3<Point>> triangles; triangles.reserve(ar_poly.num());
+        for (const Polygon& poly : ar_poly) { triangles.push(V(poly[0], poly[1], poly[2])); }
+        bvh.build(triangles);
     }
     {
         HH_TIMER(__shoot_rays);
@@ -3818,6 +4101,12 @@ void do_shootrays(Args& args) {
         float negdisp = -1e-5f*bb.max_side()*xform[0][0];
         float maxdisp = raymaxdispfrac*bb.max_side()*xform[0][0];
         string str;
+        const int nv = mesh.num_vertices();
+        Array<Vertex> va; va.reserve(nv);
+        Array<Point> pa; pa.reserve(nv);
+        Array<Vector> nora; nora.reserve(nv);
+        // Segments are ordered by direction so that neighboring vertices form coherent packets in the BVH.
+        Array<Vec2<Point>> segments(2*nv);
         for (Vertex v : mesh.vertices()) {
             Point p = mesh.point(v)*xform;
             Vector nor(0.f, 0.f, 0.f);
@@ -3832,17 +4121,28 @@ void do_shootrays(Args& args) {
             mesh.update_string(v, "Onormal", csform_vec(str, nor));
             mesh.update_string(v, "normal", nullptr);
             assertx(is_unit(nor));
-            float mindist = BIGFLOAT; Face minof = nullptr; Point minp = p;
             for_int(dir, 2) {
                 float vdir = dir ? 1.f : -1.f;
                 Point p1 = p+nor*(negdisp*vdir);
                 Point p2 = p+nor*(maxdisp*vdir);
-                const PolygonFace* polyface; Point pint;
-                bool found = psp.first_along_segment(p1, p2, polyface, pint);
+                segments[dir*nv+va.num()] = V(p1, p2);
+            }
+            va.push(v); pa.push(p); nora.push(nor);
+        }
+        Array<int> seg_tris(segments.num()); Array<Point> seg_pints(segments.num());
+        bvh.first_along_segments(segments, seg_tris, seg_pints);
+        if (getenv_bool("SHOOTRAYS_BENCH")) benchmark_shootrays(ar_poly, bvh, segments, seg_tris, seg_pints);
+        for_int(vi, nv) {
+            Vertex v = va[vi]; const Point& p = pa[vi]; const Vector& nor = nora[vi];
+            float mindist = BIGFLOAT; Face minof = nullptr; Point minp = p;
+            for_int(dir, 2) {
+                float vdir = dir ? 1.f : -1.f;
+                int tri = seg_tris[dir*nv+vi]; const Point& pint = seg_pints[dir*nv+vi];
+                bool found = tri>=0;
                 // if (found) { assertx(dist(p, pint)<=maxdisp*1.001); }
                 if (found && dist(p, pint)<abs(mindist)) {
                     mindist = dist(p, pint)*vdir;
-                    minof = polyface->face;
+                    minof = ar_face[tri];
                     minp = pint;
                 }
             }
@@ -4231,6 +4531,8 @@ int main(int argc, const char** argv) {
     ARGSD(record,               ": record mesh changes on stdout");
     ARGSF(nooutput,             ": do not print mesh at program end");
     ARGSD(setb3d,               ": set a3d output to binary");
+    ARGSD(setbinarymesh,        ": set mesh output to binary");
+    ARGSD(settextmesh,          ": set mesh output to text (default unless MESH_BINARY)");
     ARGSD(toa3d,                ": output a3d version of mesh");
     ARGSD(tob3d,                ": output binary a3d version of mesh");
     ARGSD(endobject,            ": output EndObject marker");
@@ -4356,21 +4658,27 @@ int main(int argc, const char** argv) {
     } else if (arg0!="-froma3d" && arg0!="-rawfroma3d" && arg0!="-creategrid" && arg0!="-fromgrid" &&
                arg0!="-frompointgrid" && arg0!="-createobject") {
         string filename = "-"; if (args.num() && (arg0=="-" || arg0[0]!='-')) filename = args.get_filename();
-        RFile fi(filename);
-        HH_TIMER(_readmesh);
-        for (string sline; fi().peek()=='#'; ) {
-            assertx(my_getline(fi(), sline));
-            if (sline.size()>1) showff("|%s\n", sline.substr(2).c_str());
+        // A named file (which may be read twice) with only "-stat" uses less memory.
+        if (filename!="-" && args.num()==1 && args.peek_string()=="-stat" && compact_stat(filename, args)) {
+            args.get_string();
+            nooutput = true;
+        } else {
+            RFile fi(filename);
+            HH_TIMER(_readmesh);
+            for (string sline; fi().peek()=='#'; ) {
+                assertx(my_getline(fi(), sline));
+                if (sline.size()>1) showff("|%s\n", sline.substr(2).c_str());
+            }
+            mesh.read(fi());
+            showff("%s", args.header().c_str());
         }
-        mesh.read(fi());
-        showff("%s", args.header().c_str());
     } else {
         showff("%s", args.header().c_str());
     }
     args.parse();
     HH_TIMER_END(Filtermesh);
     hh_clean_up();
-    if (!nooutput) { mesh.write(std::cout); std::cout.flush(); }
+    if (!nooutput) { mesh.write(std::cout, binarymesh); std::cout.flush(); }
     mesh.record_changes(nullptr); // do not record mesh destruction
     if (nocleanup) _exit(0);
     return 0;
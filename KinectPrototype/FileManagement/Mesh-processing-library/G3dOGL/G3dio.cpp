@@ -296,7 +296,7 @@ void ReadFiles(bool during_init) {
             add_extra(to_int(filename.substr(1).c_str()));
             continue;
         }
-        RFile is(filename);
+        RFile is(filename, true);
         read_file(HH_POSIX(fileno)(is.cfile()), during_init);
         if (anglethresh>=0) RecomputeSharpEdges(*g_obs[robn].get_mesh());
         robn++;
@@ -13,6 +13,7 @@
 #include "Timer.h"
 #include "MathOp.h"
 #include "RangeOp.h"
+#include "Parallel.h"           // parallel_for_each()
 using namespace hh;
 
 namespace {
@@ -29,6 +30,7 @@ bool vertexpts = false;
 bool unitcube0 = false;
 bool unitdiag0 = true;
 bool maxerror = false;
+bool parallel = true;
 
 Array<GMesh> meshes;            // meshes to compare
 Frame xform;                    // space -> "small" unit cube around all meshes
@@ -72,47 +74,39 @@ struct PStats {
     }
 };
 
-void project_point(GMesh& meshs, const Point& ps, const A3dColor& pscol, const Vector& psnor,
-                   const GMesh& meshd, const PolygonFaceSpatial& psp, Vertex vv, PStats& pstats) {
+// Counter-based random number in [0.f, 1.f): it depends only on (key, counter), so that the samples are
+//  reproducible regardless of the number of threads and of the order in which they are drawn.
+inline float counter_unif(uint64_t key, uint64_t counter) {
+    uint64_t z = (key<<40)+counter;
+    z *= 0x9E3779B97F4A7C15ull;  // splitmix64 finalizer
+    z = (z^(z>>30))*0xBF58476D1CE4E5B9ull;
+    z = (z^(z>>27))*0x94D049BB133111EBull;
+    z ^= z>>31;
+    return float(z>>40)*(1.f/float(1<<24));
+}
+
+// Ret: squared distance from ps to meshd.
+float project_point(const Point& ps, const A3dColor& pscol, const Vector& psnor,
+                    const GMesh& meshd, const PolygonFaceSpatial& psp, PStats& pstats) {
     SpatialSearch<PolygonFace*> ss(&psp, ps*xform);
     PolygonFace* polyface = ss.next();
     Face fd = polyface->face;
     Array<Corner> cad = meshd.get_corners(fd);
     Bary baryd;
-    {
-        Point clp;
-        float d2 = project_point_triangle2(ps,
-                                           meshd.point(meshd.corner_vertex(cad[0])),
-                                           meshd.point(meshd.corner_vertex(cad[1])),
-                                           meshd.point(meshd.corner_vertex(cad[2])),
-                                           baryd, clp);
-        pstats.Sgd2.enter(d2);
-        if (errmesh && vv) {
-            float g_K = 1000000.f*(1.0f/bbdiag);
-            float g_MK = 0.f;
-            if (0) g_MK = 75.f*(1.0f/bbdiag);
-            d2 = abs(d2);
-            float val = g_K*log(d2+1.f);
-            HH_SSTAT(Serrval, val);
-            // showdf("val %f first cut %f d2 %f\n", val, bbdiag/100, d2*100);
-            // if (val < 1.f)
-            if (val < bbdiag/100) {
-                meshs.update_string(vv, "rgb", sform("(%g %g %g)", 1.f, max(0.f, 1.f-val), max(0.f, 1.f-val)).c_str());
-            } else if (val < bbdiag/50) { // else if (val < 2.f)
-                meshs.update_string(vv, "rgb", sform("(%g %g %g)", 1.f, min(val-1.f, 1.f), 0.f).c_str());
-            } else {
-                // val = val - 2;
-                if (0) val /= g_MK;
-                meshs.update_string(vv, "rgb", sform("(%g %g %g)", max(0.f, 1.f-val), 0.f, 0.f).c_str());
-            }
-        }
-    }
+    Point clp;
+    float d2 = project_point_triangle2(ps,
+                                       meshd.point(meshd.corner_vertex(cad[0])),
+                                       meshd.point(meshd.corner_vertex(cad[1])),
+                                       meshd.point(meshd.corner_vertex(cad[2])),
+                                       baryd, clp);
+    pstats.Sgd2.enter(d2);
     pstats.Scd2.enter(dist2(pscol, interp(c_color(cad[0]), c_color(cad[1]), c_color(cad[2]), baryd[0], baryd[1])));
     pstats.Snd2.enter(dist2(psnor, interp(c_normal(cad[0]), c_normal(cad[1]), c_normal(cad[2]), baryd[0], baryd[1])));
+    return d2;
 }
 
-void project_point(GMesh& meshs, Face fs, CArrayView<Corner> cas, const Bary& barys, const GMesh& meshd,
-                   const PolygonFaceSpatial& psp, Vertex vv, PStats& pstats) {
+void project_point(const GMesh& meshs, Face fs, CArrayView<Corner> cas, const Bary& barys, const GMesh& meshd,
+                   const PolygonFaceSpatial& psp, PStats& pstats) {
     dummy_use(fs);
     Point ps = interp(meshs.point(meshs.corner_vertex(cas[0])),
                       meshs.point(meshs.corner_vertex(cas[1])),
@@ -120,7 +114,40 @@ void project_point(GMesh& meshs, Face fs, CArrayView<Corner> cas, const Bary& ba
                       barys[0], barys[1]);
     A3dColor pscol = interp(c_color(cas[0]), c_color(cas[1]), c_color(cas[2]), barys[0], barys[1]);
     Vector psnor = interp(c_normal(cas[0]), c_normal(cas[1]), c_normal(cas[2]), barys[0], barys[1]);
-    project_point(meshs, ps, pscol, psnor, meshd, psp, vv, pstats);
+    project_point(ps, pscol, psnor, meshd, psp, pstats);
+}
+
+// Color vertex vv of the output error mesh according to its squared distance d2.
+void color_vertex_error(GMesh& meshs, Vertex vv, float d2) {
+    float g_K = 1000000.f*(1.0f/bbdiag);
+    float g_MK = 0.f;
+    if (0) g_MK = 75.f*(1.0f/bbdiag);
+    d2 = abs(d2);
+    float val = g_K*log(d2+1.f);
+    HH_SSTAT(Serrval, val);
+    // showdf("val %f first cut %f d2 %f\n", val, bbdiag/100, d2*100);
+    // if (val < 1.f)
+    if (val < bbdiag/100) {
+        meshs.update_string(vv, "rgb", sform("(%g %g %g)", 1.f, max(0.f, 1.f-val), max(0.f, 1.f-val)).c_str());
+    } else if (val < bbdiag/50) { // else if (val < 2.f)
+        meshs.update_string(vv, "rgb", sform("(%g %g %g)", 1.f, min(val-1.f, 1.f), 0.f).c_str());
+    } else {
+        // val = val - 2;
+        if (0) val /= g_MK;
+        meshs.update_string(vv, "rgb", sform("(%g %g %g)", max(0.f, 1.f-val), 0.f, 0.f).c_str());
+    }
+}
+
+// Sample a point on a random face of meshs, selected according to the cumulative face areas fcarea.
+void sample_point(const GMesh& meshs, CArrayView<Face> fface, CArrayView<float> fcarea, Vec3<float> unifs,
+                  const GMesh& meshd, const PolygonFaceSpatial& psp, Array<Corner>& cas, PStats& pstats) {
+    int fi = discrete_binary_search(fcarea, 0, fface.num(), unifs[0]);
+    Face f = fface[fi];
+    cas = meshs.get_corners(f, std::move(cas));
+    float a = unifs[1], b = unifs[2];
+    if (a+b>1.f) { a = 1.f-a; b = 1.f-b; }
+    Bary bary(a, b, 1.f-a-b);
+    project_point(meshs, f, cas, bary, meshd, psp, pstats);
 }
 
 void print_it(const string& s, const PStats& pstats) {
@@ -153,7 +180,12 @@ void print_it(const string& s, const PStats& pstats) {
     }
 }
 
-void compute_mesh_distance(GMesh& meshs, const GMesh& meshd, PStats& pastats) {
+// The samples are processed in blocks, whose partial statistics are merged in order, so that the result of the
+//  parallel evaluation is deterministic.
+const int k_block_samples = 4096;
+
+// For the random samples, key selects the counter-based random stream.
+void compute_mesh_distance(GMesh& meshs, const GMesh& meshd, PStats& pastats, uint64_t key) {
 
     Bbox bb; bb.clear();
     // compute the meshes bounding box
@@ -183,6 +215,7 @@ void compute_mesh_distance(GMesh& meshs, const GMesh& meshd, PStats& pastats) {
         for (PolygonFace& polyface : ar_polyface) { psp.enter(&polyface); }
     }
     HH_TIMER(_sample_distances);
+    Timer timer; int nsamples = 0;
     if (numpts) {
         PStats pstats;
         // showdf("- random sampling of %d points\n", numpts);
@@ -197,40 +230,66 @@ void compute_mesh_distance(GMesh& meshs, const GMesh& meshd, PStats& pastats) {
             for_int(i, fface.num()) { fcarea[i] /= float(sum_area); }
             fcarea.push(1.00001f);
         }
-        Array<Corner> cas;
-        for_int(i, numpts) {
-            int fi = discrete_binary_search(fcarea, 0, fface.num(), Random::G.unif());
-            Face f = fface[fi];
-            cas = meshs.get_corners(f, std::move(cas));
-            float a = Random::G.unif(), b = Random::G.unif();
-            if (a+b>1.f) { a = 1.f-a; b = 1.f-b; }
-            Bary bary(a, b, 1.f-a-b);
-            project_point(meshs, f, cas, bary, meshd, psp, nullptr, pstats);
+        if (parallel) {
+            const int nblocks = (numpts+k_block_samples-1)/k_block_samples;
+            Array<PStats> ar_pstats(nblocks);
+            parallel_for_each(range(nblocks), [&](const int iblock) {
+                Array<Corner> cas;
+                for_intL(i, iblock*k_block_samples, min((iblock+1)*k_block_samples, numpts)) {
+                    Vec3<float> unifs;
+                    for_int(c, 3) { unifs[c] = counter_unif(key, uint64_t(i)*3+c); }
+                    sample_point(meshs, fface, fcarea, unifs, meshd, psp, cas, ar_pstats[iblock]);
+                }
+            }, k_block_samples*uint64_t{3000});
+            for_int(iblock, nblocks) { pstats.add(ar_pstats[iblock]); }
+        } else {
+            Array<Corner> cas;
+            for_int(i, numpts) {
+                Vec3<float> unifs;
+                unifs[0] = Random::G.unif(); unifs[1] = Random::G.unif(); unifs[2] = Random::G.unif();
+                sample_point(meshs, fface, fcarea, unifs, meshd, psp, cas, pstats);
+            }
         }
+        nsamples += numpts;
         if (verb>=2) print_it(" r", pstats);
         pastats.add(pstats);
     }
     if (vertexpts) {
         PStats pstats;
         // showdf("- vertex sampling\n");
-        Array<Corner> cas;
-        for (Vertex v : meshs.vertices()) {
-            if (1) {            // works on mesh containing just isolated vertices
-                const Vector& psnor = v_normal(v);
-                const A3dColor pscol(0.f, 0.f, 0.f);
-                project_point(meshs, meshs.point(v), pscol, psnor, meshd, psp, v, pstats);
-            } else {
-                Face f = assertx(meshs.most_clw_face(v));
-                cas = meshs.get_corners(f, std::move(cas));
-                Bary bary(0.f, 0.f, 0.f);
-                int cai = cas.index(meshs.corner(v, f)); assertx(cai>=0);
-                bary[cai] = 1.f;
-                project_point(meshs, f, cas, bary, meshd, psp, v, pstats);
-            }
+        const Array<Vertex> va(meshs.vertices());
+        const int nv = va.num();
+        Array<float> ar_d2(nv);
+        auto func_project = [&](const int i, PStats& pstats2) {
+            Vertex v = va[i];
+            // (projecting from meshs.most_clw_face(v) would fail on a mesh containing just isolated vertices)
+            const Vector& psnor = v_normal(v);
+            const A3dColor pscol(0.f, 0.f, 0.f);
+            ar_d2[i] = project_point(meshs.point(v), pscol, psnor, meshd, psp, pstats2);
+        };
+        if (parallel) {
+            const int nblocks = (nv+k_block_samples-1)/k_block_samples;
+            Array<PStats> ar_pstats(nblocks);
+            parallel_for_each(range(nblocks), [&](const int iblock) {
+                for_intL(i, iblock*k_block_samples, min((iblock+1)*k_block_samples, nv)) {
+                    func_project(i, ar_pstats[iblock]);
+                }
+            }, k_block_samples*uint64_t{3000});
+            for_int(iblock, nblocks) { pstats.add(ar_pstats[iblock]); }
+        } else {
+            for_int(i, nv) { func_project(i, pstats); }
+        }
+        if (errmesh) {
+            for_int(i, nv) { color_vertex_error(meshs, va[i], ar_d2[i]); }
         }
+        nsamples += nv;
         if (verb>=2) print_it(" v", pstats);
         pastats.add(pstats);
     }
+    timer.stop();
+    if (verb>=1 && nsamples)
+        showdf("  %d samples in %.2fs: %.0f samples/sec\n",
+               nsamples, timer.real(), nsamples/max(timer.real(), 1e-6));
 }
 
 void do_distance() {
@@ -257,7 +316,7 @@ void do_distance() {
         if (!bothdir && idir==1) continue;
         if (bothdir && verb>=2)
             showdf("Distance mesh%d -> mesh%d\n", idir, 1-idir);
-        compute_mesh_distance(meshes[idir], meshes[1-idir], pastats);
+        compute_mesh_distance(meshes[idir], meshes[1-idir], pastats, idir);
         pbstats.add(pastats);
         if (!bothdir || verb>=2) print_it(sform(" %c", '0'+idir), pastats);
     }
@@ -277,6 +336,7 @@ int main(int argc, const char** argv) {
     ARGSP(unitcube0,            "bool : normalize distance by mesh0 bbox side");
     ARGSP(unitdiag0,            "bool : normalize distance by mesh0 bbox diag");
     ARGSP(maxerror,             "bool : include Linf norm");
+    ARGSP(parallel,             "bool : draw counter-based random samples and project them concurrently");
     ARGSD(distance,             ": compute inter-mesh distances");
     HH_TIMER(MeshDistance);
     args.parse();
@@ -25,6 +25,7 @@
 #include "MathOp.h"
 #include "RangeOp.h"
 #include "SGrid.h"
+#include "Parallel.h"           // parallel_for_each()
 #if !defined(HH_NO_SIMPLEX)
 #include "recipes.h"
 #endif
@@ -55,7 +56,8 @@ namespace {
 // #define ENABLE_TVC
 
 
-#define SSTATV2(Svar, v) do { static Stat Svar(#Svar, verb>=2, true); Svar.enter(v); } while (false)
+#define SSTATV2(Svar, v) do { static Stat Svar(#Svar, verb>=2, true);                                         \
+        static thread_local Stat* const Svar##_shard = Svar.thread_shard(); Svar##_shard->enter(v); } while (false)
 
 // *** MISC
 
@@ -3751,7 +3753,7 @@ EResult try_ecol(Edge e, bool commit, float& ret_cost, int& ret_min_ii, Vertex&
                 }
             }
             int nw = ar_wi.num();
-            static Matrix<float> minp;
+            static thread_local Matrix<float> minp;
             if (minp.ysize()<nw) minp.init(nw, k_qemsmax);
             for_int(i, nw) {
                 create_qem_vector(newp, ar_wi[i], minp[i]);
@@ -4355,22 +4357,40 @@ void optimize() {
     }
     ConsoleProgress cprogress; cprogress.update(0.f);
     if (!pqecost.num() && !invertexorder) {
+        HH_TIMER(__init_pqecost);
         pqecost.reserve(mesh.num_edges());
         // showf("Entering %d edges into priority queue\n", mesh.num_edges());
         ConsoleProgress cprogress2;
         // Add some randomness to the way edges are selected.
         Array<Edge> ar; ar.reserve(mesh.num_edges()); for (Edge e : mesh.edges()) { ar.push(e); }
         { std::default_random_engine dre; std::shuffle(ar.begin(), ar.end(), dre); }
-        for (Edge e : ar) {
-            if (verb>=1) cprogress2.update(float(pqecost.num())/mesh.num_edges());
-            ASSERTX(!pqecost.contains(e));
+        // Evaluate the costs concurrently (try_ecol() without commit only reads the mesh), except when the
+        //  evaluation draws random numbers or accumulates per-call timings, which must stay sequential.
+        const bool parallel = !minrandom && Timer::show_times()<=0;
+        Array<float> ar_cost(ar.num());
+        auto func_cost = [&](const int i) {
             float cost; int dummy_min_ii; Vertex dummy_vs;
-            try_ecol(e, false, cost, dummy_min_ii, dummy_vs);
-            pqecost.enter_unsorted(e, cost);
-            if (verb>=3) showdf("adding edge with cost=%g\n", cost-offset_cost);
+            try_ecol(ar[i], false, cost, dummy_min_ii, dummy_vs);
+            ar_cost[i] = cost;
+        };
+        const int k_block = 1<<16;  // granularity of progress updates
+        for (int i0 = 0; i0<ar.num(); i0 += k_block) {
+            if (verb>=1) cprogress2.update(float(i0)/ar.num());
+            const int i1 = min(i0+k_block, ar.num());
+            if (parallel) {
+                parallel_for_each(range(i0, i1), func_cost, k_omp_many_cycles_per_elem);
+            } else {
+                for_intL(i, i0, i1) { func_cost(i); }
+            }
+        }
+        for_int(i, ar.num()) {  // same order as the sequential evaluation, so the queue is identical
+            ASSERTX(!pqecost.contains(ar[i]));
+            pqecost.enter_unsorted(ar[i], ar_cost[i]);
+            if (verb>=3) showdf("adding edge with cost=%g\n", ar_cost[i]-offset_cost);
         }
         pqecost.sort();
     }
+    HH_TIMER(__greedy);
     // showf("Begin simplification\n");
     int orig_nfaces = mesh.num_faces();
     int ntested = 0, nsuccess = 0, onf = mesh.num_faces(), neval = 0, nnotbest = 0;
@@ -8,7 +8,7 @@
 
 namespace hh {
 
-// Many static data structures below -- lots of code is not thread-safe.
+// The solver scratch structures below are thread_local, so that costs can be evaluated by parallel threads.
 
 // Given larger q1, add to it the smaller q2 (in the upper-left corner).
 template<typename T, int n1, int n2> void qem_add_submatrix(Qem<T,n1>& q1, const Qem<T,n2>& q2) {
@@ -168,7 +168,7 @@ template<typename T, int n> void Qem<T,n>::set_distance_hh99(const float* p0, co
         //  (  v1   1 ) * ( g_s )   =   ( s1 )
         //  (  v2   1 )   (     )       ( s2 )
         //  (  n    0 )   ( d_s )       ( 0  )
-        static LudLLS lls(4, 4, nattrib);
+        static thread_local LudLLS lls(4, 4, nattrib);
         lls.clear();
         for_int(c, 3) {
             lls.enter_a_rc(0, c, p0[c]);
@@ -251,7 +251,7 @@ template<typename T, int n> float Qem<T,n>::evaluate(const float* p) const {
 // minp unchanged if unsuccessful !
 template<typename T, int n> bool Qem<T,n>::compute_minp(float* minp) const {
     // minp = - A^-1 b        or     A * minp = -b
-    static SvdDoubleLLS lls(n, n, 1);
+    static thread_local SvdDoubleLLS lls(n, n, 1);
     lls.clear();
     {
         const T* pa = _a.data();
@@ -277,7 +277,7 @@ template<typename T, int n> bool Qem<T,n>::compute_minp_constr_first(float* minp
     assertx(nf>0 && nf<n);
     // Given fixed minp[0..nf-1], optimize for minp[nf..n-1] .
     //  A_22 * x_2 = (-b_2 - A_21 * x_1)    (A_21 = A_12^T)
-    static unique_ptr<SvdDoubleLLS> plls; static int prev_nf;
+    static thread_local unique_ptr<SvdDoubleLLS> plls; static thread_local int prev_nf;
     if (!plls || prev_nf!=nf) {
         plls = make_unique<SvdDoubleLLS>(n-nf, n-nf, 1);
         prev_nf = nf;
@@ -332,7 +332,7 @@ template<typename T, int n> bool Qem<T,n>::compute_minp_constr_lf(float* minp, c
     //  x = x0 + Z * w
     //  (Z^T * A * Z) * w = (-Z^T * (A*x0+b))
     assertx(n>=2);
-    static Matrix<double> a; if (!a.ysize()) a.init(n, n);
+    static thread_local Matrix<double> a; if (!a.ysize()) a.init(n, n);
     {
         const T* pa = _a.data();
         for_int(i, n) {
@@ -346,7 +346,7 @@ template<typename T, int n> bool Qem<T,n>::compute_minp_constr_lf(float* minp, c
         }
         if (0) print_matrix(a);
     }
-    static Matrix<double> zt; if (!zt.ysize()) zt.init(n-1, n);
+    static thread_local Matrix<double> zt; if (!zt.ysize()) zt.init(n-1, n);
     {
         assertx(n>=3);
         // Note: at present only handle extremely restricted case.
@@ -368,7 +368,7 @@ template<typename T, int n> bool Qem<T,n>::compute_minp_constr_lf(float* minp, c
         for_intL(i, 3, n) { zt[i-1][i] = 1.; }
         if (0) print_matrix(zt);
     }
-    static SvdDoubleLLS lls(n, n, 1);
+    static thread_local SvdDoubleLLS lls(n, n, 1);
     lls.clear();
     for_int(i, n-1) {
         for_int(j, n) {
@@ -404,8 +404,8 @@ template<typename T, int n> bool Qem<T,n>::fast_minp_constr_lf(float* minp, cons
     //   C1 = (C - B * B^T / al);
     //   [p; gm] = [C1 g; g^T 0]^(-1) * [b1 - B * b2 / al; -d_v];
     //   s = (b2 - B^T * p) / al;
-    static Matrix<double> c; if (!c.ysize()) c.init(ngeom, ngeom);
-    static Matrix<double> b; if (!b.ysize() && nattrib) b.init(ngeom, nattrib);
+    static thread_local Matrix<double> c; if (!c.ysize()) c.init(ngeom, ngeom);
+    static thread_local Matrix<double> b; if (!b.ysize() && nattrib) b.init(ngeom, nattrib);
     double alinv;               // 1.0 / al
     {
         const T* pa = _a.data();
@@ -438,7 +438,7 @@ template<typename T, int n> bool Qem<T,n>::fast_minp_constr_lf(float* minp, cons
         if (0) print_matrix(c);
         if (0) print_matrix(b);
     }
-    static SvdDoubleLLS lls(ngeom+1, ngeom+1, 1);
+    static thread_local SvdDoubleLLS lls(ngeom+1, ngeom+1, 1);
     lls.clear();
     for_int(i, ngeom) {
         for_int(j, ngeom) {
@@ -473,7 +473,7 @@ template<typename T, int n> bool Qem<T,n>::ar_compute_minp(CArrayView<Qem<T,n>*>
     assertx(minp.ysize()>=nw && minp.xsize()>=n);
     const int ngeom = 3, nattrib = n-ngeom; assertx(nattrib>=0);
     const int msize = ngeom+nattrib*nw;
-    static unique_ptr<SvdDoubleLLS> plls; static int psize; // cache previous size
+    static thread_local unique_ptr<SvdDoubleLLS> plls; static thread_local int psize; // cache previous size
     if (msize!=psize) {
         plls = make_unique<SvdDoubleLLS>(msize, msize, 1);
         psize = msize;
@@ -535,9 +535,9 @@ bool Qem<T,n>::ar_compute_minp_constr_lf(CArrayView<Qem<T,n>*> ar_q, MatrixView<
     assertx(minp.ysize()>=nw && minp.xsize()>=n);
     const int ngeom = 3, nattrib = n-ngeom; assertx(nattrib>=0);
     const int msize = ngeom+nattrib*nw;
-    static Matrix<double> a; if (a.ysize()!=msize) a.init(msize, msize);
+    static thread_local Matrix<double> a; if (a.ysize()!=msize) a.init(msize, msize);
     fill(a, 0.);
-    static Array<double> b; if (b.num()!=msize) b.init(msize);
+    static thread_local Array<double> b; if (b.num()!=msize) b.init(msize);
     fill(b, 0.);
     for_int(wi, nw) {
         const Qem<T,n>& qem = *ar_q[wi]; // be careful never to use *this!
@@ -571,7 +571,7 @@ bool Qem<T,n>::ar_compute_minp_constr_lf(CArrayView<Qem<T,n>*> ar_q, MatrixView<
 #else
     const int msize1 = msize;
 #endif
-    static unique_ptr<SvdDoubleLLS> plls; static int psize1; // cache previous size
+    static thread_local unique_ptr<SvdDoubleLLS> plls; static thread_local int psize1; // cache previous size
     if (msize1!=psize1) {
         plls = make_unique<SvdDoubleLLS>(msize1, msize1, 1);
         psize1 = msize1;
@@ -590,7 +590,7 @@ bool Qem<T,n>::ar_compute_minp_constr_lf(CArrayView<Qem<T,n>*> ar_q, MatrixView<
     for_int(j, ngeom) { lls.enter_a_rc(j, msize, lf[j]); }
     lls.enter_b_rc(msize, 0, -lf[n]);
 #else
-    static Matrix<double> zt; if (!zt.num()!=msize-1) zt.init(msize-1, msize);
+    static thread_local Matrix<double> zt; if (!zt.num()!=msize-1) zt.init(msize-1, msize);
     {
         // Note: at present only handle extremely restricted case.
         for_intL(i, 3, n) { assertx(lf[i]==0.f); }
@@ -23,6 +23,8 @@
 #include "BinarySearch.h"
 #include "RangeOp.h"
 #include "MathOp.h"
+#include "Parallel.h"           // parallel_for_each()
+#include "BinaryPoints.h"
 using namespace hh;
 
 namespace {
@@ -113,6 +115,7 @@ float spbf = 1.f;
 float dihfac = 0.f;
 float dihpower = 3.f;
 int restrictfproject = 0;       // 0=never, 1=first_iter, 2=always
+bool parallelproject = true;    // global projection of points uses concurrent searches
 float fliter = 1.f;
 float crep = 1e-5f;
 float crbf = 3.f;
@@ -382,37 +385,28 @@ float project_point_neighb(const Point& p, Face& cf, Bary& ret_bary, Point& ret_
 }
 
 void global_project_aux() {
+    // The searches are concurrent; the face assignments are then applied sequentially since they modify f_setpts.
+    //  Without local projection, the hint face is ignored, so the results are identical to a sequential search.
+    const int npts = pt.co.num();
+    const uint64_t k_cycles_per_search = 5000;
     if (!have_quads) {
         MeshSearch msearch(&mesh, false);
-        if (1) {
+        if (!parallelproject) {
             Face hintf = nullptr;
-            for_int(i, pt.co.num()) {
+            for_int(i, npts) {
                 Bary bary; Point clp; float d2;
                 Face f = msearch.search(pt.co[i], hintf, bary, clp, d2);
                 hintf = f;
                 point_change_face(i, f);
                 pt.clp[i] = clp;
             }
-        } else {                // TODO: parallel; it crashes?
-            // c:\hh\src\libhh\hh.cpp(143): hh::`anonymous namespace'::show_call_stack
-            // c:\hh\src\libhh\hh.cpp(236): hh::`anonymous namespace'::my_top_level_exception_filter
-            // c:\hh\src\libhh\spatial.h(190): hh::ObjectSpatial<hh::details::polygonface_approx_distance2,hh::details::polygonface_distance2>::add_cell
-            // c:\hh\src\libhh\spatial.cpp(105): hh::BSpatialSearch::BSpatialSearch
-            // c:\hh\src\libhh\meshsearch.cpp(126): hh::MeshSearch::search
-            // c:\hh\src\meshfit\meshfit.cpp(365): `anonymous namespace'::global_project_aux$omp$1
-            //  why does gfit not change geometry significantly?
-            //  is it possible to remove FORCE_GLOBAL_PROJECT ?
-            //  try fgfit?
-            Array<Face> ar_face(pt.co.num()); Array<Point> ar_clp(pt.co.num());
-            parallel_for_each(range(pt.co.num()), [&](const int i) {
+        } else {
+            Array<Face> ar_face(npts);
+            parallel_for_each(range(npts), [&](const int i) {
                 Bary bary; float d2;
-                Face hintf = pt.cmf[i]; // different semantics now
-                ar_face[i] = msearch.search(pt.co[i], hintf, bary, ar_clp[i], d2);
-            });
-            for_int(i, pt.co.num()) {
-                point_change_face(i, ar_face[i]);
-                pt.clp[i] = ar_clp[i];
-            }
+                ar_face[i] = msearch.search(pt.co[i], nullptr, bary, pt.clp[i], d2);
+            }, k_cycles_per_search);
+            for_int(i, npts) { point_change_face(i, ar_face[i]); }
         }
     } else {
         const int nv = mesh.num_vertices();
@@ -433,13 +427,20 @@ void global_project_aux() {
         }
         PolygonFaceSpatial psp(nv<10000 ? 15 : nv<30000 ? 25 : 35);
         for (PolygonFace& polyface : ar_polyface) { psp.enter(&polyface); }
-        for_int(i, pt.co.num()) {
+        Array<Face> ar_face(npts);
+        auto func_project = [&](const int i) {
             SpatialSearch<PolygonFace*> ss(&psp, pt.co[i]);
             PolygonFace* polyface = ss.next();
             Face f = polyface->face;
-            point_change_face(i, f);
-            project_point(pt.co[i], f, dummy_bary, pt.clp[i]);
+            ar_face[i] = f;
+            Bary bary; project_point(pt.co[i], f, bary, pt.clp[i]);
+        };
+        if (parallelproject) {
+            parallel_for_each(range(npts), func_project, k_cycles_per_search);
+        } else {
+            for_int(i, npts) { func_project(i); }
         }
+        for_int(i, npts) { point_change_face(i, ar_face[i]); }
     }
 }
 
@@ -459,6 +460,9 @@ void global_project() {
     int nzcmf = 0; for_int(i, pt.co.num()) { nzcmf += !pt.cmf[i]; }
     // Problem with FORCE_GLOBAL_PROJECT is that with fgfit, the first
     //  optimization iteration often pushes vertices out of the unit bbox.
+    //  why does gfit not change geometry significantly?
+    //  is it possible to remove FORCE_GLOBAL_PROJECT ?
+    //  try fgfit?
     static const bool force_global_project = getenv_bool("FORCE_GLOBAL_PROJECT");
     if (nzcmf==pt.co.num() || force_global_project) global_project_aux();
     else if (!nzcmf) local_project_aux();
@@ -491,15 +495,21 @@ void do_mfilename(Args& args) {
 void do_filename(Args& args) {
     HH_TIMER(_filename);
     assertx(!pt.co.num());
-    RFile is(args.get_filename());
-    RSA3dStream ia3d(is());
-    A3dElem el;
-    for (;;) {
-        ia3d.read(el);
-        if (el.type()==A3dElem::EType::endfile) break;
-        if (el.type()==A3dElem::EType::comment) continue;
-        if (el.type()!=A3dElem::EType::point) { Warning("Non-point input ignored"); continue; }
-        pt.enter(el[0].p);
+    string filename = args.get_filename();
+    if (BinaryPoints::is_binary_points(filename)) {
+        BinaryPoints bpoints(filename); // memory-mapped
+        for (const Point& p : bpoints.points()) pt.enter(p);
+    } else {
+        RFile is(filename);
+        RSA3dStream ia3d(is());
+        A3dElem el;
+        for (;;) {
+            ia3d.read(el);
+            if (el.type()==A3dElem::EType::endfile) break;
+            if (el.type()==A3dElem::EType::comment) continue;
+            if (el.type()!=A3dElem::EType::point) { Warning("Non-point input ignored"); continue; }
+            pt.enter(el[0].p);
+        }
     }
     showdf("%d points read)\n", pt.co.num());
 }
@@ -1442,6 +1452,7 @@ int main(int argc, const char** argv) {
     ARGSP(dihfac,               "val : set edge dihedral energy factor");
     ARGSP(dihpower,             "pow : set edge dihedral energy exponent");
     ARGSP(restrictfproject,     "int : 0=never, 1=first_iter, 2=always");
+    ARGSP(parallelproject,      "bool : use concurrent searches in global projection");
     ARGSC("",                   ":");
     ARGSD(outlierdelete,        "dist : remove points more than given distance from initial mesh");
     ARGSD(gfit,                 "niter : do global fit (0=until convergence)");
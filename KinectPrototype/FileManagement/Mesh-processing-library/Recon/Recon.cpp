@@ -21,6 +21,8 @@
 //  no longer need EMST, assume this new graph represents components
 // 1993-09-09: all coordinates transformed internally into unit box.
 
+#include <sstream>              // std::istringstream
+
 #include "Args.h"
 #include "A3dStream.h"
 #include "Homogeneous.h"
@@ -31,22 +33,25 @@
 #include "Polygon.h"
 #include "Spatial.h"
 #include "Principal.h"
-#include "Graph.h"
-#include "GraphOp.h"            // graph_edge_stats(), graph_num_components(), graph_mst()
+#include "PointGraph.h"         // adjacency_edges(), mst_edges()
 #include "Contour.h"
+#include "Multigrid.h"
 #include "GMesh.h"
 #include "MeshOp.h"
 #include "Timer.h"
+#include "Parallel.h"
 #include "Array.h"
 #include "Bbox.h"
 #include "FrameIO.h"
-#include "Set.h"
 #include "StringOp.h"
+#include "TextParse.h"          // TextLines, parse_float()
+#include "BinaryPoints.h"
 using namespace hh;
 
 namespace {
 
 // necessary
+string pointfile;               // read from this file rather than std::cin
 string rootname;
 string what = "m";
 float samplingd = 0.f;
@@ -58,6 +63,12 @@ int prop = 2;
 int usenormals = 0;             // 1=use them in optimization, 2=skip opt+use to orient, 3=use_exactly
 int maxkintp = 20;
 int minkintp = 4;
+int nthreads = 0;               // threads for tangent planes and contouring (0=all cores, 1=serial)
+bool brickcontour = false;      // contour the mesh in concurrent bricks (different vertex and face order)
+bool staticspatial = false;     // use StaticPointSpatial and batched k-NN queries
+bool poisson = false;           // contour a screened Poisson indicator function instead of the signed distance
+float screening = .001f;        // screening weight of the Poisson system (in grid units)
+int vcycles = 0;                // number of multigrid V-cycles (0=default)
 
 int num;                        // # data points
 bool is_3D;                     // is it a 3D problem (vs. 2D)
@@ -68,10 +79,9 @@ string g_header;                // header to place at top of output files
 Frame xform;                    // original pts -> pts in unit cube
 Frame xformi;                   // inverse
 
-unique_ptr<PointSpatial<int>> SPp;  // spatial partition on co
-unique_ptr<PointSpatial<int>> SPpc; // spatial partition on pcorg
-unique_ptr<Graph<int>> gpcpseudo;   // Riemannian on pc centers (based on co)
-unique_ptr<Graph<int>> gpcpath;     // path of orientation propagation
+unique_ptr<Spatial> SPp;            // spatial partition on co
+unique_ptr<Spatial> SPpc;           // spatial partition on pcorg
+Array<WEdge> gpcpseudo;             // Riemannian graph on pc centers (based on co)
 
 Map<Mk3d*, unique_ptr<WFile>> g_map_mk3d_wfile;
 
@@ -107,24 +117,99 @@ void close_mk(unique_ptr<Mk3d>& pmk) {
     pfi = nullptr;                      // destruct WFile
 }
 
+// Parse the "n"/"p" records of a chunk of a text a3d stream of points; return false if the chunk has other
+//  content (e.g. binary records, or a normal not immediately followed by its point), which is left to RSA3dStream.
+bool parse_points(const TextLines& lines, int ichunk, Array<Point>& pco, Array<Vector>& pnor) {
+    auto r = lines.chunk_lines(ichunk);
+    int i = *r.begin();
+    const int ub = i+int(r.size());
+    if (i>0 && i<ub && lines.line(i-1)[0]=='n') i++; // point is parsed with its normal in the previous chunk
+    Vector normal(0.f, 0.f, 0.f);
+    bool have_normal = false;
+    for (; i<ub || have_normal; i++) {
+        if (i==lines.num()) return false;
+        const char* s = lines.line(i);
+        const char type = s[0];
+        if (have_normal && type!='p') return false;
+        if (s==lines.line_end(i) || type=='#') continue;
+        if (!(type=='p' || type=='n' || type=='d' || type=='s' || type=='g') || s[1]!=' ') return false;
+        s++;
+        Vec3<float> f;
+        if (!parse_float(s, f[0]) || !parse_float(s, f[1]) || !parse_float(s, f[2])) return false;
+        if (type=='n') {
+            normal = Vector(f); have_normal = true;
+        } else if (type=='p') {
+            pco.push(Point(f)); pnor.push(normal);
+            normal = Vector(0.f, 0.f, 0.f); have_normal = false;
+        }                       // colors are ignored
+    }
+    return true;
+}
+
+void read_text_points(const TextLines& lines) {
+    {
+        // Chunks of lines are parsed concurrently.
+        const int nchunks = lines.num_chunks();
+        Array<Array<Point>> chunk_co(nchunks);
+        Array<Array<Vector>> chunk_nor(nchunks);
+        Array<bool> chunk_ok(nchunks);
+        parallel_for_each(range(nchunks), [&](const int ichunk) {
+            chunk_ok[ichunk] = parse_points(lines, ichunk, chunk_co[ichunk], chunk_nor[ichunk]);
+        }, TextLines::k_chunk_cycles);
+        if (!contains(chunk_ok, false)) {
+            for_int(ichunk, nchunks) {
+                co.push_array(chunk_co[ichunk]); chunk_co[ichunk].clear();
+                nor.push_array(chunk_nor[ichunk]); chunk_nor[ichunk].clear();
+            }
+        }
+    }
+    if (!co.num()) {            // general a3d stream (or no points)
+        std::istringstream iss(lines.buffer());
+        RSA3dStream ia3d(iss);
+        A3dElem el;
+        for (;;) {
+            ia3d.read(el);
+            if (el.type()==A3dElem::EType::endfile) break;
+            if (el.type()==A3dElem::EType::comment) continue;
+            assertx(el.type()==A3dElem::EType::point);
+            co.push(el[0].p);
+            nor.push(el[0].n);
+        }
+    }
+}
+
+// The points are copied in bulk rather than viewed, since compute_xform() modifies co[] in place.
+void read_binary_points(const BinaryPoints& bpoints) {
+    co = bpoints.points();
+    if (bpoints.normals().num()) {
+        nor = bpoints.normals();
+    } else {
+        nor.init(co.num(), Vector(0.f, 0.f, 0.f));
+    }
+}
+
 void process_read() {
     HH_TIMER(_read);
-    RSA3dStream ia3d(std::cin);
-    A3dElem el;
+    if (pointfile!="" && BinaryPoints::is_binary_points(pointfile)) {
+        read_binary_points(BinaryPoints(pointfile)); // memory-mapped
+    } else {
+        RFile fi(pointfile!="" ? pointfile : "-");
+        TextLines lines(fi());
+        const string& buffer = lines.buffer();
+        if (BinaryPoints::recognize(buffer.data(), buffer.size())) {
+            read_binary_points(BinaryPoints(buffer.data(), buffer.size()));
+        } else {
+            read_text_points(lines);
+        }
+    }
+    num = co.num();
     int nnor = 0;
-    for (;;) {
-        ia3d.read(el);
-        if (el.type()==A3dElem::EType::endfile) break;
-        if (el.type()==A3dElem::EType::comment) continue;
-        assertx(el.type()==A3dElem::EType::point);
-        co.push(el[0].p);
-        nor.push(el[0].n);
-        if (co[num][0]) is_3D = true;
-        if (!is_zero(nor[num])) {
+    for_int(i, num) {
+        if (co[i][0]) is_3D = true;
+        if (!is_zero(nor[i])) {
             nnor++;
-            if (usenormals) assertw(nor[num].normalize());
+            if (usenormals) assertw(nor[i].normalize());
         }
-        num++;
     }
     showdf("%d points (with %d normals), %dD analysis\n", num, nnor, (is_3D ? 3 : 2));
     assertx(num>1);
@@ -180,15 +265,30 @@ void init_output() {
     iom = process_arg('m');
 }
 
-void compute_tp(int i, int& n, Frame& f) {
+// Compute the tangent plane of point i from its nearest neighbors.
+// The neighbors (other than i) are appended to nei; they later form the edges of gpcpseudo,
+//  so that this function only reads shared state and may run concurrently.
+void compute_tp(int i, int& n, Frame& f, Array<int>& nei) {
     PArray<Point,40> pa;
-    SpatialSearch<int> ss(SPp.get(), co[i]);
-    for (;;) {
-        assertx(!ss.done());
-        float dis2; int pi = ss.next(&dis2);
-        if ((pa.num()>=minkintp && dis2>square(samplingd)) || pa.num()>=maxkintp) break;
+    auto func_consider = [&](int pi, float dis2) {
+        if ((pa.num()>=minkintp && dis2>square(samplingd)) || pa.num()>=maxkintp) return false;
         pa.push(co[pi]);
-        if (pi!=i && !gpcpseudo->contains(i, pi)) gpcpseudo->enter_undirected(i, pi);
+        if (pi!=i) nei.push(pi);
+        return true;
+    };
+    if (staticspatial) {
+        Array<std::pair<float,int>> best; // (dis2, pi) of the maxkintp closest points
+        down_cast<StaticPointSpatial*>(SPp.get())->knn_point(co[i], maxkintp, best);
+        for (const auto& pair : best) {
+            if (!func_consider(pair.second, pair.first)) break;
+        }
+    } else {
+        SpatialSearch<int> ss(SPp.get(), co[i]);
+        for (;;) {
+            assertx(!ss.done());
+            float dis2; int pi = ss.next(&dis2);
+            if (!func_consider(pi, dis2)) break;
+        }
     }
     Vec3<float> eimag;
     principal_components(pa, f, eimag);
@@ -241,14 +341,61 @@ void print_principal(const Frame& f) {
     }
 }
 
+// Evaluate all tangent planes concurrently using nt threads.  Each task covers a contiguous chunk of points and
+//  buffers its neighbor lists; the chunks are concatenated in point order into the adjacency lists (nei_beg, nei),
+//  so that these are identical to those of the serial traversal.
+void compute_tps_parallel(int nt, ArrayView<int> ar_n, ArrayView<Frame> ar_f, ArrayView<int> nei_beg,
+                          Array<int>& nei) {
+    const int chunk_size = 1024;
+    const int nchunks = (num+chunk_size-1)/chunk_size;
+    Array<Array<int>> chunk_nei(nchunks);
+    Array<int> ar_nnei(num);
+    {
+        HH_TIMER(__tps);
+        ThreadPoolIndexedTask thread_pool(nt);
+        thread_pool.execute(nchunks, [&](int c) {
+            Array<int>& nei = chunk_nei[c];
+            for_intL(i, c*chunk_size, min((c+1)*chunk_size, num)) {
+                int n0 = nei.num();
+                compute_tp(i, ar_n[i], ar_f[i], nei);
+                ar_nnei[i] = nei.num()-n0;
+            }
+        });
+    }
+    {
+        HH_TIMER(__tpmerge);
+        for_int(i, num) { nei_beg[i+1] = nei_beg[i]+ar_nnei[i]; }
+        nei.reserve(nei_beg[num]);
+        for_int(c, nchunks) {
+            nei.push_array(chunk_nei[c]);
+            chunk_nei[c].clear();
+        }
+    }
+}
+
 void process_principal() {
     HH_TIMER(_principal);
     // Statistics in reverse order of printout
     HH_STAT(Sr21); HH_STAT(Sr20); HH_STAT(Sr10);
     HH_STAT(Slen2); HH_STAT(Slen1); HH_STAT(Slen0);
     HH_STAT(Snei);
+    const int nt = min(nthreads ? nthreads : get_max_threads(), max(num/1024, 1));
+    Array<int> ar_n; Array<Frame> ar_f;
+    Array<int> nei_beg(num+1), nei; // the neighbors of point i are nei[nei_beg[i]] .. nei[nei_beg[i+1]-1]
+    nei_beg[0] = 0;
+    if (nt>1) {
+        showdf("Computing tangent planes using %d threads\n", nt);
+        ar_n.init(num); ar_f.init(num);
+        compute_tps_parallel(nt, ar_n, ar_f, nei_beg, nei);
+    }
     for_int(i, num) {
-        int n; Frame f; compute_tp(i, n, f);
+        int n; Frame f;
+        if (nt>1) {
+            n = ar_n[i]; f = ar_f[i];
+        } else {
+            compute_tp(i, n, f, nei);
+            nei_beg[i+1] = nei.num();
+        }
         if (ioo) pctrans[i] = f;
         Snei.enter(n);
         float len0 = mag(f.v(0)), len1 = mag(f.v(1)), len2 = mag(f.v(2));
@@ -260,6 +407,10 @@ void process_principal() {
         assertx(pcnor[i].normalize());
         print_principal(f);
     }
+    {
+        HH_TIMER(__graphedges);
+        gpcpseudo = adjacency_edges(nei_beg, nei);
+    }
     close_mk(iob); close_mk(iof); close_mk(iou);
     if (iod) {
         iod->diffuse(1.f, 1.f, .3f); iod->specular(0.f, 0.f, 0.f); iod->phong(1.f);
@@ -316,14 +467,13 @@ float pc_dot(int i, int j) {
     }
 }
 
-void add_exterior_orientation(const Set<int>& nodes) {
-    // vertex num is a pseudo-node used for outside orientation
-    gpcpseudo->enter(num);
+// Add pseudo-edges to the vertex num, a pseudo-node used for outside orientation.
+void add_exterior_orientation(CArrayView<int> nodes, Array<WEdge>& edges) {
     if (have_normals) {
         // add pseudo-edges from "exterior" to points with normals
         for (int i : nodes) {
             if (is_zero(nor[i])) continue;
-            gpcpseudo->enter_undirected(i, num);
+            edges.push(WEdge{i, num, pc_corr(i, num)});
         }
     } else {
         // add 1 pseudo-edge to point with largest z value
@@ -331,16 +481,10 @@ void add_exterior_orientation(const Set<int>& nodes) {
         for (int i : nodes) {
             if (pcorg[i][2]>maxz) { maxz = pcorg[i][2]; maxi = i; }
         }
-        gpcpseudo->enter_undirected(maxi, num);
+        edges.push(WEdge{maxi, num, pc_corr(maxi, num)});
     }
 }
 
-void remove_exterior_orientation() {
-    Array<int> ari; for (int j : gpcpseudo->edges(num)) { ari.push(j); }
-    for (int i : ari) { gpcpseudo->remove_undirected(num, i); }
-    gpcpseudo->remove(num);
-}
-
 void show_propagation(int i, int j, float dotp) {
     assertx(i>=0 && i<=num && j>=0 && j<num && dotp>=0);
     if (i==num || !iop) return;
@@ -352,38 +496,37 @@ void show_propagation(int i, int j, float dotp) {
     iop->end_polyline();
 }
 
-// Propagate orientation along tree gpcpath from vertex i (orig. num) using recursive DFS.
-void propagate_along_path(int i) {
-    assertx(i>=0 && i<=num);
-    if (i<num) assertx(pciso[i]);
-    for (int j : gpcpath->edges(i)) {
-        assertx(j>=0 && j<=num);
-        if (j==num || pciso[j]) continue; // immediate caller
+// Flat adjacency lists of the undirected edges over vertices [0, nv).
+void edge_adjacency(int nv, CArrayView<WEdge> edges, Array<int>& nei_beg, Array<int>& nei) {
+    nei_beg.init(nv+1, 0);
+    for (const WEdge& e : edges) { nei_beg[e.v1+1]++; nei_beg[e.v2+1]++; }
+    for_int(i, nv) { nei_beg[i+1] += nei_beg[i]; }
+    nei.init(nei_beg[nv]);
+    Array<int> nfilled(nv, 0);
+    for (const WEdge& e : edges) {
+        nei[nei_beg[e.v1]+nfilled[e.v1]++] = e.v2;
+        nei[nei_beg[e.v2]+nfilled[e.v2]++] = e.v1;
+    }
+}
+
+// Propagate orientation along the tree (nei_beg, nei) from vertex i (orig. num) to j and the subtree beyond j,
+//  using an explicit DFS stack.
+void propagate_along_path(CArrayView<int> nei_beg, CArrayView<int> nei, int i0, int j0) {
+    Array<Vec2<int>> stack;
+    stack.push(V(i0, j0));
+    while (stack.num()) {
+        const Vec2<int> ij = stack.pop();
+        const int i = ij[0], j = ij[1];
+        assertx(i>=0 && i<=num && j>=0 && j<num && !pciso[j]);
         float corr = pc_dot(i, j);
         pScorr->enter(abs(corr));
         if (corr<0) pcnor[j] = -pcnor[j];
         pciso[j] = true;
         show_propagation(i, j, abs(corr));
-        propagate_along_path(j);
-    }
-}
-
-void orient_set(const Set<int>& nodes) {
-    showdf("component with %d points\n", nodes.num());
-    add_exterior_orientation(nodes);
-    gpcpath = make_unique<Graph<int>>();
-    for (int i : nodes) { gpcpath->enter(i); }
-    gpcpath->enter(num);
-    {
-        HH_TIMER(__graphmst);
-        // must be connected here!
-        assertx(graph_mst<int>(*gpcpseudo, pc_corr, *gpcpath));
+        for_intL(k, nei_beg[j], nei_beg[j+1]) {
+            if (nei[k]!=num && !pciso[nei[k]]) stack.push(V(j, nei[k]));
+        }
     }
-    int nextlink = gpcpath->out_degree(num);
-    if (nextlink>1) showdf(" num_exteriorlinks_used=%d\n", nextlink);
-    propagate_along_path(num);
-    gpcpath = nullptr;
-    remove_exterior_orientation();
 }
 
 float pc_dist(int e1, int e2) {
@@ -411,14 +554,12 @@ void draw_oriented_tps() {
     }
 }
 
-void print_graph(Mk3d& mk, const Graph<int>& g, CArrayView<Point> pa, CArrayView<Vector>* pn) {
-    for_int(i, num) {
-        for (int j : g.edges(i)) {
-            if (j>=i) continue;
-            mk.point(pa[i]*xformi); if (pn) mk.normal((*pn)[i]);
-            mk.point(pa[j]*xformi); if (pn) mk.normal((*pn)[j]);
-            mk.end_polyline();
-        }
+void print_graph(Mk3d& mk, CArrayView<WEdge> edges, CArrayView<Point> pa, CArrayView<Vector>* pn) {
+    for (const WEdge& e : edges) {
+        const int i = e.v2, j = e.v1;
+        mk.point(pa[i]*xformi); if (pn) mk.normal((*pn)[i]);
+        mk.point(pa[j]*xformi); if (pn) mk.normal((*pn)[j]);
+        mk.end_polyline();
     }
 }
 
@@ -432,36 +573,66 @@ void orient_tp() {
         return;
     }
     {
-        Stat stat = graph_edge_stats<int>(*gpcpseudo, pc_dist);
-        stat.set_name("gpcpseudo"); stat.set_print(true);
+        Stat stat("gpcpseudo", true);
+        for (const WEdge& e : gpcpseudo) { stat.enter(pc_dist(e.v1, e.v2)); }
     }
+    parallel_for_each(range(gpcpseudo.num()), [&](const int i) {
+        gpcpseudo[i].w = pc_corr(gpcpseudo[i].v1, gpcpseudo[i].v2);
+    }, uint64_t{30});
+    // The minimum spanning forest of gpcpseudo identifies its connected components.
+    Array<WEdge> forest;
     {
-        HH_TIMER(__graphnumcompon);
-        int nc = graph_num_components(*gpcpseudo);
-        showdf("Number of components: %d\n", nc);
-        if (nc>1) showdf("*** #comp>1, may want larger -samp\n");
+        HH_TIMER(__graphmst);
+        forest = mst_edges(num, gpcpseudo);
     }
+    const int nc = num-forest.num();
+    showdf("Number of components: %d\n", nc);
+    if (nc>1) showdf("*** #comp>1, may want larger -samp\n");
     if (iog) {
         iog->diffuse(.7f, .7f, .7f); iog->specular(0.f, 0.f, 0.f); iog->phong(1.f);
-        print_graph(*iog, *gpcpseudo.get(), pcorg, nullptr);
+        print_graph(*iog, gpcpseudo, pcorg, nullptr);
         close_mk(iog);
     }
-    // Now treat each connected component of gpcpseudo separately.
-    Set<int> setnotvis; for_int(i, num) { setnotvis.enter(i); }
-    while (!setnotvis.empty()) {
-        Set<int> nodes;
-        Queue<int> queue;
-        int fi = setnotvis.get_one();
-        nodes.enter(fi); queue.enqueue(fi);
-        while (!queue.empty()) {
-            int i = queue.dequeue();
-            assertx(setnotvis.remove(i));
-            for (int j : gpcpseudo->edges(i)) {
-                if (nodes.add(j)) queue.enqueue(j);
+    Array<int> nei_beg, nei;
+    edge_adjacency(num, forest, nei_beg, nei);
+    Array<Array<int>> components;
+    {
+        Array<bool> visited(num, false);
+        for_int(i0, num) {
+            if (visited[i0]) continue;
+            components.push(Array<int>());
+            Array<int>& nodes = components.last();
+            nodes.push(i0); visited[i0] = true;
+            for (int k = 0; k<nodes.num(); k++) { // breadth-first traversal
+                int i = nodes[k];
+                for_intL(kk, nei_beg[i], nei_beg[i+1]) {
+                    int j = nei[kk];
+                    if (!visited[j]) { visited[j] = true; nodes.push(j); }
+                }
             }
         }
+    }
+    assertx(components.num()==nc);
+    // Adding the exterior pseudo-node num to the graph only requires its edges to be added to the forest.
+    Array<WEdge> tree;
+    {
+        HH_TIMER(__exteriormst);
+        Array<WEdge> edges(forest);
+        for (const Array<int>& nodes : components) { add_exterior_orientation(nodes, edges); }
+        tree = mst_edges(num+1, edges);
+    }
+    edge_adjacency(num+1, tree, nei_beg, nei);
+    Array<int> component_of(num);
+    for_int(ic, nc) { for (int i : components[ic]) component_of[i] = ic; }
+    Array<Array<int>> exterior_links(nc);
+    for_intL(k, nei_beg[num], nei_beg[num+1]) { exterior_links[component_of[nei[k]]].push(nei[k]); }
+    // Now treat each connected component of gpcpseudo separately.
+    for_int(ic, nc) {
+        showdf("component with %d points\n", components[ic].num());
+        assertx(exterior_links[ic].num()); // must be connected here!
+        if (exterior_links[ic].num()>1) showdf(" num_exteriorlinks_used=%d\n", exterior_links[ic].num());
         pScorr = make_unique<Stat>("Scorr", true);
-        orient_set(nodes);
+        for (int i : exterior_links[ic]) { propagate_along_path(nei_beg, nei, num, i); }
         pScorr = nullptr;
     }
     for_int(i, num) { assertx(pciso[i]); }
@@ -470,7 +641,7 @@ void orient_tp() {
     close_mk(ioo);
     if (ioh) {
         ioh->diffuse(.7f, .7f, .7f); ioh->specular(0.f, 0.f, 0.f); ioh->phong(1.f);
-        print_graph(*ioh, *gpcpseudo.get(), pcorg, &pcnor);
+        print_graph(*ioh, gpcpseudo, pcorg, &pcnor);
         close_mk(ioh);
     }
 }
@@ -521,6 +692,44 @@ float compute_signed(const Point& p, Point& proj) {
     return dis;
 }
 
+// Same as compute_unsigned() or compute_signed() (without the projections) for many points at once, using the
+//  batched nearest-neighbor queries of StaticPointSpatial.
+void compute_batch(CArrayView<Point> pa, ArrayView<float> vals) {
+    const int n = pa.num();
+    const StaticPointSpatial& spp = *down_cast<StaticPointSpatial*>(SPp.get());
+    Matrix<float> dis2;
+    if (unsigneddis) {
+        Matrix<int> mi = spp.knn(pa, 1);
+        for_int(i, n) { vals[i] = dist(pa[i], co[mi[i][0]])-unsigneddis; }
+        return;
+    }
+    Matrix<int> mtpi = down_cast<StaticPointSpatial*>(SPpc.get())->knn(pa, 1);
+    Array<Point> projs; projs.reserve(n);
+    Array<int> iprojs; iprojs.reserve(n); // index in pa of each of projs
+    for_int(i, n) {
+        const int tpi = mtpi[i][0];
+        float dis = dot(pa[i]-pcorg[tpi], pcnor[tpi]);
+        Point proj = pa[i]-dis*pcnor[tpi];
+        if (!is_3D) assertx(!proj[0]);
+        if ((is_3D && (proj[0]<=0 || proj[0]>=1)) || proj[1]<=0 || proj[1]>=1 || proj[2]<=0 || proj[2]>=1) {
+            vals[i] = k_Contour_undefined;
+            continue;
+        }
+        vals[i] = dis;
+        projs.push(proj); iprojs.push(i);
+    }
+    // Check that each projected point is close to a data point.
+    spp.knn(projs, 1, &dis2);
+    for_int(j, projs.num()) { if (dis2[j][0]>square(samplingd)) vals[iprojs[j]] = k_Contour_undefined; }
+    if (prop) {
+        // Check that each grid point is close to a data point.
+        spp.knn(pa, 1, &dis2);
+        float grid_diagonal2 = square(1.f/gridsize)*3.f;
+        const float fudge = 1.2f;
+        for_int(i, n) { if (dis2[i][0]>grid_diagonal2*square(fudge)) vals[i] = k_Contour_undefined; }
+    }
+}
+
 void print_directed_seg(Mk3d& mk, const Point& p1, const Point& p2, const A3dColor& col) {
     Vector v = p2-p1;
     assertx(v.normalize());
@@ -550,6 +759,24 @@ template<int D> struct eval_point {
         }
         return dis;
     }
+    // Batch evaluation of the new grid vertices of a queue frontier (Contour3DMesh) or of a round of bricks
+    //  (BrickContour3DMesh).  With -staticspatial, each search stage is one batched k-NN query over all the points;
+    //  otherwise the nearest-neighbor searches are independent, so they run concurrently unless -nthreads 1.
+    //  Segments written to iol require the one-at-a-time evaluation.
+    void operator()(CArrayView<Vec<float,D>> pts, ArrayView<float> vals) const {
+        if (iol) {
+            for_int(i, pts.num()) { vals[i] = (*this)(pts[i]); }
+        } else if (staticspatial) {
+            ASSERTX((D==3)==is_3D);
+            Array<Point> pa(pts.num());
+            for_int(i, pts.num()) { pa[i] = build_Point(pts[i]); }
+            compute_batch(pa, vals);
+        } else if (nthreads==1) {
+            for_int(i, pts.num()) { vals[i] = (*this)(pts[i]); }
+        } else {
+            parallel_for_each(range(pts.num()), [&](const int i) { vals[i] = (*this)(pts[i]); }, 2000);
+        }
+    }
 };
 
 struct output_border3D {
@@ -627,6 +854,12 @@ void process_contour() {
         if (ioc) {
             Contour3DMesh<eval_point<3>, output_border3D> contour(gridsize, &mesh);
             contour_3D(contour);
+        } else if (brickcontour && nthreads!=1 && !iol && !unsigneddis) {
+            // Bricks are marched concurrently; the mesh is independent of the number of threads.
+            BrickContour3DMesh<eval_point<3>> contour(gridsize, &mesh, eval_point<3>(), nthreads);
+            contour.set_ostream(&std::cout);
+            for_int(i, num) { contour.march_from(pcorg[i]); }
+            contour.march();
         } else {
             Contour3DMesh<eval_point<3>> contour(gridsize, &mesh);
             contour_3D(contour);
@@ -645,6 +878,108 @@ void process_contour() {
     close_mk(iol);
 }
 
+// *** Screened Poisson reconstruction (-poisson)
+
+// The oriented points are splatted into a vector field V over the (gridsize+1)^3 contouring grid vertices, and
+//  the indicator function chi is the solution of (Laplacian - screening)*chi = -div(V), computed with multigrid
+//  V-cycles in grid units.  Chi is larger inside the object; the surface is the level set of chi at its mean value
+//  over the data points.
+
+Grid<3,float> g_poisson;        // indicator function at the grid vertices
+float g_poisson_iso;            // level set value
+
+// Trilinear interpolation cell and weights of a point in the unit cube.
+void poisson_cell(const Point& p, Vec3<int>& u0, Vec3<float>& t) {
+    for_int(c, 3) {
+        float f = clamp(p[c]*gridsize, 0.f, float(gridsize));
+        u0[c] = min(int(f), gridsize-1);
+        t[c] = f-u0[c];
+    }
+}
+
+float poisson_interp(const Point& p) {
+    Vec3<int> u0; Vec3<float> t; poisson_cell(p, u0, t);
+    float v = 0.f;
+    for (const auto& d : range(thrice(2))) {
+        float w = 1.f; for_int(c, 3) { w *= d[c] ? t[c] : 1.f-t[c]; }
+        v += w*g_poisson[u0+d];
+    }
+    return v;
+}
+
+struct eval_poisson {
+    float operator()(const Vec3<float>& p) const { // p is always a grid vertex
+        Vec3<int> u; for_int(c, 3) { u[c] = int(p[c]*gridsize+.5f); }
+        return g_poisson_iso-g_poisson[u]; // negative inside
+    }
+};
+
+void compute_poisson(CArrayView<Point> pts, CArrayView<Vector> nors) {
+    HH_TIMER(_poisson);
+    const Vec3<int> dims = thrice(gridsize+1);
+    Multigrid<3,float> multigrid(dims);
+    {
+        HH_TIMER(__splat);
+        Array<Grid<3,float>> gvec; for_int(c, 3) { gvec.push(Grid<3,float>(dims, 0.f)); }
+        for_int(i, pts.num()) {
+            Vec3<int> u0; Vec3<float> t; poisson_cell(pts[i], u0, t);
+            for (const auto& d : range(thrice(2))) {
+                float w = 1.f; for_int(c, 3) { w *= d[c] ? t[c] : 1.f-t[c]; }
+                for_int(c, 3) { gvec[c][u0+d] += w*nors[i][c]; }
+            }
+        }
+        GridView<3,float> grhs = multigrid.rhs();
+        parallel_for_coords(dims, [&](const Vec3<int>& u) {
+            float div = 0.f;    // central differences, one-sided at the domain boundary
+            for_int(c, 3) {
+                int i0 = max(u[c]-1, 0), i1 = min(u[c]+1, dims[c]-1);
+                div += (gvec[c][u.with(c, i1)]-gvec[c][u.with(c, i0)])/float(i1-i0);
+            }
+            grhs[u] = -div;
+        });
+    }
+    fill(multigrid.initial_estimate(), 0.f);
+    multigrid.set_desired_mean(0.f); // the pure Poisson system (no screening) is defined up to a constant
+    multigrid.set_screening_weight(screening);
+    if (vcycles) multigrid.set_num_vcycles(vcycles);
+    {
+        HH_TIMER(__solve);
+        multigrid.solve();
+    }
+    g_poisson = Grid<3,float>(multigrid.result());
+    Array<float> ar_val(pts.num());
+    parallel_for_each(range(pts.num()), [&](const int i) { ar_val[i] = poisson_interp(pts[i]); });
+    g_poisson_iso = float(mean(ar_val));
+    showdf("Poisson grid %d^3, level set value %g\n", gridsize+1, g_poisson_iso);
+}
+
+void process_poisson_contour() {
+    HH_TIMER(_contour);
+    if (ioc) {
+        Contour3DMesh<eval_poisson, output_border3D> contour(gridsize, &mesh);
+        contour.set_ostream(&std::cout);
+        for_int(i, num) { contour.march_from(co[i]); }
+    } else if (brickcontour && nthreads!=1) {
+        BrickContour3DMesh<eval_poisson> contour(gridsize, &mesh, eval_poisson(), nthreads);
+        contour.set_ostream(&std::cout);
+        for_int(i, num) { contour.march_from(co[i]); }
+        contour.march();
+    } else {
+        Contour3DMesh<eval_poisson> contour(gridsize, &mesh);
+        contour.set_ostream(&std::cout);
+        for_int(i, num) { contour.march_from(co[i]); }
+    }
+    close_mk(ioc);
+    g_poisson = Grid<3,float>();
+}
+
+unique_ptr<Spatial> make_spatial(int gn, CArrayView<Point> ar) {
+    if (staticspatial) return make_unique<StaticPointSpatial>(gn, ar);
+    auto psp = make_unique<PointSpatial<int>>(gn);
+    for_int(i, ar.num()) { psp->enter(i, &ar[i]); }
+    return std::move(psp);
+}
+
 void process() {
     HH_TIMER(Recon);
     process_read();
@@ -663,23 +998,27 @@ void process() {
     {
         HH_TIMER(_SPp);
         int n = is_3D ? (num>100000 ? 60 : num>5000 ? 36 : 20) : (num>1000 ? 36 : 20);
-        SPp = make_unique<PointSpatial<int>>(n);
-        for_int(i, num) { SPp->enter(i, &co[i]); }
+        SPp = make_spatial(n, co);
     }
-    if (!unsigneddis) {
-        gpcpseudo = make_unique<Graph<int>>();
-        for_int(i, num) { gpcpseudo->enter(i); }
+    // With -poisson and exact data normals (-usenormals 3), the tangent planes are not needed.
+    if (poisson) assertx(is_3D);
+    const bool data_normals = poisson && have_normals && usenormals==3;
+    if (!unsigneddis && !data_normals) {
         process_principal();
         {
             HH_TIMER(_SPpc);
             int n = is_3D ? (num>100000 ? 60 : num>5000 ? 36 : 20) : (num>1000 ? 36 : 20);
-            SPpc = make_unique<PointSpatial<int>>(n);
-            for_int(i, num) { SPpc->enter(i, &pcorg[i]); }
+            SPpc = make_spatial(n, pcorg);
         }
         orient_tp();
-        gpcpseudo = nullptr;
+        gpcpseudo.clear();
+    }
+    if (poisson) {
+        compute_poisson(co, data_normals ? nor : pcnor);
+        if (ioc || iom) process_poisson_contour();
+    } else if (iol || ioc || iom) {
+        process_contour();
     }
-    if (iol || ioc || iom) process_contour();
     if (iom && is_3D) showdf("%s\n", mesh_genus_string(mesh).c_str());
     SPp = nullptr;
     SPpc = nullptr;
@@ -689,17 +1028,25 @@ void process() {
 
 int main(int argc, const char** argv) {
     ParseArgs args(argc, argv);
+    ARGSP(pointfile,            "file : read points (a3d or binary) from file rather than stdin");
     ARGSP(rootname,             "string : name for output files (optional)");
     ARGSP(what,                 "string : output codes 'dbufgpohlcm' (default mesh 'm')");
     ARGSP(samplingd,            "f : sampling density + noise (delta+rho)");
     ARGSP(gridsize,             "n : contouring # grid cells (opt.)");
     ARGSP(maxkintp,             "k : max # points in tp");
     ARGSP(minkintp,             "k : min # points in tp");
+    ARGSP(nthreads,             "n : # threads for tangent planes and contouring (0=all cores)");
+    ARGSF(brickcontour,         ": contour the mesh in concurrent bricks (vertex/face order differs)");
+    ARGSF(staticspatial,        ": use read-only point index with batched k-NN queries");
+    ARGSF(poisson,              ": reconstruct by screened Poisson solve on the grid (3D)");
+    ARGSP(screening,            "f :  screening weight of Poisson system");
+    ARGSP(vcycles,              "n :  number of multigrid V-cycles (0=default)");
     ARGSP(unsigneddis,          "f : use unsigned distance, set value");
     ARGSP(prop,                 "i : orient. prop. (0=naive, 1=emst, 2=mst)");
     ARGSP(usenormals,           "i : use data normals (1=orient_opt, 2=orient, 3=exact)");
     args.parse();
     assertx(samplingd);
+    if (poisson) assertx(!unsigneddis && !contains(what, 'l'));
     g_header = args.header();
     showdf("%s", g_header.c_str());
     process();
@@ -1,4 +1,8 @@
 // -*- C++ -*-  Copyright (c) Microsoft Corporation; see license.txt
+#include <atomic>               // std::atomic<>
+#include <fstream>              // std::ofstream, std::ifstream
+#include <functional>           // std::function<>
+
 #include "Args.h"
 #include "PMesh.h"
 #include "GMesh.h"
@@ -6,6 +10,15 @@
 #include "FileIO.h"
 #include "Timer.h"
 #include "Stat.h"
+#include "Bbox.h"
+#include "Map.h"
+#include "Set.h"
+#include "Queue.h"
+#include "TextParse.h"          // parse_int(), parse_float()
+#include "Parallel.h"
+#include "RangeOp.h"
+#include "StringOp.h"
+#include "Locks.h"
 using namespace hh;
 
 namespace {
@@ -14,6 +27,12 @@ string rootname;
 int blockx;
 int blocky;
 int blocks;
+int tiles = 4;                  // number of tiles along the longest axis of the bounding box
+int nfaces = 0;                 // number of faces desired in the tiled simplification
+string simplifier = "MeshSimplify -minqem"; // command (and options) used to simplify the tiles and the seams
+int seamrings = 2;              // rings of vertices about the tile seams that are free in the seam pass
+bool keeptiles = false;         // do not delete the tile files
+int maxprocs = 0;               // maximum number of concurrent simplifier processes (0: hardware threads)
 
 Matrix<PMesh> pmeshes;
 PMesh pmesh;
@@ -206,6 +225,447 @@ void do_stitch() {
     pmesh.write(std::cout);
 }
 
+// *** tiled simplification
+
+// The input mesh is never held in memory: it is streamed twice and partitioned into tile files on disk, which are
+//  then simplified concurrently by separate processes.  The association of vertices, faces, and tiles is
+//  computed by joins over temporary bucket files, each covering k_bucket_ids consecutive vertex or face ids, so
+//  that memory is bounded by the bucket size and by the number of seam vertices, regardless of input size.
+// Temporary files are written through a FileAppender, which keeps no file open between writes, so the number of
+//  tiles and buckets is not limited by the number of open file descriptors.
+
+constexpr int k_bucket_ids = 1<<20;     // number of vertex or face ids in each temporary bucket
+
+Vec3<int> tile_dims;            // number of tiles along each axis
+Bbox tile_bbox;
+float tile_size;
+int num_vbuckets;               // vertex id buckets
+int num_fbuckets;               // face id buckets
+Set<int> seamv;                 // ids of the seam vertices (used by faces of several tiles)
+Set<int> vring;                 // ids of the vertices adjacent to seam vertices
+Array<int> tile_nfaces;         // tile -> number of faces
+Array<int> tile_nseamfaces;     // tile -> number of faces adjacent to a seam vertex (left for the seam pass)
+int next_split_vid;             // next unused vertex id, for vertices split in tiles
+Map<int, int> split_vid;        // id of a vertex split in a tile -> id of the original input vertex
+
+string tile_filename(int t, const string& suffix) { return sform("%s.t%d.%s", rootname.c_str(), t, suffix.c_str()); }
+
+string bucket_filename(const string& kind, int b) { return sform("%s.%s%d", rootname.c_str(), kind.c_str(), b); }
+
+void remove_file(const string& fname) { assertw(!std::remove(fname.c_str())); }
+
+// Appends data to a set of files, buffering it in memory and keeping no file open between flushes.
+class FileAppender : noncopyable {
+ public:
+    FileAppender(int nfiles, std::function<string(int)> func_filename)
+        : _func_filename(std::move(func_filename)), _buf(nfiles), _written(nfiles, false),
+          _max_buf(max(size_t{4096}, k_buffer_budget/max(nfiles, 1))) { }
+    ~FileAppender()                             { flush(); }
+    void append(int i, const char* data, size_t n) {
+        _buf[i].append(data, n);
+        if (_buf[i].size()>=_max_buf) flush(i);
+    }
+    void append_line(int i, const string& sline) { append(i, sline.data(), sline.size()); append(i, "\n", 1); }
+    void append_pair(int i, int v0, int v1) {
+        Vec2<int> rec(v0, v1); append(i, reinterpret_cast<const char*>(rec.data()), sizeof(rec));
+    }
+    void flush()                                { for_int(i, _buf.num()) { flush(i); } }
+    bool written(int i) const                   { return _written[i]; } // valid after flush()
+    void remove_files() {
+        for_int(i, _buf.num()) { if (_written[i]) remove_file(_func_filename(i)); }
+        fill(_written, false);
+    }
+ private:
+    static constexpr size_t k_buffer_budget = size_t{64}<<20; // total bytes buffered across all files
+    std::function<string(int)> _func_filename;
+    Array<string> _buf;
+    Array<bool> _written;
+    size_t _max_buf;
+    void flush(int i) {
+        if (_buf[i].empty()) return;
+        std::ofstream os(_func_filename(i), std::ios::binary | (_written[i] ? std::ios::app : std::ios::trunc));
+        os.write(_buf[i].data(), _buf[i].size());
+        assertx(os);
+        _buf[i].clear();
+        _written[i] = true;
+    }
+};
+
+// Call func(v0, v1) for each record written by FileAppender::append_pair().
+template<typename Func> void read_pairs(const string& fname, Func func) {
+    std::ifstream is(fname, std::ios::binary);
+    assertx(is);
+    for (Vec2<int> rec; is.read(reinterpret_cast<char*>(rec.data()), sizeof(rec)); ) func(rec[0], rec[1]);
+}
+
+int point_tile(const Point& p) {
+    Vec3<int> ci;
+    for_int(c, 3) ci[c] = clamp(int((p[c]-tile_bbox[0][c])/tile_size), 0, tile_dims[c]-1);
+    return (ci[2]*tile_dims[1]+ci[1])*tile_dims[0]+ci[0];
+}
+
+// A vertex is on a seam if it is used by the faces of more than one tile; it is then locked in each tile.
+// The vertices adjacent to the seams are also locked, so that no tile can create an edge joining two seam vertices
+//  (which a neighboring tile could create as well).
+bool is_locked_vertex(int vi) { return seamv.contains(vi) || vring.contains(vi); }
+
+// Parse a "Vertex vi x y z {...}" line; return false if it is not one.
+bool parse_vertex_line(const string& sline, int& vi, Point& p) {
+    if (!begins_with(sline, "Vertex ")) return false;
+    const char* s = sline.c_str()+7;
+    assertx(parse_int(s, vi) && parse_float(s, p[0]) && parse_float(s, p[1]) && parse_float(s, p[2]));
+    return true;
+}
+
+// Parse a "Face fi v1 v2 v3 ... {...}" line; return false if it is not one.
+bool parse_face_line(const string& sline, int& fi, Array<int>& vis) {
+    if (!begins_with(sline, "Face ")) return false;
+    const char* s = sline.c_str()+5;
+    assertx(parse_int(s, fi));
+    vis.init(0);
+    for (int vi; parse_int(s, vi); ) vis.push(vi);
+    assertx(vis.num()>=3);
+    return true;
+}
+
+// Return the mesh line with the key "global" added to its string (so that MeshSimplify -keepglobalv keeps it).
+string add_global_key(const string& sline) {
+    const size_t i = sline.find('{');
+    if (i==string::npos) return sline+" {global}";
+    const size_t j = sline.rfind('}'); assertx(j!=string::npos && j>i);
+    return sline.substr(0, i)+"{"+GMesh::string_update(sline.substr(i+1, j-i-1), "global", "")+"}";
+}
+
+// For the vertices of bucket b, gather the tiles whose faces use each vertex.
+void read_vertex_usage(int b, Map<int, Array<int>>& usage) {
+    usage.clear();
+    read_pairs(bucket_filename("vu", b), [&](int vi, int t) {
+        Array<int>& ar = usage[vi];
+        if (!ar.contains(t)) ar.push(t);
+    });
+}
+
+void partition_tiles(const string& filename) {
+    HH_TIMER(_partition);
+    int max_vid = -1, max_fid = -1;
+    {
+        HH_TIMER(__bbox);
+        tile_bbox.clear();
+        RFile fi(filename);
+        int vi, fid; Point p; Array<int> vis;
+        for (string sline; my_getline(fi(), sline); ) {
+            if (parse_vertex_line(sline, vi, p)) {
+                assertx(vi>=0); max_vid = max(max_vid, vi);
+                tile_bbox.union_with(p);
+            } else if (parse_face_line(sline, fid, vis)) {
+                assertx(fid>=0); max_fid = max(max_fid, fid);
+            }
+        }
+        assertx(tile_bbox[0][0]<=tile_bbox[1][0] && max_fid>=0);
+        tile_size = max(tile_bbox.max_side()/tiles, 1e-20f);
+        for_int(c, 3) tile_dims[c] = max(int(std::ceil((tile_bbox[1][c]-tile_bbox[0][c])/tile_size)), 1);
+        next_split_vid = max_vid+1;
+        num_vbuckets = max_vid/k_bucket_ids+1;
+        num_fbuckets = max_fid/k_bucket_ids+1;
+    }
+    const int ntiles = product(tile_dims);
+    tile_nfaces.init(ntiles, 0);
+    tile_nseamfaces.init(ntiles, 0);
+    FileAppender vt(num_vbuckets, [](int b) { return bucket_filename("vt", b); }); // (vertex id, vertex tile)
+    FileAppender vl(num_vbuckets, [](int b) { return bucket_filename("vl", b); }); // vertex lines
+    FileAppender vf(num_vbuckets, [](int b) { return bucket_filename("vf", b); }); // (vertex id, face id)
+    FileAppender vu(num_vbuckets, [](int b) { return bucket_filename("vu", b); }); // (vertex id, face tile)
+    FileAppender fl(num_fbuckets, [](int b) { return bucket_filename("fl", b); }); // face and corner lines
+    FileAppender ft(num_fbuckets, [](int b) { return bucket_filename("ft", b); }); // (face id, vertex tile)
+    FileAppender tv(ntiles, [](int t) { return tile_filename(t, "v"); });          // vertex lines of each tile
+    FileAppender tf(ntiles, [](int t) { return tile_filename(t, "f"); });          // face lines of each tile
+    {
+        HH_TIMER(__buckets);
+        RFile fi(filename);
+        int vi, fid; Point p; Array<int> vis;
+        for (string sline; my_getline(fi(), sline); ) {
+            if (parse_vertex_line(sline, vi, p)) {
+                vt.append_pair(vi/k_bucket_ids, vi, point_tile(p));
+                vl.append_line(vi/k_bucket_ids, sline);
+            } else if (parse_face_line(sline, fid, vis)) {
+                for (int vj : vis) { assertx(vj>=0 && vj<=max_vid); vf.append_pair(vj/k_bucket_ids, vj, fid); }
+                fl.append_line(fid/k_bucket_ids, sline);
+            } else if (begins_with(sline, "Corner ")) {
+                const char* s = sline.c_str()+7;
+                assertx(parse_int(s, vi) && parse_int(s, fid) && fid>=0 && fid<=max_fid);
+                fl.append_line(fid/k_bucket_ids, sline);
+            } else if (sline!="" && sline[0]!='#') {
+                Warning("Tiled simplification ignores lines other than Vertex, Face, and Corner");
+            }
+        }
+        vt.flush(); vl.flush(); vf.flush(); fl.flush();
+    }
+    {
+        // Send the tile of each vertex to the faces using it.
+        HH_TIMER(__join_vertices);
+        Array<int> vtile;
+        for_int(b, num_vbuckets) {
+            if (!vf.written(b)) continue;
+            vtile.init(k_bucket_ids); fill(vtile, -1);
+            if (vt.written(b))
+                read_pairs(bucket_filename("vt", b), [&](int vi, int t) { vtile[vi%k_bucket_ids] = t; });
+            read_pairs(bucket_filename("vf", b), [&](int vi, int fid) {
+                const int t = vtile[vi%k_bucket_ids];
+                assertx(t>=0);  // the vertex must be defined
+                ft.append_pair(fid/k_bucket_ids, fid, t);
+            });
+        }
+        vf.remove_files();
+        ft.flush();
+    }
+    {
+        // Assign each face to the lowest-numbered tile of its vertices (so that the faces of a tile about each
+        //  vertex remain contiguous), and write the faces (and their corners) to per-tile files.
+        HH_TIMER(__faces);
+        Array<int> ftile;
+        for_int(b, num_fbuckets) {
+            if (!fl.written(b)) continue;
+            ftile.init(k_bucket_ids); fill(ftile, std::numeric_limits<int>::max());
+            read_pairs(bucket_filename("ft", b), [&](int fid, int t) {
+                int& ft0 = ftile[fid%k_bucket_ids]; ft0 = min(ft0, t);
+            });
+            RFile fi(bucket_filename("fl", b));
+            int vi, fid; Array<int> vis;
+            for (string sline; my_getline(fi(), sline); ) {
+                if (parse_face_line(sline, fid, vis)) {
+                    const int t = ftile[fid%k_bucket_ids];
+                    tile_nfaces[t]++;
+                    for (int vj : vis) vu.append_pair(vj/k_bucket_ids, vj, t);
+                    tf.append_line(t, sline);
+                } else {
+                    const char* s = sline.c_str()+7;
+                    assertx(parse_int(s, vi) && parse_int(s, fid));
+                    const int t = ftile[fid%k_bucket_ids];
+                    if (t==std::numeric_limits<int>::max()) {
+                        Warning("Tiled simplification ignores Corner lines of absent faces"); continue;
+                    }
+                    tf.append_line(t, sline);
+                }
+            }
+        }
+        ft.remove_files(); fl.remove_files(); vt.remove_files();
+        vu.flush(); tf.flush();
+    }
+    {
+        HH_TIMER(__seams);
+        Map<int, Array<int>> usage;
+        for_int(b, num_vbuckets) {
+            if (!vu.written(b)) continue;
+            read_vertex_usage(b, usage);
+            for (auto& kv : usage) { if (kv.second.num()>1) seamv.enter(kv.first); }
+        }
+    }
+    {
+        HH_TIMER(__ring);
+        for_int(t, ntiles) {
+            if (!tile_nfaces[t]) continue;
+            RFile fi(tile_filename(t, "f"));
+            int fid; Array<int> vis;
+            for (string sline; my_getline(fi(), sline); ) {
+                if (!parse_face_line(sline, fid, vis)) continue;
+                bool adjacent = false;
+                for (int vj : vis) { if (seamv.contains(vj)) adjacent = true; }
+                if (!adjacent) continue;
+                tile_nseamfaces[t]++;
+                for (int vj : vis) { if (!seamv.contains(vj)) vring.add(vj); }
+            }
+        }
+    }
+    {
+        // Write the vertices used by each tile, locking the seam vertices, followed by the faces of the tile.
+        HH_TIMER(__tiles);
+        Map<int, Array<int>> usage;
+        for_int(b, num_vbuckets) {
+            if (!vu.written(b)) continue;
+            read_vertex_usage(b, usage);
+            RFile fi(bucket_filename("vl", b));
+            int vi; Point p;
+            for (string sline; my_getline(fi(), sline); ) {
+                assertx(parse_vertex_line(sline, vi, p));
+                bool present; const Array<int>& ar = usage.retrieve(vi, present);
+                if (!present) continue;
+                const string str = is_locked_vertex(vi) ? add_global_key(sline) : sline;
+                for (int t : ar) tv.append_line(t, str);
+            }
+        }
+        vu.remove_files(); vl.remove_files();
+        tv.flush();
+        for_int(t, ntiles) {
+            if (!tile_nfaces[t]) continue;
+            WFile fo(tile_filename(t, "m"));
+            for (const string& fname : {tile_filename(t, "v"), tile_filename(t, "f")}) {
+                RFile fi(fname);
+                for (string sline; my_getline(fi(), sline); ) fo() << sline << '\n';
+            }
+        }
+        tv.remove_files(); tf.remove_files();
+    }
+    int nused = 0; for_int(t, ntiles) { if (tile_nfaces[t]) nused++; }
+    showdf("Partitioned %d faces into %d tiles (%dx%dx%d grid), with %d seam vertices\n",
+           sum(tile_nfaces), nused, tile_dims[0], tile_dims[1], tile_dims[2], seamv.num());
+    seamv.clear(); vring.clear();
+}
+
+// Run the simplifier on a mesh file keeping its vertices tagged "global"; die if it fails.
+void run_simplifier(const string& fmesh, int nf, const string& fresult) {
+    string flog = fresult+".log";
+    // The mesh file must follow the simplifier program name, ahead of its options.
+    const size_t i = simplifier.find(' ');
+    const string program = simplifier.substr(0, i), options = i==string::npos ? "" : simplifier.substr(i);
+    string scmd = sform("%s %s%s -keepglobalv 1 -nfaces %d -simplify -nooutput -outmesh %s 2>%s", program.c_str(),
+                        quote_arg_for_sh(fmesh).c_str(), options.c_str(), nf, quote_arg_for_sh(fresult).c_str(),
+                        quote_arg_for_sh(flog).c_str());
+    if (my_sh(scmd)) { SHOW(scmd); assertnever("Simplifier failed; see " + flog); }
+    remove_file(flog);
+}
+
+// A tile may touch itself at a seam vertex (its faces about the vertex forming several fans), which the simplifier
+//  does not accept.  Split each such vertex into one vertex per fan; the copies get new ids, recorded in split_vid.
+void split_pinched_vertices(int t) {
+    const string fname = tile_filename(t, "m");
+    GMesh tmesh;
+    {
+        RFile fi(fname);
+        tmesh.read(fi());
+    }
+    Array<Vertex> arv; for (Vertex v : tmesh.vertices()) { if (!tmesh.is_nice(v)) arv.push(v); }
+    if (!arv.num()) return;
+    for (Vertex v : arv) {
+        for (Vertex vnew : tmesh.fix_vertex(v)) {
+            HH_LOCK {
+                split_vid.enter(next_split_vid, tmesh.vertex_id(v));
+                tmesh.vertex_renumber_id_private(vnew, next_split_vid++);
+            }
+        }
+    }
+    WFile fo(fname);
+    tmesh.write(fo());
+}
+
+void simplify_tiles() {
+    HH_TIMER(_simplify_tiles);
+    const int ntiles = tile_nfaces.num();
+    const int tot_nfaces = sum(tile_nfaces);
+    // Each tile receives its share of the desired faces, plus the faces about its locked seam vertices, which
+    //  are left for the seam pass.
+    // Each simplifier process holds its tile in memory, so at most nprocs of them run at once, each taking the
+    //  next remaining tile.
+    // (parallel_for_each() runs at most one process per hardware thread.)
+    const int nprocs = max(min({maxprocs>0 ? maxprocs : get_max_threads(), get_max_threads(), ntiles}), 1);
+    std::atomic<int> next_tile{0};
+    parallel_for_each(range(nprocs), [&](int) {
+        for (;;) {
+            const int t = next_tile++;
+            if (t>=ntiles) break;
+            if (!tile_nfaces[t]) continue;
+            split_pinched_vertices(t);
+            int nf = int(double(nfaces)*tile_nfaces[t]/tot_nfaces+.5)+tile_nseamfaces[t];
+            nf = min(nf, tile_nfaces[t]);
+            run_simplifier(tile_filename(t, "m"), nf, tile_filename(t, "s.m"));
+            if (!keeptiles) remove_file(tile_filename(t, "m"));
+        }
+    });
+}
+
+void stitch_tiles(GMesh& mesh) {
+    HH_TIMER(_stitch_tiles);
+    Set<Vertex> seamv;
+    for_int(t, tile_nfaces.num()) {
+        if (!tile_nfaces[t]) continue;
+        GMesh tmesh;
+        {
+            string fname = tile_filename(t, "s.m");
+            RFile fi(fname);
+            tmesh.read(fi());
+            if (!keeptiles) remove_file(fname);
+        }
+        Map<Vertex, Vertex> mvv;
+        for (Vertex vt : tmesh.vertices()) {
+            bool present; int vi = split_vid.retrieve(tmesh.vertex_id(vt), present);
+            if (!present) vi = tmesh.vertex_id(vt);
+            Vertex v = mesh.id_retrieve_vertex(vi);
+            if (v) {
+                // Seam vertices were locked in each tile, so they are shared with unchanged positions.
+                seamv.add(v);
+            } else {
+                v = mesh.create_vertex_private(vi);
+                mesh.set_point(v, tmesh.point(vt));
+                mesh.set_string(v, tmesh.extract_string(vt));
+                mesh.update_string(v, "wid", nullptr); // wedge ids are local to each tile
+            }
+            mvv.enter(vt, v);
+        }
+        Array<Vertex> va;
+        for (Face ft : tmesh.faces()) {
+            va.init(0);
+            for (Vertex vt : tmesh.vertices(ft)) va.push(mvv.get(vt));
+            if (!mesh.legal_create_face(va)) { Warning("Could not stitch a tile face"); continue; }
+            Face f = mesh.create_face(va);
+            mesh.set_string(f, tmesh.extract_string(ft));
+            for (Corner ct : tmesh.corners(ft)) {
+                Corner c = mesh.corner(mvv.get(tmesh.corner_vertex(ct)), f);
+                mesh.set_string(c, tmesh.extract_string(ct));
+                mesh.update_string(c, "wid", nullptr);
+            }
+        }
+    }
+    split_vid.clear();
+    // The seam pass may only modify the vertices within seamrings rings of the seams.
+    Set<Vertex> setfree;
+    Queue<Vertex> queue;
+    for (Vertex v : seamv) { setfree.enter(v); queue.enqueue(v); }
+    for_int(ring, seamrings) {
+        Queue<Vertex> nqueue;
+        while (!queue.empty()) {
+            Vertex v = queue.dequeue();
+            for (Vertex vv : mesh.vertices(v)) {
+                if (setfree.add(vv)) nqueue.enqueue(vv);
+            }
+        }
+        queue = std::move(nqueue);
+    }
+    for (Vertex v : mesh.vertices()) {
+        mesh.update_string(v, "global", setfree.contains(v) ? nullptr : "");
+    }
+    showdf("Stitched tiles: %d faces, %d seam vertices, %d vertices free in seam pass\n",
+           mesh.num_faces(), seamv.num(), setfree.num());
+}
+
+void do_tilesimplify(Args& args) {
+    string filename = args.get_filename();
+    assertx(tiles>0 && nfaces>0 && seamrings>=0);
+    if (rootname=="") rootname = get_path_root(filename);
+    partition_tiles(filename);
+    simplify_tiles();
+    string fstitched = rootname+".stitched.m", fresult = rootname+".seams.m";
+    {
+        GMesh mesh;
+        stitch_tiles(mesh);
+        HH_TIMER(_write_stitched);
+        WFile fo(fstitched);
+        mesh.write(fo());
+    }
+    {
+        HH_TIMER(_seam_pass);
+        run_simplifier(fstitched, nfaces, fresult);
+        if (!keeptiles) remove_file(fstitched);
+    }
+    GMesh mesh;
+    {
+        RFile fi(fresult);
+        mesh.read(fi());
+    }
+    remove_file(fresult);
+    for (Vertex v : mesh.vertices()) { mesh.update_string(v, "global", nullptr); }
+    showdf("Tiled simplification: %d faces\n", mesh.num_faces());
+    mesh.write(std::cout);
+}
+
 } // namespace
 
 int main(int argc, const char** argv) {
@@ -215,6 +675,14 @@ int main(int argc, const char** argv) {
     ARGSP(blocky,               "ny : number of blocks along y axis");
     ARGSP(blocks,               "n : block size (num_vertices-1/side)");
     ARGSD(stitch,               ": stitch the PM's together");
+    ARGSC("",                   ":");
+    ARGSP(tiles,                "n : number of tiles along longest bbox axis");
+    ARGSP(nfaces,               "n : number of faces desired");
+    ARGSP(simplifier,           "'command' : simplifier (def 'MeshSimplify -minqem')");
+    ARGSP(seamrings,            "n : rings about seams free in seam pass");
+    ARGSF(keeptiles,            ": do not delete the tile files");
+    ARGSP(maxprocs,             "n : maximum concurrent simplifier processes (def: hardware threads)");
+    ARGSD(tilesimplify,         "file.m : out-of-core tiled simplification");
     showdf("%s", args.header().c_str());
     HH_TIMER(StitchPM);
     args.parse();
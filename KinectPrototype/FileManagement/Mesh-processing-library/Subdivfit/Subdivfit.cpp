@@ -21,6 +21,7 @@
 #include "FrameIO.h"
 #include "RangeOp.h"
 #include "MathOp.h"
+#include "BinaryPoints.h"
 using namespace hh;
 
 namespace {
@@ -115,20 +116,30 @@ void do_mfilename(Args& args) {
     }
 }
 
+void enter_point(const Point& p) {
+    co.push(p);
+    gbbox.union_with(p);
+    gcmf.push(nullptr); gscmfi.push(0); gdis2.push(0.f); gscmf.push(nullptr);
+    gbary.push(Bary(0.f, 0.f, 0.f)); gclp.push(Point(0.f, 0.f, 0.f));
+}
+
 void do_filename(Args& args) {
     assertx(!co.num());
-    RFile is(args.get_filename());
-    RSA3dStream ia3d(is());
-    A3dElem el;
-    for (;;) {
-        ia3d.read(el);
-        if (el.type()==A3dElem::EType::endfile) break;
-        if (el.type()==A3dElem::EType::comment) continue;
-        if (el.type()!=A3dElem::EType::point) { Warning("Non-point input ignored"); continue; }
-        co.push(el[0].p);
-        gbbox.union_with(el[0].p);
-        gcmf.push(nullptr); gscmfi.push(0); gdis2.push(0.f); gscmf.push(nullptr);
-        gbary.push(Bary(0.f, 0.f, 0.f)); gclp.push(Point(0.f, 0.f, 0.f));
+    string filename = args.get_filename();
+    if (BinaryPoints::is_binary_points(filename)) {
+        BinaryPoints bpoints(filename); // memory-mapped
+        for (const Point& p : bpoints.points()) enter_point(p);
+    } else {
+        RFile is(filename);
+        RSA3dStream ia3d(is());
+        A3dElem el;
+        for (;;) {
+            ia3d.read(el);
+            if (el.type()==A3dElem::EType::endfile) break;
+            if (el.type()==A3dElem::EType::comment) continue;
+            if (el.type()!=A3dElem::EType::point) { Warning("Non-point input ignored"); continue; }
+            enter_point(el[0].p);
+        }
     }
     showdf("%d points read\n", co.num());
 }
@@ -38,6 +38,24 @@ template<typename T> std::ostream& write_binary_std(std::ostream& os, CArrayView
     return write_binary_raw(os, ar2);
 }
 
+// Write n values in little-endian byte order.
+template<typename T> void write_little_endian(std::ostream& os, const T* p, size_t n) {
+    if (!k_is_big_endian) {
+        os.write(reinterpret_cast<const char*>(p), n*sizeof(T));
+    } else {
+        for_size_t(i, n) { T v = p[i]; my_swap_bytes(&v); os.write(reinterpret_cast<const char*>(&v), sizeof(v)); }
+    }
+}
+
+// Write the text header sheader (lines separated by '\n'), with its last line padded with spaces and terminated,
+//  so that data written next lies at a multiple of 16 bytes from the start of the header.
+inline void write_aligned_header(std::ostream& os, string sheader) {
+    constexpr int k_alignment = 16;
+    int npad = (k_alignment-(sheader.size()+1)%k_alignment)%k_alignment;
+    sheader += string(npad, ' ') + "\n";
+    os << sheader;
+}
+
 // Read an array of elements without any Endian byte-reordering.  Ret: success.
 template<typename T> bool read_raw(FILE* file, ArrayView<T> ar) {
     return fread(ar.data(), ar.num()*sizeof(T), 1, file)==1;
@@ -0,0 +1,102 @@
+// -*- C++ -*-  Copyright (c) Microsoft Corporation; see license.txt
+#include "BinaryPoints.h"
+
+#include <cstring>              // std::memchr(), std::memcpy()
+
+#include "BinaryIO.h"           // write_aligned_header(), write_little_endian()
+#include "FileIO.h"             // MappedFile
+#include "NetworkOrder.h"       // k_is_big_endian, my_swap_bytes()
+
+namespace hh {
+
+namespace {
+
+constexpr size_t k_max_header_size = 64*1024; // the header (with any comments) must lie within this prefix
+
+// Parse the header at the start of data (within its first k_max_header_size bytes).
+// ret: offset of the binary data, or 0 if not in this format.
+size_t parse_header(const char* data, size_t size, int& npoints, bool& has_normals) {
+    const char* const beg = data;
+    const char* const end = beg+(size<k_max_header_size ? size : k_max_header_size);
+    auto next_line = [&](const char*& s) -> string {
+        const char* s2 = static_cast<const char*>(std::memchr(s, '\n', end-s));
+        if (!s2) { s = end; return ""; }
+        string sline(s, s2);
+        s = s2+1;
+        return sline;
+    };
+    const char* s = beg;
+    string sline;
+    do {
+        if (s==end) return 0;
+        sline = next_line(s);
+    } while (sline[0]=='#');
+    if (sline!="BinaryPoints") return 0;
+    sline = next_line(s);
+    int version, inormals; char endian[8];
+    if (sscanf(sline.c_str(), "version=%d npoints=%d normals=%d endian=%7s",
+               &version, &npoints, &inormals, endian)!=4) return 0;
+    if (version!=1 || npoints<0 || string(endian)!="little") {
+        Warning("BinaryPoints header not recognized"); return 0;
+    }
+    has_normals = inormals!=0;
+    return s-beg;
+}
+
+// View the floats at s (or copies of them if needed).
+template<typename T> CArrayView<T> view_or_copy(const char* s, int n, Array<T>& copy) {
+    if (!k_is_big_endian && reinterpret_cast<uintptr_t>(s)%alignof(T)==0)
+        return CArrayView<T>(reinterpret_cast<const T*>(s), n);
+    copy.init(n);
+    std::memcpy(copy.data(), s, size_t(n)*sizeof(T));
+    if (k_is_big_endian) {
+        for (T& v : copy) { for_int(c, 3) { my_swap_bytes(&v[c]); } }
+    }
+    return copy;
+}
+
+} // namespace
+
+BinaryPoints::BinaryPoints(const string& filename) : _file(make_unique<MappedFile>(filename)) {
+    init(_file->data(), _file->size());
+}
+
+BinaryPoints::BinaryPoints(const char* data, size_t size) {
+    init(data, size);
+}
+
+BinaryPoints::~BinaryPoints() {
+}
+
+void BinaryPoints::init(const char* data, size_t size) {
+    int npoints; bool has_normals;
+    size_t offset = parse_header(data, size, npoints, has_normals);
+    if (!offset) assertnever("Not a BinaryPoints file");
+    if (size-offset<size_t(npoints)*(has_normals ? 2 : 1)*sizeof(Point))
+        assertnever("BinaryPoints data is truncated");
+    const char* s = data+offset;
+    _points.reinit(view_or_copy(s, npoints, _apoints));
+    if (has_normals) _normals.reinit(view_or_copy(s+size_t(npoints)*sizeof(Point), npoints, _anormals));
+}
+
+bool BinaryPoints::is_binary_points(const string& filename) {
+    if (file_requires_pipe(filename) || !file_exists(filename)) return false;
+    MappedFile file(filename);  // only the pages of the header are read
+    return recognize(file.data(), file.size());
+}
+
+bool BinaryPoints::recognize(const char* data, size_t size) {
+    int npoints; bool has_normals;
+    return parse_header(data, size, npoints, has_normals)!=0;
+}
+
+void write_binary_points(std::ostream& os, CArrayView<Point> pa, CArrayView<Vector> na) {
+    assertx(!na.num() || na.num()==pa.num());
+    write_aligned_header(os, "BinaryPoints\n" +
+                         sform("version=1 npoints=%d normals=%d endian=little", pa.num(), na.num()>0));
+    write_little_endian(os, pa.data()->data(), size_t(pa.num())*3);
+    if (na.num()) write_little_endian(os, na.data()->data(), size_t(na.num())*3);
+    assertx(os);
+}
+
+} // namespace hh
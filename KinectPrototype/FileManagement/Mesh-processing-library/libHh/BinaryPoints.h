@@ -0,0 +1,56 @@
+// -*- C++ -*-  Copyright (c) Microsoft Corporation; see license.txt
+#ifndef MESH_PROCESSING_LIBHH_BINARYPOINTS_H_
+#define MESH_PROCESSING_LIBHH_BINARYPOINTS_H_
+
+#include "Geometry.h"
+
+#if 0
+{
+    write_binary_points(std::cout, pa, na);  // na may be empty
+    BinaryPoints bpoints(filename);          // memory-mapped
+    for (const Point& p : bpoints.points()) process(p);
+}
+#endif
+
+namespace hh {
+
+class MappedFile;
+
+// Packed binary point cloud (see format below), read without parsing: a file is memory-mapped so that its point and
+//  normal arrays are viewed in place.
+class BinaryPoints : noncopyable {
+ public:
+    explicit BinaryPoints(const string& filename); // die if the file is not in this format
+    BinaryPoints(const char* data, size_t size); // views into data, which must outlive this
+    ~BinaryPoints();
+    // Format detection only examines the first 64 KiB, so it is cheap even for huge inputs.
+    static bool is_binary_points(const string& filename); // ret: false if a pipe or in another (e.g. a3d) format
+    static bool recognize(const char* data, size_t size); // ret: data starts with a header in this format
+    CArrayView<Point> points() const            { return _points; }
+    CArrayView<Vector> normals() const          { return _normals; } // empty if the file has no normals
+ private:
+    unique_ptr<MappedFile> _file;
+    CArrayView<Point> _points {nullptr, 0};
+    CArrayView<Vector> _normals {nullptr, 0};
+    Array<Point> _apoints;      // copies of the data, used only if it is not suitably aligned
+    Array<Vector> _anormals;
+    void init(const char* data, size_t size);
+};
+
+// Write the points, and their normals unless na is empty.
+void write_binary_points(std::ostream& os, CArrayView<Point> pa, CArrayView<Vector> na);
+
+//----------------------------------------------------------------------------
+
+// BINARY POINTS FORMAT
+//
+// Any number of comment lines (beginning with '#'), a line "BinaryPoints", and a line
+//  "version=1 npoints=n normals=b endian=little" (padded with spaces so that the data that immediately follows it
+//  lies at a multiple of 16 bytes from the start of the "BinaryPoints" line), and then the binary data:
+//  - float[n][3] point positions
+//  - float[n][3] point normals (if normals=1)
+// All values are in little-endian byte order, so they are viewed in place on common platforms.
+
+} // namespace hh
+
+#endif // MESH_PROCESSING_LIBHH_BINARYPOINTS_H_
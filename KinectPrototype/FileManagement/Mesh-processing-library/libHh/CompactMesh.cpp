@@ -0,0 +1,350 @@
+// -*- C++ -*-  Copyright (c) Microsoft Corporation; see license.txt
+#include "CompactMesh.h"
+
+#include <cstdlib>              // strtol(), strtof()
+#include <cstring>              // strncmp(), std::strchr()
+
+#include "GMesh.h"
+#include "Map.h"
+#include "Parallel.h"           // parallel_for_each()
+
+namespace hh {
+
+CompactMesh::CompactMesh(const GMesh& mesh) {
+    Map<Vertex,int> mvi;
+    for (Vertex gv : mesh.ordered_vertices()) {
+        int v = create_vertex(mesh.point(gv), mesh.vertex_id(gv));
+        _vflags[v] = mesh.flags(gv);
+        if (mesh.get_string(gv)) parse_string(_vcolumns, v, mesh.get_string(gv));
+        mvi.enter(gv, v);
+    }
+    for (Face gf : mesh.ordered_faces()) {
+        assertx(mesh.is_triangle(gf));
+        Vec3<int> va; int j = 0;
+        for (Vertex gv : mesh.vertices(gf)) va[j++] = mvi.get(gv);
+        int f = create_face(va[0], va[1], va[2], mesh.face_id(gf));
+        _fflags[f] = mesh.flags(gf);
+        if (mesh.get_string(gf)) parse_string(_fcolumns, f, mesh.get_string(gf));
+    }
+    build_adjacency();
+}
+
+void CompactMesh::clear() {
+    *this = CompactMesh();
+}
+
+int CompactMesh::create_vertex(const Point& p, int id) {
+    int v = num_vertices();
+    set_ids(_vids, v, id ? id : v+1);
+    _points.push(p);
+    _vflags.push(Flags());
+    _opp.clear();
+    return v;
+}
+
+int CompactMesh::create_face(int v0, int v1, int v2, int id) {
+    int nv = num_vertices();
+    ASSERTX(v0>=0 && v0<nv && v1>=0 && v1<nv && v2>=0 && v2<nv); dummy_use(nv);
+    assertx(v0!=v1 && v1!=v2 && v2!=v0);
+    int f = num_faces();
+    set_ids(_fids, f, id ? id : f+1);
+    _fverts.push_array({v0, v1, v2});
+    _fflags.push(Flags());
+    _opp.clear();
+    return f;
+}
+
+void CompactMesh::set_ids(Array<int>& ids, int i, int id) {
+    if (!ids.num()) {
+        if (id==i+1) return;    // ids remain implicit
+        ids.init(i);
+        for_int(j, i) { ids[j] = j+1; }
+    }
+    ids.push(id);
+}
+
+void CompactMesh::build_adjacency() {
+    const int nv = num_vertices(), nh = _fverts.num();
+    // Outgoing half-edges of each vertex, as compressed rows.
+    Array<int> start(nv+1, 0);
+    for (int v : _fverts) start[v+1]++;
+    for_int(v, nv) { start[v+1] += start[v]; }
+    Array<int> outh(nh);
+    {
+        Array<int> pos(start);
+        for_int(h, nh) { outh[pos[_fverts[h]]++] = h; }
+    }
+    _opp.init(nh);
+    parallel_for_each(range(nh), [&](const int h) {
+        const int v1 = _fverts[h], v2 = _fverts[next(h)];
+        int hopp = -1, nsame = 0;
+        for_intL(i, start[v2], start[v2+1]) {
+            int h2 = outh[i];
+            if (vertex2(h2)==v1) { assertx(hopp<0); hopp = h2; }
+        }
+        for_intL(i, start[v1], start[v1+1]) {
+            if (vertex2(outh[i])==v2) nsame++;
+        }
+        if (nsame!=1) {
+            SHOW(vertex_id(v1), vertex_id(v2)); assertnever("Non-manifold or inconsistently oriented edge");
+        }
+        _opp[h] = hopp;
+    }, 40);
+    _vhedge.init(nv, -1);
+    for_int(h, nh) {
+        int& vh = _vhedge[_fverts[h]];
+        if (vh<0 || _opp[h]<0) vh = h;
+    }
+    pad_columns(_vcolumns, nv);
+    pad_columns(_fcolumns, num_faces());
+    for (auto* ar : {&_vhedge, &_vids, &_fverts, &_opp, &_fids}) ar->shrink_to_fit();
+    _points.shrink_to_fit(); _vflags.shrink_to_fit(); _fflags.shrink_to_fit();
+}
+
+int CompactMesh::num_edges() const {
+    int n = 0;
+    for_int(h, _opp.num()) { if (_opp[h]<h) n++; } // boundary half-edges have _opp[h]<0
+    return n;
+}
+
+int CompactMesh::num_boundary_edges() const {
+    int n = 0;
+    for (int hopp : _opp) { if (hopp<0) n++; }
+    return n;
+}
+
+bool CompactMesh::is_nice() const {
+    // Each vertex must have all its outgoing half-edges in the single fan about vertex_hedge().
+    Array<int> nout(num_vertices(), 0);
+    for (int v : _fverts) nout[v]++;
+    for_int(v, num_vertices()) {
+        int n = 0;
+        for (int h = vertex_hedge(v), h0 = h; h>=0; ) {
+            n++;
+            h = ccw_hedge(h);
+            if (h==h0) break;
+        }
+        if (n!=nout[v]) return false;
+    }
+    return true;
+}
+
+int CompactMesh::degree(int v) const {
+    int h0 = vertex_hedge(v), n = 0;
+    for (int h = h0; h>=0; ) {
+        n++;
+        h = ccw_hedge(h);
+        if (h<0) n++;           // last neighbor on the boundary
+        if (h==h0) break;
+    }
+    return n;
+}
+
+void CompactMesh::ok() const {
+    const int nv = num_vertices(), nf = num_faces(), nh = _fverts.num();
+    assertx(_vflags.num()==nv && _vhedge.num()==nv && (!_vids.num() || _vids.num()==nv));
+    assertx(nh==nf*3 && _opp.num()==nh && _fflags.num()==nf && (!_fids.num() || _fids.num()==nf));
+    for_int(h, nh) {
+        assertx(_fverts[h]>=0 && _fverts[h]<nv && _fverts[h]!=vertex2(h));
+        int hopp = _opp[h];
+        if (hopp<0) continue;
+        assertx(_opp[hopp]==h && vertex1(hopp)==vertex2(h) && vertex2(hopp)==vertex1(h));
+    }
+    for_int(v, nv) {
+        int h = _vhedge[v];
+        if (h>=0) assertx(vertex1(h)==v);
+    }
+    for (const Column& col : _vcolumns) assertx(col.values.num()==nv*max(col.dim, 1));
+    for (const Column& col : _fcolumns) assertx(col.values.num()==nf*max(col.dim, 1));
+}
+
+size_t CompactMesh::memory_usage() const {
+    size_t n = (_points.num()*sizeof(Point)+_vflags.num()*sizeof(Flags)+_fflags.num()*sizeof(Flags)+
+                (_vhedge.num()+_vids.num()+_fverts.num()+_opp.num()+_fids.num())*sizeof(int));
+    for (const Column& col : _vcolumns) n += col.values.num()*sizeof(float);
+    for (const Column& col : _fcolumns) n += col.values.num()*sizeof(float);
+    return n;
+}
+
+const CompactMesh::Column* CompactMesh::find_column(CArrayView<Column> columns, const string& key) {
+    for (const Column& col : columns) {
+        if (col.key==key) return &col;
+    }
+    return nullptr;
+}
+
+void CompactMesh::pad_columns(Array<Column>& columns, int n) {
+    for (Column& col : columns) {
+        int n0 = col.values.num(), n1 = n*max(col.dim, 1);
+        col.values.resize(n1);
+        for_intL(i, n0, n1) { col.values[i] = k_missing; }
+        col.values.shrink_to_fit();
+    }
+}
+
+// Parse the attributes of element i from its info string s into columns.
+void CompactMesh::parse_string(Array<Column>& columns, int i, const char* s) {
+    string str;
+    Vec4<float> val;
+    for_cstring_key_value_ptr(s, [&](const char* kb, int kl, const char* vb, int vl) {
+        str.assign(vb, vl);
+        int dim = 0; bool parens = vl && vb[0]=='(';
+        if (vl) {
+            const char* sb = str.c_str()+(parens ? 1 : 0);
+            const char* se = str.c_str()+str.size()-(parens ? 1 : 0);
+            while (sb<se) {
+                char* snext;
+                float f = std::strtof(sb, &snext);
+                if (snext==sb || dim==4) { dim = -1; break; }
+                val[dim++] = f;
+                for (sb = snext; sb<se && *sb==' '; ) sb++;
+            }
+            if (dim<=0) {
+                if (Warning("CompactMesh: ignoring non-numeric attribute")) SHOW(string(kb, kl), str);
+                return false;
+            }
+        }
+        string key(kb, kl);
+        Column* pcol = const_cast<Column*>(find_column(columns, key));
+        if (!pcol) {
+            columns.push(Column{key, dim, parens, Array<float>()});
+            pcol = &columns.last();
+        } else if (pcol->dim!=dim || pcol->parens!=parens) {
+            if (Warning("CompactMesh: ignoring attribute with inconsistent dimension")) SHOW(key, str);
+            return false;
+        }
+        Array<float>& values = pcol->values;
+        const int stride = max(dim, 1), n0 = values.num();
+        if (n0<(i+1)*stride) {
+            values.resize((i+1)*stride);
+            for_intL(j, n0, values.num()) { values[j] = k_missing; }
+        }
+        if (!dim) values[i] = 1.f;
+        for_int(c, dim) { values[i*stride+c] = val[c]; }
+        return false;
+    });
+}
+
+// Append the attributes of element i to sinfo (space-separated).
+void CompactMesh::append_string(string& sinfo, CArrayView<Column> columns, int i) {
+    string str;
+    for (const Column& col : columns) {
+        const int stride = max(col.dim, 1);
+        if (col.values[i*stride]==k_missing) continue;
+        if (!sinfo.empty()) sinfo += ' ';
+        sinfo += col.key;
+        if (!col.dim) continue;
+        sinfo += '=';
+        if (col.parens) sinfo += '(';
+        for_int(c, col.dim) {
+            if (c) sinfo += ' ';
+            sinfo += csform(str, "%g", col.values[i*stride+c]);
+        }
+        if (col.parens) sinfo += ')';
+    }
+}
+
+bool CompactMesh::read(std::istream& is) {
+    clear();
+    // Vertex id -> index: a dense array when the ids are compact, else a Map.
+    Array<int> id2v; Map<int,int> mid2v;
+    auto get_vertex = [&](int id) { return id>=0 && id<id2v.num() && id2v[id]>=0 ? id2v[id] : mid2v.get(id); };
+    int facenum = 1, nignored = 0;
+    for (string sline; my_getline(is, sline); ) {
+        if (sline[0]=='#') continue;
+        char* sinfo = std::strchr(&sline[0], '{');
+        if (sinfo) {
+            *sinfo++ = 0;
+            char* s = std::strchr(sinfo, '}');
+            if (!s) {
+                if (Warning("Mesh info string has no matching '}'")) SHOW(sline, sinfo);
+                sinfo = nullptr;
+            } else *s = 0;
+        }
+        const char* sb = sline.c_str();
+        char* s;
+        if (sb[0]=='V' && !strncmp(sb, "Vertex ", 7)) {
+            int vi = int(std::strtol(sb+7, &s, 10));
+            Point p; for_int(c, 3) { const char* s0 = s; p[c] = std::strtof(s0, &s); assertx(s!=s0); }
+            assertx(vi>0);
+            int v = create_vertex(p, vi);
+            if (vi<=4*(v+1)+1024) {
+                if (vi>=id2v.num()) {
+                    int n0 = id2v.num(); id2v.resize(max(vi+1, n0*2));
+                    for_intL(i, n0, id2v.num()) { id2v[i] = -1; }
+                }
+                if (id2v[vi]>=0) { SHOW(vi); assertnever("Vertex id is already used"); }
+                id2v[vi] = v;
+            } else {
+                mid2v.enter(vi, v);
+            }
+            if (sinfo) {
+                parse_string(_vcolumns, v, sinfo);
+                if (GMesh::string_has_key(sinfo, "cusp")) _vflags[v].flag(GMesh::vflag_cusp) = true;
+            }
+        } else if (sb[0]=='F' && !strncmp(sb, "Face ", 5)) {
+            int fi = int(std::strtol(sb+5, &s, 10));
+            Vec3<int> va; int nv = 0;
+            for (;;) {
+                const char* s0 = s;
+                int vi = int(std::strtol(s0, &s, 10));
+                if (s==s0) break;
+                if (nv==3) { nv++; break; }
+                va[nv++] = get_vertex(vi);
+            }
+            if (nv!=3) { clear(); return false; } // only triangle faces are supported
+            if (!fi) fi = facenum;
+            facenum = max(facenum, fi+1);
+            int f = create_face(va[0], va[1], va[2], fi);
+            if (sinfo) parse_string(_fcolumns, f, sinfo);
+        } else {
+            nignored++;
+        }
+    }
+    build_adjacency();
+    return !nignored;
+}
+
+void CompactMesh::write(std::ostream& os) const {
+    string sinfo;
+    for_int(v, num_vertices()) {
+        const Point& p = _points[v];
+        os << "Vertex " << vertex_id(v) << "  " << p[0] << " " << p[1] << " " << p[2];
+        sinfo.clear(); append_string(sinfo, _vcolumns, v);
+        if (!sinfo.empty()) os << " {" << sinfo << "}";
+        os << "\n";
+        assertx(os);
+    }
+    for_int(f, num_faces()) {
+        os << "Face " << face_id(f) << " ";
+        for_int(j, 3) { os << " " << vertex_id(face_vertex(f, j)); }
+        sinfo.clear(); append_string(sinfo, _fcolumns, f);
+        if (!sinfo.empty()) os << " {" << sinfo << "}";
+        os << "\n";
+        assertx(os);
+    }
+    os.flush();
+}
+
+void CompactMesh::extract_gmesh(GMesh& gmesh) const {
+    assertx(!gmesh.num_vertices());
+    Array<Vertex> va(num_vertices());
+    string sinfo;
+    for_int(v, num_vertices()) {
+        Vertex gv = gmesh.create_vertex_private(vertex_id(v));
+        gmesh.set_point(gv, _points[v]);
+        gmesh.flags(gv) = _vflags[v];
+        sinfo.clear(); append_string(sinfo, _vcolumns, v);
+        if (!sinfo.empty()) gmesh.set_string(gv, sinfo.c_str());
+        va[v] = gv;
+    }
+    for_int(f, num_faces()) {
+        Face gf = gmesh.create_face_private(face_id(f), V(va[face_vertex(f, 0)], va[face_vertex(f, 1)],
+                                                           va[face_vertex(f, 2)]));
+        gmesh.flags(gf) = _fflags[f];
+        sinfo.clear(); append_string(sinfo, _fcolumns, f);
+        if (!sinfo.empty()) gmesh.set_string(gf, sinfo.c_str());
+    }
+}
+
+} // namespace hh
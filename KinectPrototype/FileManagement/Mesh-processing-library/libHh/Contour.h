@@ -9,6 +9,11 @@
 #include "Stat.h"
 #include "PArray.h"
 #include "SGrid.h"
+#include "RangeOp.h"            // sort()
+#include "Parallel.h"           // ThreadPoolIndexedTask
+#include "Map.h"
+
+#include <deque>
 
 #if 0
 {
@@ -28,18 +33,22 @@
             contour(50, func_eval, func_contour(), func_border);
         contour.march_from(Point(.9f, .6f, .6f));
     }
+    GMesh mesh2; {
+        BrickContour3DMesh<decltype(func_eval)> contour(50, &mesh2, func_eval); // func_eval must be thread-safe
+        contour.march_near(Point(.9f, .6f, .6f));  // only records seed cubes
+        contour.march();                           // concurrent marching of bricks, then stitching into mesh2
+    }
 }
 #endif
 
 namespace hh {
 
 // Contour2D/Contour3DMesh/Contour3D compute a piecewise linear approximation to the zeroset of a scalar function:
-//   - surface triangle mesh in the unit cube   (Contour3DMesh)
+//   - surface triangle mesh in the unit cube   (Contour3DMesh, or BrickContour3DMesh using multiple threads)
 //   - surface triangle stream in the unit cube (Contour3D)
 //   - curve polyline stream in the unit square (Contour2D)
 
 // TODO: improving efficiency/generality:
-// - use 64-bit encoding to allow larger grid sizes.
 // - perhaps distinguish  Set<unsigned> cubes_visited and  Map<unsigned,Node>  cube_vertices? and edge_vertices too?
 // - somehow remove _en from Node?
 // - somehow remove mapsucc
@@ -47,6 +56,18 @@ namespace hh {
 
 constexpr float k_Contour_undefined = 1e31f; // represents undefined distance, to introduce surface boundaries
 
+// An Eval functor may optionally also provide a batch evaluation
+//    void operator()(CArrayView<Vec3<float>> points, ArrayView<float> vals) const;
+//  in which case Contour3DMesh and Contour3D evaluate all new cube vertices of each queue frontier with one call,
+//  and BrickContour3DMesh evaluates those of each round with one call (from a single thread, so the batch evaluation
+//  may itself be parallel).  The march order, and hence the output, is unchanged.
+template<typename Eval, typename DPoint> struct contour_has_batch_eval {
+    template<typename U> static char deduce(decltype(std::declval<U&>()(std::declval<CArrayView<DPoint>>(),
+                                                                         std::declval<ArrayView<float>>()))*);
+    template<typename>   static void deduce(...);
+    static constexpr bool value = !std::is_void<decltype(deduce<Eval>(nullptr))>::value;
+};
+
 // Protected content in this class just factors functions common to Contour2D, Contour3DMesh, and Contour3D.
 template<int D, typename VertexData = Vec0<int>> class ContourBase {
  public:
@@ -55,16 +76,21 @@ template<int D, typename VertexData = Vec0<int>> class ContourBase {
         _vertex_tol = tol;
         _vertex_tol = getenv_float("CONTOUR_VERTEX_TOL", _vertex_tol, true); // override
     }
+    // Store the grid nodes in a Set (as originally) rather than in dense blocks; must precede marching.
+    void use_hashed_nodes(bool b = true)        { _m.set_hashed(b); }
  protected:
     static constexpr float k_not_yet_evaled = BIGFLOAT;
     using DPoint = Vec<float,D>; // domain point
     using IPoint = Vec<int,D>;   // grid point
+    using Encoded = uint64_t;    // encoded grid point
     static_assert(D==2 || D==3, "");
-    static constexpr int k_max_gn = D==3 ? 1024 : 65536; // bits/coordinate==10 for 3D, 16 for 2D (max 32 bits total)
+    static constexpr int k_nbits = D==3 ? 20 : 30; // bits/coordinate in Encoded
+    static constexpr int k_max_gn = 1<<k_nbits;
     ContourBase(int gn) : _gn(gn), _gni(1.f/gn) {
         assertx(_gn>0);
         assertx(_gn<k_max_gn);  // must leave room for [0.._gn] inclusive
         set_vertex_tolerance(_vertex_tol);
+        if (getenv_bool("CONTOUR_HASHED_NODES")) use_hashed_nodes(); // override
     }
     ~ContourBase()                              {
         assertx(_queue.empty());
@@ -88,20 +114,66 @@ template<int D, typename VertexData = Vec0<int>> class ContourBase {
     // The cube vertices are indexed by nodes with indices [0, _gn].  See get_point().
     // So there are no "+.5f" roundings anywhere in the code.
     struct Node : VertexData {
-        explicit Node(unsigned pen) : _en(pen) { }
-        enum class ECubestate { nothing, queued, visited };
-        unsigned _en;                                // encoded vertex index
-        ECubestate _cubestate {ECubestate::nothing}; // cube info
+        explicit Node(Encoded pen) : _en(pen) { }
+        enum class ECubestate : uint8_t { nothing, queued, visited };
+        Encoded _en;                                 // encoded vertex index
         float _val {k_not_yet_evaled};               // vertex value
-        DPoint _p;                                   // vertex point position in grid
+        ECubestate _cubestate {ECubestate::nothing}; // cube info
         // Note that for 3D, base class contains Vec3<Vertex> _verts.
     };
-    struct hash_Node { size_t operator()(const Node& n) const { return n._en; } };
+    struct hash_Node { size_t operator()(const Node& n) const { return size_t(n._en); } };
     struct equal_Node { bool operator()(const Node& n1, const Node& n2) const { return n1._en==n2._en; } };
-    Set<Node, hash_Node, equal_Node> _m;
-    // (std::unordered_set<> : References and pointers to key stored in the container are only
-    //   invalidated by erasing that element.  So it's OK to keep pointers to Node* even as more are added.)
-    Queue<unsigned> _queue;     // cubes queued to be visited
+    // Nodes with stable addresses (so it's OK to keep pointers to Node* even as more are added).
+    // By default, a node is located through a dense block of indices covering k_block_size^D grid points, and the
+    //  blocks are located through a hash table keyed by the encoded block indices; the nodes themselves are
+    //  allocated contiguously.  This avoids the per-node allocation and hashing of the original Set<Node>.
+    class NodeStore : noncopyable {
+     public:
+        void set_hashed(bool b)                 { assertx(!num()); _hashed = b; }
+        bool hashed() const                     { return _hashed; }
+        size_t num() const                      { return _hashed ? size_t(_set.num()) : _nodes.size(); }
+        // Find the node, creating it if new.
+        Node* enter(Encoded en) {
+            if (_hashed) {
+                bool is_new; return const_cast<Node*>(&_set.enter(Node(en), is_new)); // OK if not modify n->_en
+            }
+            uint32_t& index = block_index(en);
+            if (!index) { _nodes.emplace_back(en); index = assert_narrow_cast<uint32_t>(_nodes.size()); }
+            return &_nodes[index-1];
+        }
+        // Find the node, which must exist.
+        Node* get(Encoded en) {
+            if (_hashed) return const_cast<Node*>(&_set.get(Node(en)));
+            uint32_t index = block_index(en); ASSERTX(index);
+            return &_nodes[index-1];
+        }
+     private:
+        static constexpr int k_block_nbits = D==3 ? 3 : 4; // blocks of 8^3 or 16^2 grid points
+        static constexpr int k_block_size = 1<<k_block_nbits;
+        using Block = Vec<uint32_t, (D==3 ? k_block_size*k_block_size*k_block_size : k_block_size*k_block_size)>;
+        bool _hashed {false};
+        Set<Node, hash_Node, equal_Node> _set; // if _hashed
+        std::deque<Node> _nodes;               // (push_back() on a std::deque<> does not move existing elements)
+        Map<Encoded, unique_ptr<Block>> _blocks; // encoded block indices -> (1 + index into _nodes), or 0 if absent
+        Encoded _last_block_en {0};
+        Block* _last_block {nullptr};
+        uint32_t& block_index(Encoded en) {
+            IPoint ci = decode(en), bi; int offset = 0;
+            for_int(c, D) {
+                bi[c] = ci[c]>>k_block_nbits;
+                offset = (offset<<k_block_nbits) | (ci[c]&(k_block_size-1));
+            }
+            Encoded ben = encode(bi);
+            if (ben!=_last_block_en || !_last_block) { // most accesses are to the same block as the previous one
+                unique_ptr<Block>& pblock = _blocks[ben];
+                if (!pblock) { pblock = make_unique<Block>(); fill(*pblock, 0u); }
+                _last_block_en = ben; _last_block = pblock.get();
+            }
+            return (*_last_block)[offset];
+        }
+    };
+    NodeStore _m;
+    Queue<Encoded> _queue;       // cubes queued to be visited
     int _ncvisited {0};
     int _ncundef {0};
     int _ncnothing {0};
@@ -111,6 +183,16 @@ template<int D, typename VertexData = Vec0<int>> class ContourBase {
     int _nedegen {0};
     Array<DPoint> _tmp_poly;
     //
+    static Encoded encode(const IPoint& ci) {
+        Encoded en = 0;
+        for_int(c, D) { ASSERTX(ci[c]>=0 && ci[c]<k_max_gn); en = (en<<k_nbits) | Encoded(ci[c]); }
+        return en;
+    }
+    static IPoint decode(Encoded en) {
+        IPoint ci;
+        for (int c = D-1; c>=0; --c) { ci[c] = int(en&(k_max_gn-1)); en >>= k_nbits; }
+        return ci;
+    }
     bool cube_inbounds(const IPoint& ci) const { return ci.in_range(ntimes<D>(_gn)); }
     DPoint get_point(const IPoint& ci) const {
         // Note: less strict than cube_inbounds() because ci[c]==_gn is OK for a vertex.
@@ -118,6 +200,7 @@ template<int D, typename VertexData = Vec0<int>> class ContourBase {
         DPoint dp; for_int(c, D) { ASSERTX(ci[c]>=0 && ci[c]<=_gn); dp[c] = ci[c]<_gn ? ci[c]*_gni : 1.f; }
         return dp;
     }
+    DPoint node_point(const Node* n) const      { return get_point(decode(n->_en)); }
     template<bool avoid_degen, typename Eval = float(const DPoint&)>
     DPoint compute_point(const DPoint& pp, const DPoint& pn, float vp, float vn, Eval& eval) {
         DPoint pm; float fm;
@@ -145,7 +228,7 @@ template<int D, typename VertexData = Vec0<int>> class ContourBase {
                 }
                 if (dist2(p0, p1)<=square(_vertex_tol)) break;
             }
-            HH_SSTAT(SContneval, neval);
+            HH_SSTAT(SContneval, neval); // may be called concurrently in BrickContour3DMesh
         }
         if (avoid_degen) {
             // const float fs = _gn>500 ? .05f : _gn >100 ? .01f : .001f;
@@ -181,7 +264,8 @@ class Contour3DBase : public ContourBase<3, VertexData> {
     using typename base::DPoint;
     using typename base::IPoint;
     using typename base::Node;
-    using base::get_point; using base::cube_inbounds;
+    using typename base::Encoded;
+    using base::get_point; using base::cube_inbounds; using base::encode; using base::decode;
     using base::_gn; using base::k_max_gn;
     using base::_queue; using base::_m; using base::_tmp_poly;
     using base::_ncvisited; using base::_ncundef; using base::_ncnothing;
@@ -199,20 +283,62 @@ class Contour3DBase : public ContourBase<3, VertexData> {
     Eval _eval;
     Border _border;
     static constexpr bool b_no_border = std::is_same<Border, Contour3D_NoBorder>::value;
+    static constexpr bool b_batch_eval = contour_has_batch_eval<Eval, DPoint>::value;
     using Node222 = SGrid<Node*, 2, 2, 2>;
     using base::k_not_yet_evaled;
+    Array<Encoded> _frontier;  // cubes dequeued together for batch evaluation
+    Array<Node*> _tmp_nodes;
+    Array<DPoint> _tmp_points;
+    Array<float> _tmp_vals;
     //
-    unsigned encode(const IPoint& ci) const {
-        static_assert(k_max_gn<=1024, "");
-        return (((unsigned(ci[0])<<10) | unsigned(ci[1]))<<10) | unsigned(ci[2]);
-    }
-    IPoint decode(unsigned en) const {
-        static_assert(k_max_gn<=1024, "");
-        return IPoint(narrow_cast<int>(en>>20),
-                      narrow_cast<int>((en>>10)&((1u<<10)-1)),
-                      narrow_cast<int>(en&((1u<<10)-1)));
-    }
     void check_ok()                             { /* assertx(!(_pmesh && _contour)); */ }
+    static int mod4(int j)                      { ASSERTX(j>=0); return j&0x3; }
+    // For each of the 6 faces of cube na, find the contour segments crossing the face (based on Wyvill et al.).
+    // Each segment goes from the edge (np2, nn2) to the edge (np1, nn1), where np* have values >=0 and nn* <0;
+    //  func_segment(np1, nn1, np2, nn2) is called for each.
+    template<typename Func = void(Node*, Node*, Node*, Node*)>
+    static void contour_cube_segments(const Node222& na, Func func_segment) {
+        for_int(d, D) for_int(v, 2) { // examine each of 6 cube faces
+            Vec4<Node*> naf; {
+                int d1 = (d+1)%D, d2 = (d+2)%D;
+                IPoint cd; cd[d] = v;
+                int i = 0;
+                // Gather 4 cube vertices in a consistent order
+                for (cd[d1] = 0; cd[d1]<2; cd[d1]++) {
+                    int sw = cd[d]^cd[d1]; // 0 or 1
+                    for (cd[d2] = sw; cd[d2]==0||cd[d2]==1; cd[d2] += (sw ? -1 : 1)) {
+                        naf[i++] = na[cd[0]][cd[1]][cd[2]];
+                    }
+                }
+            }
+            int nneg = 0;
+            double sumval = 0.;
+            for_int(i, 4) {
+                float val = naf[i]->_val;
+                if (val<0) nneg++;
+                sumval += val;  // If pedantic, could sort the vals before summing.
+            }
+            for_int(i, 4) {
+                int i1 = mod4(i+1), i2 = mod4(i+2), i3 = mod4(i+3);
+                if (!(naf[i]->_val<0 && naf[i1]->_val>=0)) continue;
+                // have start of edge
+                ASSERTX(nneg>=1 && nneg<=3);
+                int ie;                      // end of edge
+                if (nneg==1) {
+                    ie = i3;
+                } else if (nneg==3) {
+                    ie = i1;
+                } else if (naf[i2]->_val>=0) {
+                    ie = i2;
+                } else if (sumval<0) {
+                    ie = i1;
+                } else {
+                    ie = i3;
+                }
+                func_segment(naf[i1], naf[i], naf[ie], naf[mod4(ie+1)]);
+            }
+        }
+    }
     int march_from_i(const DPoint& startp) {
         check_ok();
         for_int(d, D) ASSERTX(startp[d]>=0.f && startp[d]<=1.f);
@@ -240,8 +366,8 @@ class Contour3DBase : public ContourBase<3, VertexData> {
     int march_from_aux(const IPoint& cc) {
         int oncvisited = _ncvisited;
         {
-            unsigned en = encode(cc);
-            bool is_new; Node* n = const_cast<Node*>(&_m.enter(Node(en), is_new)); // un-const OK if not modify n->_en
+            Encoded en = encode(cc);
+            Node* n = _m.enter(en);
             // "base::" required when accessing ECubestate for mingw32 gcc 4.8.1
             if (n->_cubestate==base::Node::ECubestate::visited) return 0;
             ASSERTX(n->_cubestate==base::Node::ECubestate::nothing);
@@ -249,14 +375,49 @@ class Contour3DBase : public ContourBase<3, VertexData> {
             n->_cubestate = base::Node::ECubestate::queued;
         }
         while (!_queue.empty()) {
-            unsigned en = _queue.dequeue();
-            consider_cube(en);
+            if (b_batch_eval) {
+                // Same visiting order as below, since cubes enqueued by consider_cube() follow the frontier.
+                _frontier.init(0);
+                while (!_queue.empty()) _frontier.push(_queue.dequeue());
+                eval_frontier();
+                for (Encoded en : _frontier) consider_cube(en);
+            } else {
+                Encoded en = _queue.dequeue();
+                consider_cube(en);
+            }
         }
         int cncvisited = _ncvisited-oncvisited;
         if (cncvisited==1) _ncnothing++;
         return cncvisited;
     }
-    void consider_cube(unsigned encube) {
+    // Evaluate all not-yet-evaluated vertices of the cubes in _frontier using a single batch call to _eval.
+    void eval_frontier() {
+        _tmp_nodes.init(0); _tmp_points.init(0);
+        for (Encoded encube : _frontier) {
+            IPoint cc = decode(encube);
+            for_int(i, 2) for_int(j, 2) for_int(k, 2) {
+                IPoint ci = cc+IPoint(i, j, k);
+                Node* n = _m.enter(encode(ci));
+                if (n->_val!=k_not_yet_evaled) continue;
+                n->_val = -k_not_yet_evaled; // mark as pending, to only include it once
+                _tmp_nodes.push(n); _tmp_points.push(get_point(ci));
+            }
+        }
+        if (!_tmp_nodes.num()) return;
+        _tmp_vals.init(_tmp_nodes.num());
+        eval_batch(_tmp_points, _tmp_vals, std::integral_constant<bool, b_batch_eval>());
+        for_int(i, _tmp_nodes.num()) {
+            Node* n = _tmp_nodes[i];
+            n->_val = _tmp_vals[i];
+            ASSERTX(n->_val!=k_not_yet_evaled);
+            _nvevaled++;
+            if (!n->_val) _nvzero++;
+            if (n->_val==k_Contour_undefined) _nvundef++;
+        }
+    }
+    void eval_batch(CArrayView<DPoint> points, ArrayView<float> vals, std::true_type) { _eval(points, vals); }
+    void eval_batch(CArrayView<DPoint>, ArrayView<float>, std::false_type) { assertnever(""); }
+    void consider_cube(Encoded encube) {
         _ncvisited++;
         IPoint cc = decode(encube);
         Node222 na;
@@ -264,12 +425,11 @@ class Contour3DBase : public ContourBase<3, VertexData> {
         for_int(i, 2) for_int(j, 2) for_int(k, 2) {
             IPoint cd(i, j, k);
             IPoint ci = cc+cd;
-            unsigned en = encode(ci);
-            bool is_new; Node* n = const_cast<Node*>(&_m.enter(Node(en), is_new));
+            Encoded en = encode(ci);
+            Node* n = _m.enter(en);
             na[i][j][k] = n;
             if (n->_val==k_not_yet_evaled) {
-                n->_p = get_point(ci);
-                n->_val = _eval(n->_p);
+                n->_val = _eval(get_point(ci));
                 _nvevaled++;
                 if (!n->_val) _nvzero++;
                 if (n->_val==k_Contour_undefined) _nvundef++;
@@ -301,8 +461,8 @@ class Contour3DBase : public ContourBase<3, VertexData> {
             IPoint ci = cc+cd;  // indices of node for neighboring cube;
             // note: vmin<0 since 0 is arbitrarily taken to be positive
             if (vmax!=k_Contour_undefined && vmin<0 && vmax>=0 && cube_inbounds(ci)) {
-                unsigned en = encode(ci);
-                bool is_new; Node* n2 = const_cast<Node*>(&_m.enter(Node(en), is_new));
+                Encoded en = encode(ci);
+                Node* n2 = _m.enter(en);
                 if (n2->_cubestate==base::Node::ECubestate::nothing) {
                     n2->_cubestate = base::Node::ECubestate::queued;
                     _queue.enqueue(en);
@@ -339,53 +499,14 @@ class Contour3DMesh : public Contour3DBase<VertexData3DMesh, Contour3DMesh<Eval,
     using base::D; using base::compute_point; using base::_eval; using base::decode;
     GMesh* _pmesh;
     bool _big_mesh_faces {false};
-    static int mod4(int j)                      { ASSERTX(j>=0); return j&0x3; }
     void contour_cube(const IPoint& cc, const Node222& na) {
-        // Based on Wyvill et al.
         dummy_use(cc);
         Map<Vertex,Vertex> mapsucc;
-        for_int(d, D) for_int(v, 2) { // examine each of 6 cube faces
-            Vec4<Node*> naf; {
-                int d1 = (d+1)%D, d2 = (d+2)%D;
-                IPoint cd; cd[d] = v;
-                int i = 0;
-                // Gather 4 cube vertices in a consistent order
-                for (cd[d1] = 0; cd[d1]<2; cd[d1]++) {
-                    int sw = cd[d]^cd[d1]; // 0 or 1
-                    for (cd[d2] = sw; cd[d2]==0||cd[d2]==1; cd[d2] += (sw ? -1 : 1)) {
-                        naf[i++] = na[cd[0]][cd[1]][cd[2]];
-                    }
-                }
-            }
-            int nneg = 0;
-            double sumval = 0.;
-            for_int(i, 4) {
-                float val = naf[i]->_val;
-                if (val<0) nneg++;
-                sumval += val;  // If pedantic, could sort the vals before summing.
-            }
-            for_int(i, 4) {
-                int i1 = mod4(i+1), i2 = mod4(i+2), i3 = mod4(i+3);
-                if (!(naf[i]->_val<0 && naf[i1]->_val>=0)) continue;
-                // have start of edge
-                ASSERTX(nneg>=1 && nneg<=3);
-                int ie;                      // end of edge
-                if (nneg==1) {
-                    ie = i3;
-                } else if (nneg==3) {
-                    ie = i1;
-                } else if (naf[i2]->_val>=0) {
-                    ie = i2;
-                } else if (sumval<0) {
-                    ie = i1;
-                } else {
-                    ie = i3;
-                }
-                Vertex v1 = get_vertex_onedge(naf[i1], naf[i]);
-                Vertex v2 = get_vertex_onedge(naf[ie], naf[mod4(ie+1)]);
-                mapsucc.enter(v2, v1);  // to get face order correct
-            }
-        }
+        base::contour_cube_segments(na, [&](Node* np1, Node* nn1, Node* np2, Node* nn2) {
+            Vertex v1 = get_vertex_onedge(np1, nn1);
+            Vertex v2 = get_vertex_onedge(np2, nn2);
+            mapsucc.enter(v2, v1);  // to get face order correct
+        });
         Vec<Vertex,12> va;
         while (!mapsucc.empty()) {
             Vertex vf = nullptr; int minvi = INT_MAX; // find min to be portable
@@ -421,12 +542,315 @@ class Contour3DMesh : public Contour3DBase<VertexData3DMesh, Contour3DMesh<Eval,
         Vertex& v = *pv;
         if (is_new) {
             v = _pmesh->create_vertex();
-            _pmesh->set_point(v, this->template compute_point<false>(n1->_p, n2->_p, n1->_val, n2->_val, _eval));
+            _pmesh->set_point(v, this->template compute_point<false>(this->node_point(n1), this->node_point(n2),
+                                                                      n1->_val, n2->_val, _eval));
         }
         return v;
     }
 };
 
+// Like Contour3DMesh, but the domain is partitioned into bricks of brick_size^3 cubes, each with its own node table,
+//  which are marched concurrently in rounds: in each round, every brick gathers the new grid vertices of its queued
+//  cubes, these are evaluated together, and every brick then visits its queued cubes.  Cubes reached across a brick
+//  face are handed to the neighboring brick for the next round.  Grid vertices on brick faces are shared through a
+//  table, so each grid vertex is evaluated once and the visited cubes and evaluated vertices are those of
+//  Contour3DMesh.  Once no brick has pending cubes, each brick extracts its faces in encoded cube order and the faces
+//  are stitched into the mesh in brick order, with vertices identified by their cube edge.
+// The resulting mesh is independent of the number of threads, although its vertex and face order differs from that
+//  of Contour3DMesh.  The Eval functor must be safe to call concurrently, and no border output is supported.
+template<typename Eval = float(const Vec3<float>&)>
+class BrickContour3DMesh : public Contour3DBase<Vec0<int>, BrickContour3DMesh<Eval>, Eval> {
+    using base = Contour3DBase<Vec0<int>, BrickContour3DMesh<Eval>, Eval>;
+    using typename base::DPoint;
+    using typename base::IPoint;
+ public:
+    // num_threads==0 uses all cores.
+    BrickContour3DMesh(int gn, GMesh* pmesh, Eval eval = Eval(), int num_threads = 0, int brick_size = 32)
+        : base(gn, eval, Contour3D_NoBorder()), _pmesh(pmesh),
+          _num_threads(num_threads ? num_threads : get_max_threads()), _brick_size(brick_size) {
+        assertx(_pmesh); assertx(_num_threads>=1); assertx(_brick_size>=1);
+    }
+    ~BrickContour3DMesh()                       { assertw(!_seeds.num()); } // else forgot to call march()
+    void big_mesh_faces()                       { _big_mesh_faces = true; }
+    // Record the cube containing startp as a seed for the next march().
+    void march_from(const DPoint& startp)       { _seeds.push(encode(start_cube(startp))); }
+    // Record all cubes near startp as seeds for the next march().
+    void march_near(const DPoint& startp) {
+        IPoint cc = start_cube(startp);
+        for (const IPoint& cd : range(ntimes<D>(-1), ntimes<D>(2))) {
+            IPoint ci = cc+cd;
+            if (cube_inbounds(ci)) _seeds.push(encode(ci));
+        }
+    }
+    // March from all recorded seeds and add the new contour faces to the mesh; ret number of new cubes visited.
+    int march();
+ private:
+    using typename base::Node222;
+    using typename base::Node;
+    using typename base::NodeStore;
+    using typename base::Encoded;
+    using base::D; using base::_gn; using base::_eval; using base::encode; using base::decode;
+    using base::cube_inbounds; using base::get_point; using base::k_not_yet_evaled;
+    using base::_ncvisited; using base::_ncundef; using base::_ncnothing;
+    using base::_nvevaled; using base::_nvzero; using base::_nvundef;
+    using base::_tmp_nodes; using base::_tmp_points; using base::_tmp_vals;
+    struct Brick {
+        explicit Brick(const IPoint& pbc, bool hashed) : bc(pbc) { m.set_hashed(hashed); }
+        IPoint bc;                              // brick indices
+        NodeStore m;                            // nodes of the cubes in this brick and of their vertices
+        Queue<Encoded> queue;                   // cubes queued to be visited
+        Array<Encoded> inbox;                   // seed cubes, or cubes handed over from neighboring bricks
+        Array<Encoded> outbox;                  // cubes to hand over to neighboring bricks
+        Array<Encoded> cubes;                   // visited cubes with defined values, to be contoured
+        Array<Encoded> fkeys;                   // edge keys of the vertices of the output faces
+        Array<int> fnv;                         // number of vertices in each output face
+        Array<Encoded> frontier;                // queued cubes to visit in this round
+        Array<Node*> pending;                   // grid vertices of the frontier cubes to evaluate in this round
+        Map<Encoded, DPoint> mvpos;             // edge key -> vertex position
+        int ncvisited {0}, ncundef {0};
+    };
+    GMesh* _pmesh;
+    int _num_threads;
+    int _brick_size;
+    bool _big_mesh_faces {false};
+    Array<Encoded> _seeds;
+    Map<Encoded, unique_ptr<Brick>> _mbricks; // encoded brick indices -> Brick
+    Map<Encoded, Vertex> _mvertex;            // edge key -> mesh vertex
+    Map<Encoded, float> _mshared;             // encoded grid vertex on a brick face -> its value
+    Array<float*> _tmp_pshared;               // entries in _mshared of the vertices evaluated in a round
+    //
+    IPoint start_cube(const DPoint& startp) const {
+        for_int(d, D) ASSERTX(startp[d]>=0.f && startp[d]<=1.f);
+        IPoint cc; for_int(d, D) { cc[d] = min(static_cast<int>(startp[d]*_gn), _gn-1); }
+        return cc;
+    }
+    IPoint brick_of(const IPoint& cc) const     { return cc/_brick_size; }
+    Brick& get_brick(const IPoint& bc) {
+        unique_ptr<Brick>& pbrick = _mbricks[encode(bc)];
+        if (!pbrick) pbrick = make_unique<Brick>(bc, this->_m.hashed());
+        return *pbrick;
+    }
+    // A vertex of the contour lies on a grid edge, identified by its lower node and its axis.
+    Encoded edge_key(const Node* n1, const Node* n2) const {
+        static_assert(3*base::k_nbits+2<=64, ""); // bits for the node, 2 bits for the axis
+        IPoint cc1 = decode(n1->_en);
+        IPoint cc2 = decode(n2->_en);
+        int d = -1;
+        for_int(c, D) { if (cc1[c]!=cc2[c]) { ASSERTX(d<0); d = c; } }
+        ASSERTX(d>=0);
+        ASSERTX(abs(cc1[d]-cc2[d])==1);
+        return (((cc1[d]<cc2[d]) ? n1 : n2)->_en<<2) | Encoded(d);
+    }
+    bool on_brick_face(const IPoint& ci) const {
+        for_int(c, D) { if (ci[c]%_brick_size==0) return true; }
+        return false;
+    }
+    // Enqueue the cubes in the inbox, and find the grid vertices of all queued cubes that are not yet evaluated.
+    void gather_brick(Brick& brick) {
+        for (Encoded en : brick.inbox) {
+            Node* n = brick.m.enter(en);
+            if (n->_cubestate!=base::Node::ECubestate::nothing) continue;
+            n->_cubestate = base::Node::ECubestate::queued;
+            brick.queue.enqueue(en);
+        }
+        brick.inbox.clear();
+        while (!brick.queue.empty()) brick.frontier.push(brick.queue.dequeue());
+        for (Encoded encube : brick.frontier) {
+            IPoint cc = decode(encube);
+            for_int(i, 2) for_int(j, 2) for_int(k, 2) {
+                IPoint ci = cc+IPoint(i, j, k);
+                Node* n = brick.m.enter(encode(ci));
+                if (n->_val!=k_not_yet_evaled) continue;
+                if (on_brick_face(ci)) {
+                    bool present; float val = _mshared.retrieve(n->_en, present); // evaluated in an earlier round
+                    if (present) { n->_val = val; continue; }
+                }
+                n->_val = -k_not_yet_evaled; // mark as pending, to only include it once
+                brick.pending.push(n);
+            }
+        }
+    }
+    // Evaluate the pending grid vertices of the active bricks, each once.
+    void eval_pending(CArrayView<Brick*> active, ThreadPoolIndexedTask& thread_pool) {
+        _tmp_nodes.init(0); _tmp_points.init(0); _tmp_pshared.init(0);
+        for (Brick* pbrick : active) {
+            for (Node* n : pbrick->pending) {
+                IPoint ci = decode(n->_en);
+                float* pshared = nullptr;
+                if (on_brick_face(ci)) {
+                    bool is_new; pshared = &_mshared.enter(n->_en, k_not_yet_evaled, is_new);
+                    if (!is_new) continue; // pending in another brick too
+                }
+                _tmp_nodes.push(n); _tmp_points.push(get_point(ci)); _tmp_pshared.push(pshared);
+            }
+        }
+        const int num = _tmp_points.num();
+        _tmp_vals.init(num);
+        eval_points(thread_pool, std::integral_constant<bool, base::b_batch_eval>());
+        for_int(i, num) {
+            float val = _tmp_vals[i];
+            ASSERTX(val!=k_not_yet_evaled);
+            _tmp_nodes[i]->_val = val;
+            if (_tmp_pshared[i]) *_tmp_pshared[i] = val;
+            _nvevaled++;
+            if (!val) _nvzero++;
+            if (val==k_Contour_undefined) _nvundef++;
+        }
+    }
+    void eval_points(ThreadPoolIndexedTask&, std::true_type) { _eval(_tmp_points, _tmp_vals); }
+    void eval_points(ThreadPoolIndexedTask& thread_pool, std::false_type) {
+        const int num = _tmp_points.num(), chunk_size = 64;
+        thread_pool.execute((num+chunk_size-1)/chunk_size, [&](int ichunk) {
+            for_intL(i, ichunk*chunk_size, min((ichunk+1)*chunk_size, num)) { _tmp_vals[i] = _eval(_tmp_points[i]); }
+        });
+    }
+    // Visit the queued cubes, whose grid vertices are now all evaluated.
+    void visit_brick(Brick& brick) {
+        for (Node* n : brick.pending) {
+            if (n->_val==-k_not_yet_evaled) n->_val = _mshared.get(n->_en); // evaluated for another brick
+        }
+        brick.pending.clear();
+        for (Encoded en : brick.frontier) consider_brick_cube(brick, en);
+        brick.frontier.clear();
+    }
+    void consider_brick_cube(Brick& brick, Encoded encube) {
+        brick.ncvisited++;
+        IPoint cc = decode(encube);
+        Node222 na;
+        bool cundef = false;
+        for_int(i, 2) for_int(j, 2) for_int(k, 2) {
+            Node* n = brick.m.get(encode(cc+IPoint(i, j, k)));
+            ASSERTX(n->_val!=k_not_yet_evaled && n->_val!=-k_not_yet_evaled);
+            na[i][j][k] = n;
+            if (n->_val==k_Contour_undefined) cundef = true;
+        }
+        Node* n = na[0][0][0];
+        ASSERTX(n->_cubestate==base::Node::ECubestate::queued);
+        n->_cubestate = base::Node::ECubestate::visited;
+        if (cundef) {
+            brick.ncundef++;
+        } else {
+            brick.cubes.push(encube);
+        }
+        for_int(d, D) for_int(i, 2) { // push neighbors
+            int d1 = (d+1)%D, d2 = (d+2)%D;
+            IPoint cd; cd[d] = i;
+            float vmin = BIGFLOAT, vmax = -BIGFLOAT;
+            for (cd[d1] = 0; cd[d1]<2; cd[d1]++) {
+                for (cd[d2] = 0; cd[d2]<2; cd[d2]++) {
+                    float v = na[cd[0]][cd[1]][cd[2]]->_val;
+                    if (v<vmin) vmin = v;
+                    if (v>vmax) vmax = v;
+                }
+            }
+            cd[d] = i ? 1 : -1;
+            cd[d1] = cd[d2] = 0;
+            IPoint ci = cc+cd;  // indices of node for neighboring cube;
+            if (!(vmax!=k_Contour_undefined && vmin<0 && vmax>=0 && cube_inbounds(ci))) continue;
+            Encoded en = encode(ci);
+            if (brick_of(ci)!=brick.bc) {
+                brick.outbox.push(en);
+                continue;
+            }
+            Node* n2 = brick.m.enter(en);
+            if (n2->_cubestate==base::Node::ECubestate::nothing) {
+                n2->_cubestate = base::Node::ECubestate::queued;
+                brick.queue.enqueue(en);
+            }
+        }
+    }
+    void extract_brick(Brick& brick) {
+        sort(brick.cubes);
+        for (Encoded encube : brick.cubes) {
+            IPoint cc = decode(encube);
+            Node222 na;
+            for_int(i, 2) for_int(j, 2) for_int(k, 2) {
+                na[i][j][k] = brick.m.get(encode(cc+IPoint(i, j, k)));
+            }
+            Map<Encoded, Encoded> mapsucc;
+            base::contour_cube_segments(na, [&](Node* np1, Node* nn1, Node* np2, Node* nn2) {
+                Encoded k1 = edge_key(np1, nn1), k2 = edge_key(np2, nn2);
+                for (Encoded k : {k1, k2}) {
+                    if (brick.mvpos.contains(k)) continue;
+                    Node* np = k==k1 ? np1 : np2; Node* nn = k==k1 ? nn1 : nn2;
+                    brick.mvpos.enter(k, this->template compute_point<false>(this->node_point(np),
+                                                                              this->node_point(nn),
+                                                                              np->_val, nn->_val, _eval));
+                }
+                mapsucc.enter(k2, k1);  // to get face order correct
+            });
+            while (!mapsucc.empty()) {
+                Encoded kf = std::numeric_limits<Encoded>::max();
+                for (Encoded k : mapsucc.keys()) { kf = min(kf, k); }
+                int nv = 0;
+                for (Encoded k = kf; ; ) {
+                    brick.fkeys.push(k); nv++;
+                    k = mapsucc.remove(k);
+                    if (k==kf) break;
+                }
+                brick.fnv.push(nv);
+            }
+        }
+        brick.cubes.clear();
+    }
+    void stitch_brick(Brick& brick) {
+        Vec<Vertex,12> va;
+        int j = 0;
+        for (int nv : brick.fnv) {
+            for_int(i, nv) {
+                Encoded k = brick.fkeys[j++];
+                bool is_new; Vertex& v = _mvertex.enter(k, nullptr, is_new);
+                if (is_new) {
+                    v = _pmesh->create_vertex();
+                    _pmesh->set_point(v, brick.mvpos.get(k));
+                }
+                va[i] = v;
+            }
+            Face f = _pmesh->create_face(CArrayView<Vertex>(va.data(), nv));
+            if (nv>3 && !_big_mesh_faces) {
+                // If 6 or more edges, may have 2 edges on same cube face, then must introduce new vertex to be safe.
+                if (nv>=6) _pmesh->center_split_face(f);
+                else assertx(triangulate_face(*_pmesh, f));
+            }
+        }
+        brick.fkeys.clear(); brick.fnv.clear(); brick.mvpos.clear();
+    }
+};
+
+template<typename Eval> int BrickContour3DMesh<Eval>::march() {
+    int oncvisited = _ncvisited;
+    for (Encoded en : _seeds) { get_brick(brick_of(decode(en))).inbox.push(en); }
+    _seeds.clear();
+    ThreadPoolIndexedTask thread_pool(_num_threads);
+    for (;;) {
+        Array<Brick*> active;
+        for (auto& pbrick : _mbricks.values()) {
+            if (pbrick->inbox.num() || !pbrick->queue.empty()) active.push(pbrick.get());
+        }
+        if (!active.num()) break;
+        thread_pool.execute(active.num(), [&](int i) { gather_brick(*active[i]); });
+        eval_pending(active, thread_pool);
+        thread_pool.execute(active.num(), [&](int i) { visit_brick(*active[i]); });
+        // The set of visited cubes does not depend on the order in which cubes are handed over.
+        for (Brick* pbrick : active) {
+            for (Encoded en : pbrick->outbox) { get_brick(brick_of(decode(en))).inbox.push(en); }
+            pbrick->outbox.clear();
+        }
+    }
+    Array<Encoded> brick_keys; for (Encoded k : _mbricks.keys()) { brick_keys.push(k); }
+    sort(brick_keys);
+    thread_pool.execute(brick_keys.num(), [&](int i) { extract_brick(*_mbricks.get(brick_keys[i])); });
+    for (Encoded k : brick_keys) {
+        Brick& brick = *_mbricks.get(k);
+        stitch_brick(brick);
+        _ncvisited += brick.ncvisited; _ncundef += brick.ncundef;
+        brick.ncvisited = brick.ncundef = 0;
+    }
+    int cncvisited = _ncvisited-oncvisited;
+    if (cncvisited==1) _ncnothing++;
+    return cncvisited;
+}
+
 template<typename Eval = float(const Vec3<float>&),
          typename Contour = float(const Array<Vec3<float>>&),
          typename Border = Contour3D_NoBorder>
@@ -480,11 +904,12 @@ class Contour3D : public Contour3DBase<Vec0<int>, Contour3D<Eval, Contour, Borde
         auto& poly = _tmp_poly; poly.init(3);
         for_int(i, 3) {
             Node* np = n3[i][0]; Node* nn = n3[i][1];
-            poly[i] = this->template compute_point<true>(np->_p, nn->_p, np->_val, nn->_val, _eval);
+            poly[i] = this->template compute_point<true>(this->node_point(np), this->node_point(nn),
+                                                         np->_val, nn->_val, _eval);
         }
         Vector normal = cross(poly[0], poly[1], poly[2]);
         // swap might be unnecessary if we carefully swapped above?
-        if (dot(normal, n3[0][0]->_p-n3[0][1]->_p)<0.f) std::swap(poly[0], poly[1]);
+        if (dot(normal, this->node_point(n3[0][0])-this->node_point(n3[0][1]))<0.f) std::swap(poly[0], poly[1]);
         _contour(poly);
     }
 };
@@ -518,14 +943,6 @@ class Contour2D : public ContourBase<2> {
     using Node22 = SGrid<Node*, 2, 2>;
     using base::k_not_yet_evaled;
     //
-    unsigned encode(const IPoint& ci) const {
-        static_assert(k_max_gn<=65536, "");
-        return (unsigned(ci[0])<<16) | unsigned(ci[1]);
-    }
-    IPoint decode(unsigned en) const {
-        static_assert(k_max_gn<=65536, "");
-        return IPoint(narrow_cast<int>(en>>16), narrow_cast<int>(en&((1u<<16)-1)));
-    }
     void check_ok()                             { }
     int march_from_i(const DPoint& startp) {
         check_ok();
@@ -551,22 +968,22 @@ class Contour2D : public ContourBase<2> {
     int march_from_aux(const IPoint& cc) {
         int oncvisited = _ncvisited;
         {
-            unsigned en = encode(cc);
-            bool is_new; Node* n = const_cast<Node*>(&_m.enter(Node(en), is_new));
+            Encoded en = encode(cc);
+            Node* n = _m.enter(en);
             if (n->_cubestate==Node::ECubestate::visited) return 0;
             ASSERTX(n->_cubestate==Node::ECubestate::nothing);
             _queue.enqueue(en);
             n->_cubestate = Node::ECubestate::queued;
         }
         while (!_queue.empty()) {
-            unsigned en = _queue.dequeue();
+            Encoded en = _queue.dequeue();
             consider_square(en);
         }
         int cncvisited = _ncvisited-oncvisited;
         if (cncvisited==1) _ncnothing++;
         return cncvisited;
     }
-    void consider_square(unsigned encube) {
+    void consider_square(Encoded encube) {
         _ncvisited++;
         IPoint cc = decode(encube);
         Node22 na; {
@@ -575,12 +992,11 @@ class Contour2D : public ContourBase<2> {
             for (cd[0] = 0; cd[0]<2; cd[0]++) {
                 for (cd[1] = 0; cd[1]<2; cd[1]++) {
                     IPoint ci = cc+cd;
-                    unsigned en = encode(ci);
-                    bool is_new; Node* n = const_cast<Node*>(&_m.enter(Node(en), is_new));
+                    Encoded en = encode(ci);
+                    Node* n = _m.enter(en);
                     na[cd[0]][cd[1]] = n;
                     if (n->_val==k_not_yet_evaled) {
-                        n->_p = get_point(ci);
-                        n->_val = _eval(n->_p);
+                        n->_val = _eval(get_point(ci));
                         _nvevaled++;
                         if (!n->_val) _nvzero++;
                         if (n->_val==k_Contour_undefined) _nvundef++;
@@ -612,8 +1028,8 @@ class Contour2D : public ContourBase<2> {
             IPoint ci = cc+cd;  // indices of node for neighboring cube;
             // note: vmin<0 since 0 is arbitrarily taken to be positive
             if (vmax!=k_Contour_undefined && vmin<0 && vmax>=0 && cube_inbounds(ci)) {
-                unsigned en = encode(ci);
-                bool is_new; Node* n = const_cast<Node*>(&_m.enter(Node(en), is_new));
+                Encoded en = encode(ci);
+                Node* n = _m.enter(en);
                 if (n->_cubestate==Node::ECubestate::nothing) {
                     n->_cubestate = Node::ECubestate::queued;
                     _queue.enqueue(en);
@@ -649,11 +1065,11 @@ class Contour2D : public ContourBase<2> {
         auto& poly = _tmp_poly; poly.init(2);
         for_int(i, 2) {
             Node* np = n2[i][0]; Node* nn = n2[i][1];
-            poly[i] = compute_point<true>(np->_p, nn->_p, np->_val, nn->_val, _eval);
+            poly[i] = compute_point<true>(this->node_point(np), this->node_point(nn), np->_val, nn->_val, _eval);
         }
         Vec2<float> v = poly[1]-poly[0];
         Vec2<float> normal(-v[1], v[0]); // 90 degree rotation
-        if (dot(normal, n2[0][0]->_p-n2[0][1]->_p)<0.) std::swap(poly[0], poly[1]);
+        if (dot(normal, node_point(n2[0][0])-node_point(n2[0][1]))<0.) std::swap(poly[0], poly[1]);
         _contour(poly);
     }
 };
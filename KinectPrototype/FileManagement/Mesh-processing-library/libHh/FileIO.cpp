@@ -22,6 +22,7 @@
 #include <utime.h>              // struct utimbuf, struct _utimbuf, utime()
 #include <sys/wait.h>           // wait(), waidpid()
 #include <dirent.h>             // struct dirent, opendir(), readdir(), closedir()
+#include <sys/mman.h>           // mmap(), munmap()
 
 #endif  // defined(_WIN32)
 
@@ -45,6 +46,13 @@
 #include "StringOp.h"
 #include "Locks.h"
 #include "RangeOp.h"            // contains()
+#include "Parallel.h"           // parallel_for_each()
+
+#if !defined(HH_NO_ZLIB) && !defined(HH_NO_IMAGE_IO) // libz is linked along with libpng
+#define HH_FILEIO_HAVE_ZLIB
+#include <zlib.h>               // inflate(), deflate()
+HH_REFERENCE_LIB("libz.lib");
+#endif
 
 // Note that RFile/WFile first construct a FILE* (which is accessible via cfile()), then a std::stream on top.
 // This is quite flexible.  I use this in:
@@ -53,6 +61,8 @@
 // - G3dio.cpp to create a RBuffer directly on the POSIX file descriptor fileno(cfile());
 //   It might be possible to implement RBuffer as a custom adaptively resizable std::streambuf
 //    but we would still require access to the POSIX fd to do non-blocking IO.
+// Files "*.gz" are instead (de)compressed in-process using zlib (without any FILE* for the uncompressed data),
+//  unless the constructor argument need_cfile is set or the environment variable FILEIO_GZIP_PIPE is set.
 
 namespace hh {
 
@@ -212,6 +222,160 @@ class ocfstream : public std::ostream {
 #endif  // defined(IO_USE_CFSTREAM)
 
 
+#if defined(HH_FILEIO_HAVE_ZLIB)
+
+// An implementation of streambuf that decompresses a gzip (or zlib) FILE* input stream in-process.
+// Like "gzip -d", it reads successive concatenated gzip members.  The FILE* is closed upon destruction.
+class igzstreambuf : public std::streambuf {
+ public:
+    explicit igzstreambuf(FILE* file) : _file(file), _ibuf(k_ibuf_size), _obuf(k_obuf_size) {
+        std::memset(&_zs, 0, sizeof(_zs));
+        assertx(inflateInit2(&_zs, 15+32)==Z_OK); // 15: max window; 32: auto-detect gzip or zlib header
+        setg(_obuf.data(), _obuf.data(), _obuf.data());
+    }
+    ~igzstreambuf() {
+        inflateEnd(&_zs);
+        assertw(!fclose(_file));
+    }
+ private:
+    static constexpr int k_ibuf_size = 1<<16;
+    static constexpr int k_obuf_size = 1<<18;
+    FILE* _file;
+    z_stream _zs;
+    Array<char> _ibuf;
+    Array<char> _obuf;
+    bool _eof {false};
+    bool _in_member {false};    // have begun but not completed a gzip member
+    virtual int_type underflow() override {
+        if (gptr()<egptr()) return traits_type::to_int_type(*gptr());
+        while (!_eof) {
+            if (!_zs.avail_in) {
+                size_t num = fread(_ibuf.data(), sizeof(char), _ibuf.num(), _file);
+                if (!num) {
+                    _eof = true;
+                    if (_in_member) Warning("Compressed gzip stream is truncated");
+                    break;
+                }
+                _zs.next_in = reinterpret_cast<Bytef*>(_ibuf.data());
+                _zs.avail_in = narrow_cast<uInt>(num);
+            }
+            _zs.next_out = reinterpret_cast<Bytef*>(_obuf.data());
+            _zs.avail_out = uInt(_obuf.num());
+            _in_member = true;
+            int ret = inflate(&_zs, Z_NO_FLUSH);
+            if (ret==Z_STREAM_END) {
+                _in_member = false;
+                assertx(inflateReset(&_zs)==Z_OK); // prepare for a subsequent member, if any
+            } else if (ret!=Z_OK && ret!=Z_BUF_ERROR) {
+                Warning("Error in compressed gzip stream");
+                _eof = true;
+            }
+            int num = _obuf.num()-int(_zs.avail_out);
+            if (num) {
+                setg(_obuf.data(), _obuf.data(), _obuf.data()+num);
+                return traits_type::to_int_type(*gptr());
+            }
+        }
+        return EOF;
+    }
+};
+
+class igzstream : public std::istream {
+ public:
+    explicit igzstream(FILE* file) : std::istream(nullptr), _buf(file) {
+        rdbuf(&_buf);
+    }
+ private:
+    igzstreambuf _buf;
+};
+
+// An implementation of streambuf that compresses to a gzip FILE* output stream in-process.
+// The data is partitioned into fixed-size blocks which are compressed concurrently as independent gzip members
+//  (the concatenation is a valid gzip file); therefore sync() does not force out a partially filled block.
+// The FILE* is closed upon destruction.
+class ogzstreambuf : public std::streambuf {
+ public:
+    explicit ogzstreambuf(FILE* file) : _file(file), _level(getenv_int("FILEIO_GZIP_LEVEL", 6, true)) {
+        assertx(_level>=1 && _level<=9); // 1 is fastest
+        _blocks.init(k_max_blocks);
+        _blocks[0].init(k_block_size);
+        setp(_blocks[0].data(), _blocks[0].data()+k_block_size);
+    }
+    ~ogzstreambuf() {
+        const int num = int(pptr()-pbase());
+        if (num || (!_nblocks && !_any_written)) _blocks[_nblocks++].resize(num); // empty file gets one gzip member
+        compress_blocks();
+        assertw(!fclose(_file));
+    }
+ private:
+    static constexpr int k_block_size = 1<<20;
+    static constexpr int k_max_blocks = 16; // filled blocks are compressed as a parallel batch
+    FILE* _file;
+    int _level;
+    Array<Array<char>> _blocks;
+    Array<Array<uchar>> _zblocks;
+    int _nblocks {0};           // number of completely filled blocks
+    bool _any_written {false};
+    void compress_blocks() {
+        _zblocks.init(_nblocks);
+        parallel_for_each(range(_nblocks), [&](const int i) {
+            z_stream zs; std::memset(&zs, 0, sizeof(zs));
+            assertx(deflateInit2(&zs, _level, Z_DEFLATED, 15+16, 8, Z_DEFAULT_STRATEGY)==Z_OK); // 16: gzip header
+            _zblocks[i].init(int(deflateBound(&zs, _blocks[i].num())));
+            zs.next_in = reinterpret_cast<Bytef*>(_blocks[i].data());
+            zs.avail_in = uInt(_blocks[i].num());
+            zs.next_out = _zblocks[i].data();
+            zs.avail_out = uInt(_zblocks[i].num());
+            assertx(deflate(&zs, Z_FINISH)==Z_STREAM_END);
+            _zblocks[i].resize(_zblocks[i].num()-int(zs.avail_out));
+            assertx(deflateEnd(&zs)==Z_OK);
+        }, k_block_size*uint64_t{20});
+        for_int(i, _nblocks) {
+            assertw(fwrite(_zblocks[i].data(), sizeof(uchar), _zblocks[i].num(), _file)==size_t(_zblocks[i].num()));
+            _any_written = true;
+        }
+        _nblocks = 0;
+    }
+    virtual int_type overflow(int_type ch) override { // the current block is full
+        _nblocks++;
+        if (_nblocks==k_max_blocks) compress_blocks();
+        Array<char>& block = _blocks[_nblocks];
+        block.init(k_block_size);
+        setp(block.data(), block.data()+k_block_size);
+        if (ch!=EOF) { *pptr() = char(ch); pbump(1); }
+        return traits_type::not_eof(ch);
+    }
+};
+
+class ogzstream : public std::ostream {
+ public:
+    explicit ogzstream(FILE* file) : std::ostream(nullptr), _buf(file) {
+        rdbuf(&_buf);
+    }
+ private:
+    ogzstreambuf _buf;
+};
+
+bool use_inprocess_gzip(bool need_cfile) {
+    static const bool k_gzip_pipe = getenv_bool("FILEIO_GZIP_PIPE");
+    return !need_cfile && !k_gzip_pipe;
+}
+
+#else
+
+bool use_inprocess_gzip(bool) { return false; }
+
+#endif  // defined(HH_FILEIO_HAVE_ZLIB)
+
+FILE* my_fopen(const string& sfor, bool for_write) {
+#if defined(_WIN32) && !defined(HH_NO_UTF8)
+    return _wfopen(widen(sfor).c_str(), for_write ? L"wb" : L"rb");
+#else
+    return fopen(sfor.c_str(), for_write ? "wb" : "rb");
+#endif
+}
+
+
 } // namespace
 
 
@@ -278,15 +442,27 @@ class WFile::Implementation {
 
 // *** RFile
 
-RFile::RFile(const string& filename) {
+RFile::RFile(const string& filename, bool need_cfile) {
     string sfor = get_canonical_path(filename);
     const string mode = "r";
+    auto open_compressed = [&](const string& name) {
+#if defined(HH_FILEIO_HAVE_ZLIB)
+        if (!ends_with(name, ".Z") && use_inprocess_gzip(need_cfile)) {
+            if (FILE* file = my_fopen(name, false)) {
+                _gzstream = make_unique<igzstream>(file);
+                _is = _gzstream.get();
+            }
+            return;
+        }
+#endif
+        _file_ispipe = true;
+        _file = my_popen(V<string>("gzip", "-d", "-c", name), mode); // gzip supports .Z (replacement for zcat)
+    };
     if (ends_with(filename, "|")) {
         _file_ispipe = true;
         _file = my_popen(filename.substr(0, filename.size()-1), mode); // no quoting at all
     } else if (ends_with(filename, ".gz") || ends_with(filename, ".Z")) {
-        _file_ispipe = true;
-        _file = my_popen(V<string>("gzip", "-d", "-c", sfor), mode); // gzip supports .Z (replacement for zcat)
+        open_compressed(sfor);
     } else if (filename=="-") {
         // assertw(!HH_POSIX(isatty)(0));
         _file = stdin;
@@ -294,17 +470,11 @@ RFile::RFile(const string& filename) {
     } else if (file_exists(sfor)) {
         if (!assertw(!file_exists(sfor + ".Z")) || !assertw(!file_exists(sfor + ".gz")))
             showdf("** Using uncompressed version of '%s'\n", sfor.c_str());
-#if defined(_WIN32) && !defined(HH_NO_UTF8)
-        _file = _wfopen(widen(sfor).c_str(), L"rb");
-#else
-        _file = fopen(sfor.c_str(), "rb");
-#endif
+        _file = my_fopen(sfor, false);
     } else if (file_exists(sfor + ".gz")) {
-        _file_ispipe = true;
-        _file = my_popen(V<string>("gzip", "-d", "-c", sfor + ".gz"), mode);
+        open_compressed(sfor + ".gz");
     } else if (file_exists(sfor + ".Z")) {
-        _file_ispipe = true;
-        _file = my_popen(V<string>("gzip", "-d", "-c", sfor + ".Z"), mode);
+        open_compressed(sfor + ".Z");
     }
     if (_file && !_is) {
         _impl = make_unique<Implementation>(_file);
@@ -321,6 +491,7 @@ RFile::~RFile() {
 #endif
     }
     _impl = nullptr;
+    _gzstream = nullptr;
     if (_file) {
         if (_file_ispipe) {
             int ret = my_pclose(_file);
@@ -336,7 +507,7 @@ RFile::~RFile() {
 
 // *** WFile
 
-WFile::WFile(const string& filename) {
+WFile::WFile(const string& filename, bool need_cfile) {
     assertx(filename!="");
     string sfor = get_canonical_path(filename);
     const string mode = "w";
@@ -346,6 +517,13 @@ WFile::WFile(const string& filename) {
     } else if (ends_with(filename, ".Z")) {
         _file_ispipe = true;
         _file = my_popen(("compress >" + portable_simple_quote(sfor)), mode);
+    } else if (ends_with(filename, ".gz") && use_inprocess_gzip(need_cfile)) {
+#if defined(HH_FILEIO_HAVE_ZLIB)
+        if (FILE* file = my_fopen(sfor, true)) {
+            _gzstream = make_unique<ogzstream>(file);
+            _os = _gzstream.get();
+        }
+#endif
     } else if (ends_with(filename, ".gz")) {
         _file_ispipe = true;
         _file = my_popen(("gzip >" + portable_simple_quote(sfor)), mode);
@@ -353,11 +531,7 @@ WFile::WFile(const string& filename) {
         _file = stdout;
         _os = &std::cout;
     } else {
-#if defined(_WIN32) && !defined(HH_NO_UTF8)
-        _file = _wfopen(widen(sfor).c_str(), L"wb");
-#else
-        _file = fopen(sfor.c_str(), "wb");
-#endif
+        _file = my_fopen(sfor, true);
     }
     if (_file && !_os) {
         _impl = make_unique<Implementation>(_file);
@@ -375,6 +549,7 @@ WFile::WFile(const string& filename) {
 WFile::~WFile() {
     if (_os) _os->flush();
     _impl = nullptr;
+    _gzstream = nullptr;        // compresses any remaining data and closes the file
     if (_file) {
         fflush(_file);
         if (_file_ispipe) {
@@ -559,6 +734,47 @@ TmpFile::~TmpFile() {
     if (!getenv_bool("TMPFILE_KEEP")) { assertx(!HH_POSIX(unlink)(_filename.c_str())); }
 }
 
+MappedFile::MappedFile(const string& filename) {
+#if defined(_WIN32)
+    HANDLE h_file = CreateFileW(widen(filename).c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr,
+                                OPEN_EXISTING, FILE_FLAG_RANDOM_ACCESS, nullptr);
+    if (h_file==INVALID_HANDLE_VALUE) throw std::runtime_error("Could not open file '" + filename + "'");
+    LARGE_INTEGER li; assertx(GetFileSizeEx(h_file, &li));
+    _size = size_t(li.QuadPart);
+    // CreateFileMapping fails on files of size 0.
+    if (_size) {
+        // 0=no_security,  0,0=map_whole_file,  0=no_name
+        HANDLE h_fmapping = CreateFileMapping(h_file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+        assertx(h_fmapping!=nullptr);
+        _data = static_cast<const char*>(MapViewOfFile(h_fmapping, FILE_MAP_READ, 0, 0, 0));
+        assertx(_data);
+        assertx(CloseHandle(h_fmapping)); // the view keeps the mapping alive
+    }
+    assertx(CloseHandle(h_file));
+#else
+    int fd = open(filename.c_str(), O_RDONLY);
+    if (fd<0) throw std::runtime_error("Could not open file '" + filename + "'");
+    struct stat stat_buf;
+    assertx(!fstat(fd, &stat_buf));
+    _size = size_t(stat_buf.st_size);
+    if (_size) {
+        void* p = mmap(nullptr, _size, PROT_READ, MAP_SHARED, fd, 0);
+        assertx(p!=MAP_FAILED);
+        _data = static_cast<const char*>(p);
+    }
+    assertx(!close(fd));        // the mapping remains valid
+#endif
+}
+
+MappedFile::~MappedFile() {
+    if (!_data) return;
+#if defined(_WIN32)
+    assertx(UnmapViewOfFile(_data));
+#else
+    assertx(!munmap(const_cast<char*>(_data), _size));
+#endif
+}
+
 
 // Notes on cygwin double-quote problem:
 //
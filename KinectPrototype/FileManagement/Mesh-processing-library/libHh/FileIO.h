@@ -10,15 +10,17 @@ namespace hh {
 class RFile : noncopyable {
  public:
     // supports "-", ".Z", ".gz", "command args... |"  (in most cases, try to close stdin within "command |")
-    explicit RFile(const string& filename);
+    // A ".gz" file is decompressed in-process, unless need_cfile requests a FILE* (from a "gzip -d" pipe).
+    explicit RFile(const string& filename, bool need_cfile = false);
     ~RFile();
     std::istream& operator()() const            { return *_is; }
-    FILE* cfile()                               { return _file; }
+    FILE* cfile()                               { return _file; } // nullptr if decompressed in-process
  private:
     bool _file_ispipe {false};
     FILE* _file {nullptr};
     class Implementation;
     unique_ptr<Implementation> _impl;
+    unique_ptr<std::istream> _gzstream;
     std::istream* _is {nullptr};
 };
 
@@ -26,15 +28,18 @@ class RFile : noncopyable {
 class WFile : noncopyable {
  public:
     // supports "-", ".Z", ".gz", "| command args..."
-    explicit WFile(const string& filename);
+    // A ".gz" file is compressed in-process (using parallel blocks; set FILEIO_GZIP_LEVEL=1 for the fastest
+    //  compression), unless need_cfile requests a FILE* (to a "gzip" pipe).
+    explicit WFile(const string& filename, bool need_cfile = false);
     ~WFile();
     std::ostream& operator()() const            { return *_os; }
-    FILE* cfile()                               { return _file; }
+    FILE* cfile()                               { return _file; } // nullptr if compressed in-process
  private:
     bool _file_ispipe {false};
     FILE* _file {nullptr};
     class Implementation;
     unique_ptr<Implementation> _impl;
+    unique_ptr<std::ostream> _gzstream;
     std::ostream* _os {nullptr};
 };
 
@@ -78,6 +83,18 @@ class TmpFile : noncopyable {
     string _filename;
 };
 
+// Read-only memory mapping of an entire (uncompressed) file, whose pages are loaded on demand.
+class MappedFile : noncopyable {
+ public:
+    explicit MappedFile(const string& filename); // throws std::runtime_error if the file cannot be opened
+    ~MappedFile();
+    const char* data() const                    { return _data; } // nullptr if the file is empty
+    size_t size() const                         { return _size; }
+ private:
+    const char* _data {nullptr};
+    size_t _size {0};
+};
+
 // For sh/csh argument.
 string quote_arg_for_sh(const string& s);
 
@@ -5,11 +5,16 @@
 #include <cstdlib>              // atoi()
 #include <cstring>              // strncmp(), strlen(), std::memmove(), etc.
 #include <cctype>               // std::isalnum()
+#include <sstream>              // std::ostringstream, std::istringstream
 
 #include "Polygon.h"
 #include "A3dStream.h"
 #include "Array.h"
 #include "Set.h"
+#include "Map.h"
+#include "BinaryIO.h"           // read_binary_std(), write_binary_std()
+#include "TextParse.h"          // TextLines, parse_float()
+#include "Parallel.h"           // parallel_for_each()
 
 namespace hh {
 
@@ -339,13 +344,443 @@ void GMesh::update_string(Corner c, const char* key, const char* val) {
 
 // I/O
 
+// *** Binary format (see GMesh.h)
+
+namespace {
+
+const string k_binary_mesh_header = "BinaryMesh";
+
+struct BinaryAttrib { const char* key; int dim; }; // dim==0 for an integer
+const BinaryAttrib k_binary_attribs[] = { {"normal", 3}, {"rgb", 3}, {"uv", 2}, {"wid", 0} };
+constexpr int k_num_binary_attribs = int(sizeof(k_binary_attribs)/sizeof(k_binary_attribs[0]));
+
+// The info strings of one kind of element (vertex, face, or corner), split into typed attributes and remainders.
+struct BinaryInfo {
+    explicit BinaryInfo(int pn) : n(pn), present(k_num_binary_attribs), fvalues(k_num_binary_attribs),
+                                  ivalues(k_num_binary_attribs) { }
+    int n;                            // number of elements
+    Array<Array<uchar>> present;      // [attrib][element] (empty if no element has the attribute)
+    Array<Array<float>> fvalues;      // [attrib][ipresent*dim+c]
+    Array<Array<int>> ivalues;        // [attrib][ipresent]
+    Array<int> rindex;                // elements with a remaining string, in increasing order
+    Array<string> rstring;
+    struct Cursor { Vec<int,k_num_binary_attribs> ia {ntimes<k_num_binary_attribs>(0)}; int irest {0}; };
+    // Record the info string s of element i.
+    void enter(int i, const char* s);
+    // Reconstruct into str the info string of element i; elements must be visited in increasing order.
+    void compose(int i, Cursor& cursor, string& str) const;
+    void write(std::ostream& os, int kind, int& nsections) const;
+    void read_section(std::istream& is, int attrib);
+    void write_strings(std::ostream& os) const;
+    void read_strings(std::istream& is);
+};
+
+void BinaryInfo::enter(int i, const char* s) {
+    string sval, str;
+    int a = 0;                  // the attributes must appear in the order of k_binary_attribs
+    const char* srest = s;
+    for_cstring_key_value_ptr(s, [&](const char* kb, int kl, const char* vb, int vl) {
+        while (a<k_num_binary_attribs && !(!strncmp(k_binary_attribs[a].key, kb, kl) &&
+                                           !k_binary_attribs[a].key[kl]))
+            a++;
+        if (a==k_num_binary_attribs) return true;
+        const int dim = k_binary_attribs[a].dim;
+        sval.assign(vb, vl);
+        Vec3<float> vec; int ival = 0;
+        if (dim) {
+            if (!vl || vb[0]!='(') return true;
+            const char* p = vb+1;
+            for_int(c, dim) {
+                char* pend; vec[c] = std::strtof(p, &pend);
+                if (pend==p) return true;
+                p = pend;
+            }
+            if (csform_vec(str, vec.head(dim))!=sval) return true; // not reproducible exactly
+        } else {
+            char* pend; ival = int(std::strtol(sval.c_str(), &pend, 10));
+            if (csform(str, "%d", ival)!=sval) return true;
+        }
+        if (!present[a].num()) present[a].init(n, uchar{0});
+        present[a][i] = 1;
+        if (dim) fvalues[a].push_array(vec.head(dim)); else ivalues[a].push(ival);
+        a++;
+        srest = vb+vl; if (*srest==' ') srest++;
+        return false;
+    });
+    if (*srest) { rindex.push(i); rstring.push(srest); }
+}
+
+void BinaryInfo::compose(int i, Cursor& cursor, string& str) const {
+    str.clear();
+    string sval;
+    for_int(a, k_num_binary_attribs) {
+        if (!present[a].num() || !present[a][i]) continue;
+        const int dim = k_binary_attribs[a].dim, j = cursor.ia[a]++;
+        if (str.size()) str += ' ';
+        str += k_binary_attribs[a].key; str += '=';
+        str += dim ? csform_vec(sval, fvalues[a].slice(j*dim, (j+1)*dim)) : csform(sval, "%d", ivalues[a][j]);
+    }
+    if (cursor.irest<rindex.num() && rindex[cursor.irest]==i) {
+        if (str.size()) str += ' ';
+        str += rstring[cursor.irest++];
+    }
+}
+
+void BinaryInfo::write(std::ostream& os, int kind, int& nsections) const {
+    for_int(a, k_num_binary_attribs) {
+        if (!present[a].num()) continue;
+        const int dim = k_binary_attribs[a].dim;
+        const int npresent = dim ? fvalues[a].num()/dim : ivalues[a].num();
+        write_binary_std(os, V(a, kind, npresent).view());
+        if (npresent!=n) write_binary_raw(os, present[a]);
+        if (dim) write_binary_std(os, fvalues[a]); else write_binary_std(os, ivalues[a]);
+        nsections++;
+    }
+}
+
+void BinaryInfo::read_section(std::istream& is, int a) {
+    assertx(a>=0 && a<k_num_binary_attribs);
+    assertx(!present[a].num());
+    const int dim = k_binary_attribs[a].dim;
+    int npresent; assertx(read_binary_std(is, ArView(npresent)));
+    present[a].init(n, uchar{1});
+    if (npresent!=n) assertx(read_binary_raw(is, present[a]));
+    if (dim) {
+        fvalues[a].init(npresent*dim); assertx(read_binary_std(is, fvalues[a]));
+    } else {
+        ivalues[a].init(npresent); assertx(read_binary_std(is, ivalues[a]));
+    }
+}
+
+void BinaryInfo::write_strings(std::ostream& os) const {
+    write_binary_std(os, ArView(rindex.num()));
+    for_int(j, rindex.num()) {
+        write_binary_std(os, V(rindex[j], int(rstring[j].size())).view());
+        os.write(rstring[j].data(), rstring[j].size());
+    }
+}
+
+void BinaryInfo::read_strings(std::istream& is) {
+    int nstrings; assertx(read_binary_std(is, ArView(nstrings)));
+    rindex.init(nstrings); rstring.init(nstrings);
+    for_int(j, nstrings) {
+        Vec2<int> buf; assertx(read_binary_std(is, buf.view()));
+        rindex[j] = buf[0];
+        rstring[j].resize(buf[1]);
+        assertx(is.read(&rstring[j][0], buf[1]));
+    }
+}
+
+} // namespace
+
+void GMesh::write_binary(std::ostream& os) const {
+    const int nv = num_vertices(), nf = num_faces();
+    Map<Vertex,int> mvi;
+    Array<Vertex> va; va.reserve(nv);
+    Array<int> vids; vids.reserve(nv);
+    Array<float> points; points.reserve(nv*3);
+    for (Vertex v : ordered_vertices()) {
+        mvi.enter(v, va.num());
+        va.push(v);
+        vids.push(vertex_id(v));
+        points.push_array(point(v).view());
+    }
+    Array<Face> fa; fa.reserve(nf);
+    Array<int> fids; fids.reserve(nf);
+    Array<int> fnv; fnv.reserve(nf);
+    Array<int> fverts; fverts.reserve(nf*3);
+    for (Face f : ordered_faces()) {
+        fa.push(f);
+        fids.push(face_id(f));
+        int nfv0 = fverts.num();
+        for (Vertex v : vertices(f)) fverts.push(mvi.get(v));
+        fnv.push(fverts.num()-nfv0);
+    }
+    const int nfv = fverts.num();
+    BinaryInfo vinfo(nv), finfo(nf), cinfo(nfv);
+    for_int(i, nv) {
+        const char* s = get_string(va[i]);
+        if (s) vinfo.enter(i, s);
+    }
+    {
+        int k = 0;
+        for_int(i, nf) {
+            Face f = fa[i];
+            const char* s = get_string(f);
+            if (s) finfo.enter(i, s);
+            for (Vertex v : vertices(f)) {
+                const char* sc = get_string(corner(v, f));
+                if (sc) cinfo.enter(k, sc);
+                k++;
+            }
+        }
+    }
+    bool has_vids = false; for_int(i, nv) { if (vids[i]!=i+1) { has_vids = true; break; } }
+    bool has_fids = false; for_int(i, nf) { if (fids[i]!=i+1) { has_fids = true; break; } }
+    std::ostringstream oss;     // typed sections, which are counted in the header
+    int nsections = 0;
+    vinfo.write(oss, 0, nsections); finfo.write(oss, 1, nsections); cinfo.write(oss, 2, nsections);
+    os << k_binary_mesh_header << "\n";
+    os << sform("version=1 nvertices=%d nfaces=%d nfacevertices=%d vertexids=%d faceids=%d nsections=%d\n",
+                nv, nf, nfv, has_vids, has_fids, nsections);
+    if (has_vids) write_binary_std(os, vids);
+    write_binary_std(os, points);
+    if (has_fids) write_binary_std(os, fids);
+    if (nfv!=nf*3) write_binary_std(os, fnv);
+    write_binary_std(os, fverts);
+    os << oss.str();
+    vinfo.write_strings(os); finfo.write_strings(os); cinfo.write_strings(os);
+    {
+        Array<int> eints; string estrings;
+        for (Edge e : edges()) {
+            const char* s = get_string(e);
+            if (!s) continue;
+            eints.push_array(V(mvi.get(vertex1(e)), mvi.get(vertex2(e)), int(strlen(s))).view());
+            estrings += s;
+        }
+        write_binary_std(os, ArView(eints.num()/3));
+        const char* p = estrings.data();
+        for (int j = 0; j<eints.num(); j += 3) {
+            write_binary_std(os, eints.slice(j, j+3));
+            os.write(p, eints[j+2]); p += eints[j+2];
+        }
+    }
+    assertx(os);
+}
+
+void GMesh::read_binary(std::istream& is) {
+    string sline; assertx(my_getline(is, sline));
+    int version, nv, nf, nfv, has_vids, has_fids, nsections;
+    if (sscanf(sline.c_str(), "version=%d nvertices=%d nfaces=%d nfacevertices=%d vertexids=%d faceids=%d nsections=%d",
+               &version, &nv, &nf, &nfv, &has_vids, &has_fids, &nsections)!=7) {
+        SHOW(sline); assertnever("Cannot parse BinaryMesh header");
+    }
+    if (version!=1) { SHOW(version); assertnever("Unsupported BinaryMesh version"); }
+    Array<int> vids(has_vids ? nv : 0); assertx(read_binary_std(is, vids));
+    Array<float> points(nv*3); assertx(read_binary_std(is, points));
+    Array<int> fids(has_fids ? nf : 0); assertx(read_binary_std(is, fids));
+    Array<int> fnv(nfv!=nf*3 ? nf : 0); assertx(read_binary_std(is, fnv));
+    Array<int> fverts(nfv); assertx(read_binary_std(is, fverts));
+    BinaryInfo vinfo(nv), finfo(nf), cinfo(nfv);
+    for_int(isection, nsections) {
+        Vec2<int> buf; assertx(read_binary_std(is, buf.view()));
+        assertx(buf[1]>=0 && buf[1]<3);
+        BinaryInfo& info = buf[1]==0 ? vinfo : buf[1]==1 ? finfo : cinfo;
+        info.read_section(is, buf[0]);
+    }
+    vinfo.read_strings(is); finfo.read_strings(is); cinfo.read_strings(is);
+    string str;
+    Array<Vertex> va(nv);
+    {
+        BinaryInfo::Cursor cursor;
+        for_int(i, nv) {
+            Vertex v = create_vertex_private(has_vids ? vids[i] : i+1);
+            set_point(v, Point(points[i*3+0], points[i*3+1], points[i*3+2]));
+            vinfo.compose(i, cursor, str);
+            if (str.size()) {
+                set_string(v, str.c_str());
+                if (string_has_key(str.c_str(), "cusp")) flags(v).flag(vflag_cusp) = true;
+            }
+            va[i] = v;
+        }
+    }
+    {
+        BinaryInfo::Cursor fcursor, ccursor;
+        PArray<Vertex,6> fva;
+        int k = 0;
+        for_int(i, nf) {
+            const int n = fnv.num() ? fnv[i] : 3;
+            fva.init(n);
+            for_int(j, n) { fva[j] = va[fverts[k+j]]; }
+            Face f = create_face_private(has_fids ? fids[i] : i+1, fva);
+            finfo.compose(i, fcursor, str);
+            if (str.size()) set_string(f, str.c_str());
+            for_int(j, n) {
+                cinfo.compose(k+j, ccursor, str);
+                if (str.size()) set_string(corner(fva[j], f), str.c_str());
+            }
+            k += n;
+        }
+        assertx(k==nfv);
+    }
+    int nestrings; assertx(read_binary_std(is, ArView(nestrings)));
+    for_int(j, nestrings) {
+        Vec3<int> buf; assertx(read_binary_std(is, buf.view()));
+        str.resize(buf[2]); assertx(is.read(&str[0], buf[2]));
+        Edge e = query_edge(va[buf[0]], va[buf[1]]);
+        if (!e) { Warning("GMesh::read(): Did not find edge in mesh"); continue; }
+        set_string(e, str.c_str());
+        flags(e).flag(eflag_sharp) = string_has_key(str.c_str(), "sharp");
+    }
+}
+
+namespace {
+
+// Records of a chunk of text lines, parsed concurrently by GMesh::read().
+struct ParsedLines {
+    Array<char> types;          // per line: 'V', 'F', 'C', '#', or 0 if the line is left to GMesh::read_line()
+    Array<int> ints;            // 'V': id;  'F': id, nv, vertex ids;  'C': vertex id, face id
+    Array<float> floats;        // 'V': point
+    Array<unique_ptr<char[]>> infos; // 'V', 'F', 'C': contents of "{...}", or nullptr
+    Array<Vertex> fvertices;    // 'F': vertices, if resolved concurrently
+    bool faces_only {true};     // all lines are 'F' or '#'
+};
+
+// Parse the optional "{...}" at the end of a record; return false if the line should be left to read_line().
+bool parse_info(const char* s, const char* end, unique_ptr<char[]>& info) {
+    while (*s==' ' || *s=='\t') s++;
+    if (s==end) return true;
+    if (*s!='{') return false;
+    const char* send = static_cast<const char*>(std::memchr(s+1, '}', end-(s+1)));
+    if (!send) return false;
+    info = make_unique<char[]>(send-s);
+    std::memcpy(info.get(), s+1, send-(s+1)); info[send-(s+1)] = 0;
+    return true;
+}
+
+// Parse a "Vertex", "Face", or "Corner" record, whose results are appended to pl; return its type or 0.
+char parse_record(const char* s, const char* end, ParsedLines& pl) {
+    const int nints = pl.ints.num();
+    unique_ptr<char[]> info;
+    if (s[0]=='#') return '#';
+    if (s[0]=='V' && !strncmp(s, "Vertex ", 7)) {
+        s += 7;
+        int vi; Vec3<float> p;
+        if (!parse_int(s, vi) || !parse_float(s, p[0]) || !parse_float(s, p[1]) || !parse_float(s, p[2]) ||
+            !parse_info(s, end, info))
+            return 0;
+        pl.ints.push(vi); pl.floats.push_array(p.view()); pl.infos.push(std::move(info));
+        return 'V';
+    } else if (s[0]=='F' && !strncmp(s, "Face ", 5)) {
+        s += 5;
+        pl.ints.push_array(V(0, 0).view());
+        for (;;) {              // as in read_line(), ids are only digits
+            while (*s==' ' || *s=='\t') s++;
+            if (s==end || *s=='{') break;
+            int j;
+            if (!(*s>='0' && *s<='9') || !parse_int(s, j)) { pl.ints.resize(nints); return 0; }
+            pl.ints.push(j);
+        }
+        const int nv = pl.ints.num()-nints-3;
+        if (nv<3 || !parse_info(s, end, info)) { pl.ints.resize(nints); return 0; }
+        pl.ints[nints+0] = pl.ints[nints+2]; pl.ints[nints+1] = nv;
+        for_int(j, nv) { pl.ints[nints+2+j] = pl.ints[nints+3+j]; }
+        pl.ints.sub(1);
+        pl.infos.push(std::move(info));
+        return 'F';
+    } else if (s[0]=='C' && !strncmp(s, "Corner ", 7)) {
+        s += 7;
+        int vi, fi;
+        if (!parse_int(s, vi) || !parse_int(s, fi) || !parse_info(s, end, info)) return 0;
+        pl.ints.push_array(V(vi, fi).view()); pl.infos.push(std::move(info));
+        return 'C';
+    }
+    return 0;
+}
+
+void parse_lines(const TextLines& lines, int ichunk, ParsedLines& pl) {
+    for (int i : lines.chunk_lines(ichunk)) {
+        char type = parse_record(lines.line(i), lines.line_end(i), pl);
+        pl.types.push(type);
+        if (type!='F' && type!='#') pl.faces_only = false;
+    }
+}
+
+} // namespace
+
 void GMesh::read(std::istream& is) {
-    for (string sline; my_getline(is, sline); ) {
-        read_line(const_cast<char*>(sline.c_str()));
+    // A binary mesh (possibly after comments) is read directly from the stream rather than into a TextLines buffer.
+    for (string sline; is.peek()=='#' || is.peek()=='B'; ) {
+        assertx(my_getline(is, sline));
+        if (sline==k_binary_mesh_header) read_binary(is); else read_line(&sline[0]);
     }
+    read_lines(TextLines(is));
     if (sdebug>=1) ok();
 }
 
+void GMesh::read_lines(const TextLines& lines) {
+    // Lines are parsed concurrently in chunks; mesh elements are then created in file order.
+    const int nchunks = lines.num_chunks();
+    Array<ParsedLines> chunks(nchunks);
+    parallel_for_each(range(nchunks), [&](const int ichunk) {
+        parse_lines(lines, ichunk, chunks[ichunk]);
+    }, TextLines::k_chunk_cycles);
+    PArray<Vertex,6> va;
+    string sline;
+    for (int ichunk = 0; ichunk<nchunks; ) {
+        // Face vertices in a run of chunks with only faces are looked up concurrently, as no vertices are created.
+        int iend = ichunk;
+        while (iend<nchunks && chunks[iend].faces_only) iend++;
+        parallel_for_each(range(ichunk, iend), [&](const int i) {
+            ParsedLines& pl = chunks[i];
+            pl.fvertices.init(pl.ints.num());
+            for (int k = 0; k<pl.ints.num(); k += 2+pl.ints[k+1]) {
+                for_int(j, pl.ints[k+1]) { pl.fvertices[k+2+j] = id_retrieve_vertex(pl.ints[k+2+j]); }
+            }
+        }, TextLines::k_chunk_cycles/4);
+        for (iend = max(iend, ichunk+1); ichunk<iend; ichunk++) {
+            ParsedLines& pl = chunks[ichunk];
+            const bool resolved = pl.fvertices.num()>0;
+            int ii = 0, iff = 0, iinfo = 0;
+            auto lb = lines.chunk_lines(ichunk).begin();
+            for_int(il, pl.types.num()) {
+                const int i = lb[il];
+                switch (pl.types[il]) {
+                 case '#': continue;
+                 case 'V': {
+                     Vertex v = create_vertex_private(pl.ints[ii++]);
+                     set_point(v, Point(pl.floats[iff+0], pl.floats[iff+1], pl.floats[iff+2])); iff += 3;
+                     unique_ptr<char[]>& info = pl.infos[iinfo++];
+                     if (info) {
+                         if (string_has_key(info.get(), "cusp")) flags(v).flag(vflag_cusp) = true;
+                         set_string(v, std::move(info));
+                     }
+                     continue;
+                 }
+                 case 'F': {
+                     const int fi = pl.ints[ii], nv = pl.ints[ii+1];
+                     va.init(nv);
+                     bool ok = true;
+                     for_int(j, nv) {
+                         va[j] = resolved ? pl.fvertices[ii+2+j] : id_retrieve_vertex(pl.ints[ii+2+j]);
+                         if (!va[j]) ok = false;
+                     }
+                     ii += 2+nv;
+                     unique_ptr<char[]>& info = pl.infos[iinfo++];
+                     if (!ok || !legal_create_face(va)) break; // let read_line() report the problem
+                     Face f = fi ? create_face_private(fi, va) : create_face(va);
+                     if (info) set_string(f, std::move(info));
+                     continue;
+                 }
+                 case 'C': {
+                     Vertex v = id_retrieve_vertex(pl.ints[ii]);
+                     Face f = id_retrieve_face(pl.ints[ii+1]);
+                     ii += 2;
+                     unique_ptr<char[]>& info = pl.infos[iinfo++];
+                     if (!v || !f) break;
+                     Corner c = corner(v, f);
+                     if (info) set_string(c, std::move(info));
+                     continue;
+                 }
+                 case 0:
+                     if (lines.line_end(i)-lines.line(i)==int(k_binary_mesh_header.size()) &&
+                         !strncmp(lines.line(i), k_binary_mesh_header.c_str(), k_binary_mesh_header.size())) {
+                         std::istringstream iss(lines.buffer().substr(lines.line_offset(i+1)));
+                         read_binary(iss);
+                         read(iss); // any records after the binary mesh
+                         return;
+                     }
+                     break;
+                 default: assertnever("");
+                }
+                sline = lines.line_string(i);
+                read_line(&sline[0]);
+            }
+            pl = ParsedLines();
+        }
+    }
+}
+
 void GMesh::read_line(char* sline) {
     if (sline[0]=='#') return;
     char* sinfo = const_cast<char*>(str_chr(sline, '{'));
@@ -469,6 +904,14 @@ bool GMesh::recognize_line(const char* s) {
 }
 
 void GMesh::write(std::ostream& os) const {
+    write(os, getenv_bool("MESH_BINARY"));
+}
+
+void GMesh::write(std::ostream& os, bool binary) const {
+    if (binary) write_binary(os); else write_text(os);
+}
+
+void GMesh::write_text(std::ostream& os) const {
     for (Vertex v : ordered_vertices()) {
         const Point& p = point(v);
         os << "Vertex " << vertex_id(v) << "  " << p[0] << " " << p[1] << " " << p[2];
@@ -21,7 +21,7 @@ namespace hh {
 
 // *** See documentation on MESH FILE FORMAT at the end of this file.
 
-class WA3dStream; class A3dElem; struct A3dVertexColor;
+class WA3dStream; class A3dElem; struct A3dVertexColor; class TextLines;
 
 // Corner data is currently not handled
 
@@ -88,10 +88,13 @@ class GMesh : public Mesh {
     void update_string(Corner c, const char* key, const char* val);
     static void update_string_ptr(unique_ptr<char[]>& ss, const char* key, const char* val);
 // Standard I/O for my meshes (see format below)
-    void read(std::istream& is); // read a whole mesh, discard comments
+    void read(std::istream& is); // read a whole mesh (text or binary format), discard comments
     void read_line(char* s);     // no '\n' required
     static bool recognize_line(const char* s);
-    void write(std::ostream& os) const;
+    void write(std::ostream& os) const; // binary format if getenv_bool("MESH_BINARY")
+    void write(std::ostream& os, bool binary) const;
+    void write_text(std::ostream& os) const;
+    void write_binary(std::ostream& os) const;
     void write(WA3dStream& oa3d, const A3dVertexColor& col) const;
     void write_face(WA3dStream& oa3d, A3dElem& el, const A3dVertexColor& col, Face f) const;
     std::ostream* record_changes(std::ostream* pos); // pos may be nullptr, ret old
@@ -105,6 +108,8 @@ class GMesh : public Mesh {
 // Misc
     friend void swap(GMesh& l, GMesh& r) noexcept;
  private:
+    void read_binary(std::istream& is); // after the "BinaryMesh" line
+    void read_lines(const TextLines& lines);
     std::ostream* _os {nullptr}; // for record_changes
     mutable Polygon _tmp_poly;
 };
@@ -224,6 +229,26 @@ void for_cstring_key_value(const char* str, Array<char>& key, Array<char>& val,
 /// Corner 3 1 {normal=(1 0 0) uv=(0.5 0.5)}
 /// Corner 3 2 {normal=(0 1 0) uv=(0 0.5)}
 ///
+/// BINARY MESH FORMAT
+///
+/// A line "BinaryMesh" (possibly preceded by comment lines), a line
+/// "version=1 nvertices=nv nfaces=nf nfacevertices=nfv vertexids=b faceids=b nsections=ns",
+/// and then binary data in network byte order:
+///  - int[nv] vertex ids (if vertexids=1, else the ids are 1..nv)
+///  - float[nv][3] vertex positions
+///  - int[nf] face ids (if faceids=1, else the ids are 1..nf)
+///  - int[nf] face valences (if nfv!=3*nf)
+///  - int[nfv] face vertices, as 0-based indices into the vertex list
+///  - ns typed attribute sections, each:
+///     int attrib (0=normal 1=rgb 2=uv 3=wid), int element (0=vertex 1=face 2=corner), int npresent,
+///     uchar[nelements] presence (if npresent!=nelements), float[npresent][dim] or int[npresent] (wid)
+///  - for vertices, faces, and corners: int n, then n x {int index, int len, char[len] remaining info string}
+///  - for edges: int n, then n x {int vertexindex1, int vertexindex2, int len, char[len] info string}
+/// Corners are numbered by their position in the face vertex list.
+/// Typed sections hold the leading attributes of each info string (in the above order) whose
+///  text is reproduced exactly by "%g"/"%d" formatting; the rest of the string is stored verbatim.
+/// Hence a mesh written in binary and read back writes exactly the same text as the original.
+///
 /// (For exact specifications, refer to GMesh.cpp)
 
 } // namespace hh
@@ -34,6 +34,7 @@
 // #define WIN32_LEAN_AND_MEAN // must omit to include CommandLineToArgvW()
 #include <windows.h>              // QueryPerformanceCounter(), QueryPerformanceFrequency()
 #include <shellapi.h>             // CommandLineToArgvW()
+#include <psapi.h>                // PROCESS_MEMORY_COUNTERS, K32GetProcessMemoryInfo() (in kernel32)
 HH_REFERENCE_LIB("advapi32.lib"); // for GetUserName() here and in StackWalker
 HH_REFERENCE_LIB("shell32.lib");  // CommandLineToArgvW()
 
@@ -45,6 +46,7 @@ HH_REFERENCE_LIB("shell32.lib");  // CommandLineToArgvW()
 #if !defined(__APPLE__)
 #include <sys/sysinfo.h>        // struct sysinfo, sysinfo()
 #endif
+#include <sys/resource.h>      // getrusage()
 
 #endif  // defined(_WIN32)
 
@@ -818,7 +820,10 @@ class Warnings {
  public:
     Warnings()                                  { }
     ~Warnings()                                 { flush(); }
-    int increment_count(const char* s)          { return ++_m[s]; }
+    int increment_count(const char* s) {        // may be called from parallel threads
+        std::lock_guard<std::mutex> lock(_mutex);
+        return ++_m[s];
+    }
     void flush() {
         if (_m.empty()) return;
         struct ltstr {              // lexicographic comparison; deterministic, unlike pointer comparison
@@ -836,6 +841,7 @@ class Warnings {
     }
  private:
     std::unordered_map<const void*, int> _m; // warning char* -> number of times printed
+    std::mutex _mutex;
 };
 
 class Warnings_init {
@@ -1070,6 +1076,22 @@ size_t available_memory() {
     // if all fails, return 0;
 }
 
+size_t peak_memory_usage() {
+#if defined(_WIN32)
+    PROCESS_MEMORY_COUNTERS counters;
+    if (!K32GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters))) return 0;
+    return counters.PeakWorkingSetSize;
+#else
+    struct rusage usage;
+    if (getrusage(RUSAGE_SELF, &usage)) return 0;
+#if defined(__APPLE__)
+    return size_t(usage.ru_maxrss);       // in bytes
+#else
+    return size_t(usage.ru_maxrss)*1024;  // in kilobytes
+#endif
+#endif
+}
+
 string get_user_name() {
 #if defined(_WIN32)
     {
@@ -551,6 +551,9 @@ void my_sleep(double sec);
 // Get number of bytes of available memory (min of free virtual and physical space), or 0 if unavailable.
 size_t available_memory();
 
+// Get peak number of bytes of physical memory used by this process (peak resident set size), or 0 if unavailable.
+size_t peak_memory_usage();
+
 // Return user login name.
 string get_user_name();
 
@@ -1126,7 +1126,7 @@ void ImageIO::write_png(const Image& image, FILE* file) {
 using namespace details;
 
 void Image::read_file_IO(const string& filename, bool bgra) {
-    RFile fi(filename);
+    RFile fi(filename, true);
     FILE* file = fi.cfile();
     int c = getc(file);
     if (c<0) throw std::runtime_error("empty image file '" + filename + "'");
@@ -1153,7 +1153,7 @@ void Image::write_file_IO(const string& filename, bool bgra) const {
     }
     if (suffix()=="")
         throw std::runtime_error("Image '" + filename + "': no filename suffix specified for writing");
-    WFile fi(filename);
+    WFile fi(filename, true);
     FILE* file = fi.cfile();
     const ImageFiletype* filetype = nullptr;
     for (auto& imagefiletype : k_image_filetypes) {
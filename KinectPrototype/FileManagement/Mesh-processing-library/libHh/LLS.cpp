@@ -6,6 +6,7 @@
 #include "Stat.h"
 #include "SingularValueDecomposition.h"
 #include "MatrixOp.h"           // mat_mul()
+#include "Parallel.h"           // parallel_for_each()
 
 #if !defined(HH_NO_LAPACK)
 #include "my_lapack.h"
@@ -84,15 +85,26 @@ void LLS::get_x(MatrixView<float> mat) {
 
 // *** SparseLLS
 
+SparseLLS::SparseLLS(int m, int n, int nd) : LLS(m, n, nd), _tolerance(square(8e-7f)*m) {
+    static const bool pcg = getenv_bool("SPARSE_LLS_PCG");
+    set_preconditioned(pcg);
+}
+
 void SparseLLS::clear() {
     _rows.clear();
     _cols.clear();
+    _entries.clear();
     LLS::clear();
 }
 
 void SparseLLS::enter_a_rc(int r, int c, float val) {
-    _rows[r].push(Ival(c, val));
-    _cols[c].push(Ival(r, val));
+    if (_preconditioned) {
+        ASSERTX(r>=0 && r<_m && c>=0 && c<_n);
+        _entries.push(Entry(r, c, val));
+    } else {
+        _rows[r].push(Ival(c, val));
+        _cols[c].push(Ival(r, val));
+    }
     _nentries++;
 }
 
@@ -128,7 +140,7 @@ Array<float> SparseLLS::mult_mt_v(CArrayView<float> vi) const {
     return vo;
 }
 
-bool SparseLLS::do_cg(Array<float>& x, CArrayView<float> h, double* prssb, double* prssa) const {
+bool SparseLLS::do_cg(Array<float>& x, CArrayView<float> h, double* prssb, double* prssa) {
     // x(_n), h(_m)
     Array<float> rc, gc, gp, dc, tc;
     rc = mult_m_v(x);
@@ -161,6 +173,7 @@ bool SparseLLS::do_cg(Array<float>& x, CArrayView<float> h, double* prssb, doubl
         for_int(i, _n) gc[i] = -gc[i];
     }
     double rssa = mag2(rc);
+    _niter = max(_niter, k);
     // Print final gradient norm squared and final residual norm squared.
     if (sdebug || _verb)
         showf("CG: %d iter (gm2=%.10g, rssb=%.10g, rssa=%.10g)\n", k, gm2, rssb, rssa);
@@ -175,6 +188,8 @@ bool SparseLLS::solve(double* prssb, double* prssa) {
     if (sdebug) showf("SparseLLS: solving %dx%d system, nonzerofrac=%f\n", _m, _n, float(_nentries)/_m/_n);
     if (prssb) *prssb = 0.;
     if (prssa) *prssa = 0.;
+    _niter = 0;
+    if (_preconditioned) return solve_pcg(prssb, prssa);
     Array<float> x(_n), rhv(_m);
     bool success = true;
     for_int(di, _nd) {
@@ -201,6 +216,149 @@ void SparseLLS::set_verbose(int verb) {
     _verb = verb;
 }
 
+void SparseLLS::set_preconditioned(bool b) {
+    assertx(!_nentries);
+    _preconditioned = b;
+    if (_preconditioned) {
+        _rows.clear(); _cols.clear();
+    } else {
+        _rows.init(_m); _cols.init(_n);
+    }
+}
+
+namespace {
+
+// Vectors hold nd interleaved columns: v[i*nd+d].  Work is divided into chunks of a fixed number of rows, so that
+//  reductions are summed in the same order regardless of the number of threads.
+constexpr int k_pcg_chunk = 4096;
+
+int num_chunks(int n) { return (n+k_pcg_chunk-1)/k_pcg_chunk; }
+
+// Compressed sparse rows.
+struct CsrMatrix {
+    Array<int> beg;             // first entry of each row; size nrows+1
+    Array<int> ind;             // column index of each entry
+    Array<float> val;
+};
+
+// Multiply the csr matrix by the nd interleaved vectors in vi.
+void csr_mult(const CsrMatrix& csr, int nd, CArrayView<double> vi, ArrayView<double> vo) {
+    const int nrows = csr.beg.num()-1;
+    const uint64_t cycles = k_pcg_chunk*uint64_t(nd)*(2+2*csr.ind.num()/max(nrows, 1));
+    parallel_for_each(range(num_chunks(nrows)), [&](const int ichunk) {
+        for_intL(i, ichunk*k_pcg_chunk, min((ichunk+1)*k_pcg_chunk, nrows)) {
+            double* po = &vo[i*nd];
+            for_int(d, nd) { po[d] = 0.; }
+            for_intL(k, csr.beg[i], csr.beg[i+1]) {
+                const double v = csr.val[k]; const double* pi = &vi[csr.ind[k]*nd];
+                for_int(d, nd) { po[d] += v*pi[d]; }
+            }
+        }
+    }, cycles);
+}
+
+// Per-column dot products of nd interleaved vectors of length n.
+Array<double> column_dots(int n, int nd, CArrayView<double> v1, CArrayView<double> v2) {
+    Matrix<double> partial(num_chunks(n), nd);
+    parallel_for_each(range(partial.ysize()), [&](const int ichunk) {
+        for_int(d, nd) { partial[ichunk][d] = 0.; }
+        for_intL(i, ichunk*k_pcg_chunk, min((ichunk+1)*k_pcg_chunk, n)) {
+            for_int(d, nd) { partial[ichunk][d] += v1[i*nd+d]*v2[i*nd+d]; }
+        }
+    }, k_pcg_chunk*uint64_t(nd)*2);
+    Array<double> sums(nd, 0.);
+    for_int(ichunk, partial.ysize()) { for_int(d, nd) { sums[d] += partial[ichunk][d]; } }
+    return sums;
+}
+
+// Apply func(i, d) to all elements of nd interleaved vectors of length n.
+template<typename Func> void for_each_element(int n, int nd, Func func) {
+    parallel_for_each(range(num_chunks(n)), [&](const int ichunk) {
+        for_intL(i, ichunk*k_pcg_chunk, min((ichunk+1)*k_pcg_chunk, n)) {
+            for_int(d, nd) { func(i*nd+d, d); }
+        }
+    }, k_pcg_chunk*uint64_t(nd)*2);
+}
+
+} // namespace
+
+bool SparseLLS::solve_pcg(double* prssb, double* prssa) {
+    const int m = _m, n = _n, nd = _nd;
+    CsrMatrix ma, mat;          // A and A^T
+    {
+        HH_PTIMER(__pcg_csr);
+        ma.beg.init(m+1, 0); mat.beg.init(n+1, 0);
+        for (const Entry& e : _entries) { ma.beg[e._r+1]++; mat.beg[e._c+1]++; }
+        for_int(i, m) { ma.beg[i+1] += ma.beg[i]; }
+        for_int(j, n) { mat.beg[j+1] += mat.beg[j]; }
+        ma.ind.init(_entries.num()); ma.val.init(_entries.num());
+        mat.ind.init(_entries.num()); mat.val.init(_entries.num());
+        Array<int> ma_next(ma.beg.head(m)), mat_next(mat.beg.head(n));
+        for (const Entry& e : _entries) {
+            int k = ma_next[e._r]++; ma.ind[k] = e._c; ma.val[k] = e._v;
+            k = mat_next[e._c]++; mat.ind[k] = e._r; mat.val[k] = e._v;
+        }
+        _entries.clear();       // solve() may destroy A
+    }
+    // Jacobi preconditioner: inverse of the diagonal of A^T*A.
+    Array<double> minv(n);
+    for_int(j, n) {
+        double sum = 0.; for_intL(k, mat.beg[j], mat.beg[j+1]) { sum += square(double(mat.val[k])); }
+        minv[j] = sum ? 1./sum : 1.;
+    }
+    Array<double> x(n*nd), r(m*nd), q(m*nd), s(n*nd), z(n*nd), p(n*nd);
+    for_int(j, n) { for_int(d, nd) { x[j*nd+d] = _x[d][j]; } }
+    csr_mult(ma, nd, x, q);
+    for_int(i, m) { for_int(d, nd) { r[i*nd+d] = _b[d][i]-q[i*nd+d]; } }
+    const Array<double> rssb = column_dots(m, nd, r, r);
+    csr_mult(mat, nd, r, s);    // s = A^T*r is the negated gradient
+    for_each_element(n, nd, [&](int k, int) { z[k] = minv[k/nd]*s[k]; p[k] = z[k]; });
+    Array<double> gamma = column_dots(n, nd, s, z), gm2 = column_dots(n, nd, s, s);
+    Array<int> niter(nd, -1);   // iteration at which column d stopped
+    Array<double> alpha(nd), beta(nd);
+    const int fudge_for_small_systems = 20;
+    const int kmax = n+fudge_for_small_systems;
+    for (int k = 0; ; k++) {
+        bool all_done = true;
+        for_int(d, nd) {
+            if (niter[d]<0 && (gm2[d]<_tolerance || k==_max_iter || k==kmax)) niter[d] = k;
+            if (niter[d]<0) all_done = false;
+        }
+        if (sdebug>=2) { showf("k=%-4d", k); for_int(d, nd) { showf(" gm2[%d]=%g", d, gm2[d]); } showf("\n"); }
+        if (all_done) break;
+        csr_mult(ma, nd, p, q);
+        const Array<double> qq = column_dots(m, nd, q, q);
+        for_int(d, nd) {
+            if (niter[d]<0 && !qq[d]) niter[d] = k; // search direction in null space of A
+            alpha[d] = niter[d]<0 ? gamma[d]/qq[d] : 0.;
+        }
+        for_each_element(n, nd, [&](int kk, int d) { x[kk] += alpha[d]*p[kk]; });
+        for_each_element(m, nd, [&](int kk, int d) { r[kk] -= alpha[d]*q[kk]; });
+        csr_mult(mat, nd, r, s);
+        for_each_element(n, nd, [&](int kk, int) { z[kk] = minv[kk/nd]*s[kk]; });
+        const Array<double> gamma_new = column_dots(n, nd, s, z);
+        gm2 = column_dots(n, nd, s, s);
+        for_int(d, nd) {
+            beta[d] = niter[d]<0 && gamma[d] ? gamma_new[d]/gamma[d] : 0.;
+            gamma[d] = gamma_new[d];
+        }
+        for_each_element(n, nd, [&](int kk, int d) { if (niter[d]<0) p[kk] = z[kk]+beta[d]*p[kk]; });
+    }
+    const Array<double> rssa = column_dots(m, nd, r, r);
+    for_int(j, n) { for_int(d, nd) { _x[d][j] = float(x[j*nd+d]); } }
+    bool success = true;
+    for_int(d, nd) {
+        _niter = max(_niter, niter[d]);
+        if (!(gm2[d]<_tolerance)) success = false;
+        // Print final gradient norm squared and final residual norm squared.
+        if (sdebug || _verb)
+            showf("PCG: %d iter (gm2=%.10g, rssb=%.10g, rssa=%.10g)\n", niter[d], gm2[d], rssb[d], rssa[d]);
+        if (prssb) *prssb += rssb[d];
+        if (prssa) *prssa += rssa[d];
+    }
+    return success;
+}
+
 // *** FullLLS
 
 void FullLLS::clear() {
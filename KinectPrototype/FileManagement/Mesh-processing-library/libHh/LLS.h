@@ -42,9 +42,12 @@ class LLS : noncopyable {
 };
 
 // Sparse conjugate-gradient approach.
+// In the preconditioned mode, A is stored in compressed sparse row (and column) arrays, and all nd right-hand sides
+//  are solved simultaneously using Jacobi-preconditioned conjugate gradients on the normal equations, with
+//  multithreaded matrix-vector products; the result does not depend on the number of threads.
 class SparseLLS : public LLS {
  public:
-    SparseLLS(int m, int n, int nd)             : LLS(m, n, nd), _rows(m), _cols(n), _tolerance(square(8e-7f)*m) { }
+    SparseLLS(int m, int n, int nd);
     void clear() override;
     void enter_a_rc(int r, int c, float val) override;
     void enter_a_r(int r, CArrayView<float> ar) override;
@@ -53,6 +56,8 @@ class SparseLLS : public LLS {
     void set_tolerance(float tolerance); // default square(8e-7)*m  (because x is float) (was 1e-10f)
     void set_max_iter(int max_iter);     // default INT_MAX
     void set_verbose(int verb);          // default 0
+    void set_preconditioned(bool b);     // default getenv_bool("SPARSE_LLS_PCG"); must precede enter_a*()
+    int num_iterations() const                  { return _niter; } // after solve(); maximum over the nd columns
  private:
     struct Ival {
         Ival()                                  = default;
@@ -60,15 +65,25 @@ class SparseLLS : public LLS {
         int _i;
         float _v;
     };
+    struct Entry {
+        Entry()                                 = default;
+        Entry(int r, int c, float v)            : _r(r), _c(c), _v(v) { }
+        int _r, _c;
+        float _v;
+    };
     Array<Array<Ival>> _rows;
     Array<Array<Ival>> _cols;
+    bool _preconditioned;
+    Array<Entry> _entries;      // if _preconditioned
     float _tolerance;
     int _max_iter {INT_MAX};
     int _verb {0};
     int _nentries {0};
+    int _niter {0};
     Array<float> mult_m_v(CArrayView<float> vi) const;
     Array<float> mult_mt_v(CArrayView<float> vi) const;
-    bool do_cg(Array<float>& x, CArrayView<float> h, double* prssb, double* prssa) const;
+    bool do_cg(Array<float>& x, CArrayView<float> h, double* prssb, double* prssa);
+    bool solve_pcg(double* prssb, double* prssa);
 };
 
 // Base class for full (non-sparse) approaches.
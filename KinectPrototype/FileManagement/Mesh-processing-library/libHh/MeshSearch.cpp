@@ -1,16 +1,37 @@
 // -*- C++ -*-  Copyright (c) Microsoft Corporation; see license.txt
 #include "MeshSearch.h"
 
+#include <cstring>              // std::memcpy()
+
 #include "Bbox.h"
-#include "Random.h"
 #include "Stat.h"
 #include "Timer.h"
 
 namespace hh {
 
+namespace {
+
+// Pseudorandom bits that depend only on the query point, so that search() uses no shared state (like Random::G)
+//  and its result does not depend on the order of concurrent searches.
+uint32_t point_bits(const Point& p) {
+    uint32_t h = 2166136261u;   // FNV-1a over the coordinates
+    for_int(c, 3) { uint32_t u; std::memcpy(&u, &p[c], sizeof(u)); h = (h^u)*16777619u; }
+    return h^(h>>15);
+}
+
+} // namespace
+
+void PolygonFaceSpatial::clear() {
+    ObjectSpatial::clear();
+    _polyfaces.clear();
+    _bvh_valid = false;
+}
+
 void PolygonFaceSpatial::enter(const PolygonFace* ppolyface) {
     const Polygon& opoly = ppolyface->poly;
     assertx(opoly.num()==3);
+    _polyfaces.push(ppolyface);
+    _bvh_valid = false;
     Polygon poly = opoly;
     Bbox bbox; poly.get_bbox(bbox);
     auto func_polygonface_in_bbox = [&](const Bbox& bb) -> bool {
@@ -43,6 +64,25 @@ bool PolygonFaceSpatial::first_along_segment(const Point& p1, const Point& p2,
     return foundint;
 }
 
+void PolygonFaceSpatial::build_bvh() {
+    Array<Vec3<Point>> triangles(_polyfaces.num());
+    for_int(i, _polyfaces.num()) {
+        const Polygon& poly = _polyfaces[i]->poly;
+        triangles[i] = V(poly[0], poly[1], poly[2]);
+    }
+    _bvh.build(triangles);
+    _bvh_valid = true;
+}
+
+bool PolygonFaceSpatial::first_along_segment_bvh(const Point& p1, const Point& p2,
+                                                 const PolygonFace*& ret_ppolyface, Point& ret_pint) const {
+    assertx(_bvh_valid);        // build_bvh() must be called after the last enter()
+    int i = _bvh.first_along_segment(p1, p2, ret_pint);
+    if (i<0) return false;
+    ret_ppolyface = _polyfaces[i];
+    return true;
+}
+
 
 MeshSearch::MeshSearch(const GMesh* mesh, bool allow_local_project)
     : _mesh(*assertx(mesh)), _allow_local_project(allow_local_project), _ar_polyface(_mesh.num_faces()) {
@@ -71,6 +111,7 @@ Face MeshSearch::search(const Point& p, Face hintf, Bary& bary, Point& clp, floa
     Polygon poly;
     if (_allow_local_project && hintf) {
         f = hintf;
+        const uint32_t bits = point_bits(p);
         int count = 0;
         for (;;) {
             _mesh.polygon(f, poly); assertx(poly.num()==3);
@@ -86,13 +127,13 @@ Face MeshSearch::search(const Point& p, Face hintf, Bary& bary, Point& clp, floa
             }
             if (side>=0) {
                 if (0) {        // slow: randomly choose ccw or clw
-                    side = mod3(side+1+(Random::G.unif()<0.5f));
+                    side = mod3(side+1+int((bits>>count)&1));
                 } else if (0) { // works: always choose ccw
                     side = mod3(side+1);
                 } else {        // fastest: jump across vertex
                     Vertex v = va[side];
                     int val = _mesh.degree(v);
-                    int nrot = ((val-1)/2)+(Random::G.unif()<0.5f);
+                    int nrot = ((val-1)/2)+int((bits>>count)&1);
                     for_int(i, nrot) {
                         f = _mesh.ccw_face(v, f);
                         if (!f) break; // failure
@@ -5,6 +5,7 @@
 #include "GMesh.h"
 #include "Spatial.h"
 #include "Facedistance.h"
+#include "TriangleBvh.h"
 
 #if 0
 {
@@ -48,14 +49,26 @@ struct polygonface_distance2 {
 } // namespace details
 
 // A spatial data structure over a collection of polygons (each associated with a Mesh Face).
+// Queries walk the uniform grid.  Optionally, build_bvh() builds a TriangleBvh over the same polygons, for faster
+//  segment queries on uneven triangle sizes (first_along_segment_bvh()); it must be rebuilt after any enter().
 class PolygonFaceSpatial :
         public ObjectSpatial<details::polygonface_approx_distance2, details::polygonface_distance2> {
  public:
     explicit PolygonFaceSpatial(int gn)         : ObjectSpatial(gn) { }
-    // clear() inherited from ObjectSpatial
+    void clear() override;
     void enter(const PolygonFace* polyface); // not copied, no ownership taken
+    // Walk the grid cells along the segment and stop at the first cells with an intersected polygon; its
+    //  intersection may lie beyond these cells, behind that of a polygon only present in later cells.
     bool first_along_segment(const Point& p1, const Point& p2,
                              const PolygonFace*& ret_ppolyface, Point& ret_pint) const;
+    void build_bvh();           // over the polygons entered so far
+    // Find the first polygon along the segment using the TriangleBvh; build_bvh() must follow the last enter().
+    bool first_along_segment_bvh(const Point& p1, const Point& p2,
+                                 const PolygonFace*& ret_ppolyface, Point& ret_pint) const;
+ private:
+    Array<const PolygonFace*> _polyfaces; // in order entered, indexed by the TriangleBvh
+    bool _bvh_valid {false};
+    TriangleBvh _bvh;
 };
 
 // Construct a spatial data structure from a mesh, to enable fast closest-point queries from arbitrary points.
@@ -66,7 +79,7 @@ class MeshSearch {
     MeshSearch(const GMesh* mesh, bool allow_local_project);
     void allow_internal_boundaries(bool b)      { _allow_internal_boundaries = b; }
     void allow_off_surface(bool b)              { _allow_off_surface = b; }
-    // search() is thread-safe (except for Random::G?)
+    // search() is thread-safe, and its result is independent of other concurrent searches.
     Face search(const Point& p, Face hintf, Bary& bary, Point& clp, float& d2) const;
     const GMesh& mesh() const                   { return _mesh; }
  private:
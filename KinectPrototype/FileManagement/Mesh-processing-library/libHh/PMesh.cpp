@@ -1,7 +1,8 @@
 // -*- C++ -*-  Copyright (c) Microsoft Corporation; see license.txt
 #include "PMesh.h"
 
-#include <cstring>              // strncmp() etc.
+#include <cstring>              // strncmp(), std::memcpy() etc.
+#include <sstream>              // std::istringstream
 
 #include "PArray.h"             // ar_pwedge
 #include "GMesh.h"              // in extract_gmesh()
@@ -9,6 +10,7 @@
 #include "HashTuple.h"          // std::hash<std::pair<...>>
 #include "BinaryIO.h"           // read_binary_std() and write_binary_std()
 #include "RangeOp.h"            // fill()
+#include "FileIO.h"             // MappedFile
 
 namespace hh {
 
@@ -61,6 +63,77 @@ constexpr int k_magic_first_byte = 0xFF;
 
 namespace {
 
+// Maximum number of floats in a Vsplit record.
+constexpr int k_max_vsplit_floats = 6+6*(3+3+2)+2;
+
+// Number of floats in the record of vspl, whose code and vlr_offset1 are known.
+int vsplit_num_floats(const Vsplit& vspl, const PMeshInfo& pminfo) {
+    int nwa = vspl.expected_wad_num(pminfo);
+    int bufn = 6+nwa*(3+pminfo._has_rgb*3+pminfo._has_uv*2)+2*pminfo._has_resid;
+    assertx(bufn<=k_max_vsplit_floats);
+    return bufn;
+}
+
+// Set the deltas and residuals of vspl from the floats in its record.
+void unpack_vsplit_floats(Vsplit& vspl, const float* buf, const PMeshInfo& pminfo) {
+    int nwa = vspl.expected_wad_num(pminfo);
+    const float* p = buf;
+    Vector& vlarge = vspl.vad_large.dpoint; for_int(c, 3) { vlarge[c] = *p++; }
+    Vector& vsmall = vspl.vad_small.dpoint; for_int(c, 3) { vsmall[c] = *p++; }
+    vspl.ar_wad.init(nwa);
+    for_int(i, nwa) {
+        Vector& nor = vspl.ar_wad[i].dnormal;
+        A3dColor& rgb = vspl.ar_wad[i].drgb;
+        UV& uv = vspl.ar_wad[i].duv;
+        if (1) {
+            for_int(c, 3) { nor[c] = *p++; }
+        }
+        if (pminfo._has_rgb) {
+            for_int(c, 3) { rgb[c] = *p++; }
+        } else {
+            fill(rgb, 0.f);
+        }
+        if (pminfo._has_uv) {
+            for_int(c, 2) { uv[c] = *p++; }
+        } else {
+            fill(uv, 0.f);
+        }
+    }
+    if (pminfo._has_resid) {
+        vspl.resid_uni = *p++;
+        vspl.resid_dir = *p++;
+    } else {
+        vspl.resid_uni = 0.f; vspl.resid_dir = 0.f;
+    }
+}
+
+// Like read_binary_std(), but from (possibly unaligned) memory.
+template<typename T> void decode_std(const char*& s, ArrayView<T> ar) {
+    std::memcpy(ar.data(), s, ar.num()*sizeof(T));
+    s += ar.num()*sizeof(T);
+    for_int(i, ar.num()) { from_std(&ar[i]); }
+}
+
+// The index appended by PMesh::write_indexed() is located using a footer at the end of the file:
+//  the int64_t size of the index (in network order), which immediately precedes it, followed by this string.
+const char k_index_magic[] = "PMindex\n";
+constexpr int k_index_footer_size = 8+8;
+
+// Find the index footer, ignoring any trailing '#' comment lines (e.g. timing output from the writing program).
+const char* find_index_footer(const char* data, size_t size) {
+    size_t end = size;
+    for (;;) {
+        if (end<k_index_footer_size) return nullptr;
+        if (!std::memcmp(data+end-8, k_index_magic, 8)) return data+end-k_index_footer_size;
+        if (data[end-1]!='\n') return nullptr;
+        size_t beg = end-1;
+        while (beg>0 && data[beg-1]!='\n') --beg;
+        if (data[beg]!='#') return nullptr;
+        end = beg;
+    }
+}
+
+
 inline void attrib_ok(PMWedgeAttrib& a) {
     float len2 = mag2(a.normal);
     // Normal could be all-zero from MeshSimplify,
@@ -349,44 +422,26 @@ void Vsplit::read(std::istream& is, const PMeshInfo& pminfo) {
     } else {
         fl_matid = 0; fr_matid = 0;
     }
-    const int max_nwa = 6;
-    int nwa = expected_wad_num(pminfo); ASSERTX(nwa<=max_nwa);
-    const int nrgb = pminfo._has_rgb*3 + pminfo._has_uv*2;
-    int wadlength = 3+nrgb;
-    Vec<float, 6+max_nwa*(3+3+2)+2> buf;
-    const int bufn = 6+nwa*wadlength+2*pminfo._has_resid;
-    assertx(bufn<=buf.num());
+    Vec<float, k_max_vsplit_floats> buf;
+    const int bufn = vsplit_num_floats(*this, pminfo);
     assertx(read_binary_std(is, buf.head(bufn)));
-    Vector& vlarge = vad_large.dpoint; for_int(c, 3) { vlarge[c] = buf[0+c]; }
-    Vector& vsmall = vad_small.dpoint; for_int(c, 3) { vsmall[c] = buf[3+c]; }
-    ar_wad.init(nwa);
-    for_int(i, nwa) {
-        int bufw = 6+i*wadlength;
-        Vector& nor = ar_wad[i].dnormal;
-        A3dColor& rgb = ar_wad[i].drgb;
-        UV& uv = ar_wad[i].duv;
-        float* p = &buf[bufw];
-        if (1) {
-            for_int(c, 3) { nor[c] = *p++; }
-        }
-        if (pminfo._has_rgb) {
-            for_int(c, 3) { rgb[c] = *p++; }
-        } else {
-            fill(rgb, 0.f);
-        }
-        if (pminfo._has_uv) {
-            for_int(c, 2) { uv[c] = *p++; }
-        } else {
-            fill(uv, 0.f);
-        }
-    }
-    if (pminfo._has_resid) {
-        float* p = &buf[6+nwa*wadlength+0];
-        resid_uni = *p++;
-        resid_dir = *p++;
+    unpack_vsplit_floats(*this, buf.data(), pminfo);
+}
+
+void Vsplit::read(const char*& s, const PMeshInfo& pminfo) {
+    decode_std(s, ArView(flclw));
+    decode_std(s, ArView(vlr_offset1));
+    decode_std(s, ArView(code));
+    if (code & (FLN_MASK | FRN_MASK)) {
+        decode_std(s, ArView(fl_matid));
+        decode_std(s, ArView(fr_matid));
     } else {
-        resid_uni = 0.f; resid_dir = 0.f;
+        fl_matid = 0; fr_matid = 0;
     }
+    Vec<float, k_max_vsplit_floats> buf;
+    const int bufn = vsplit_num_floats(*this, pminfo);
+    decode_std(s, buf.head(bufn));
+    unpack_vsplit_floats(*this, buf.data(), pminfo);
 }
 
 void Vsplit::write(std::ostream& os, const PMeshInfo& pminfo) const {
@@ -410,6 +465,12 @@ void Vsplit::write(std::ostream& os, const PMeshInfo& pminfo) const {
     }
 }
 
+int Vsplit::num_bytes(const PMeshInfo& pminfo) const {
+    int n = sizeof(flclw)+sizeof(vlr_offset1)+sizeof(code);
+    if (code & (FLN_MASK | FRN_MASK)) n += sizeof(fl_matid)+sizeof(fr_matid);
+    return n+vsplit_num_floats(*this, pminfo)*int(sizeof(float));
+}
+
 void Vsplit::ok() const {
     // assertx(ar_wad.num()==expected_wad_num(now_missing_pminfo));
 }
@@ -1406,6 +1467,46 @@ void PMesh::read(std::istream& is) {
 }
 
 void PMesh::write(std::ostream& os) const {
+    write_header_and_base(os);
+    for_int(i, _vsplits.num()) {
+        _vsplits[i].write(os, _info);
+    }
+    os << '\xFF';
+    os << "End of PM\n";
+    assertx(os);
+}
+
+void PMesh::write_indexed(std::ostream& os, int block_size) const {
+    assertx(block_size>0);
+    write_header_and_base(os);
+    // All offsets are relative positions, as the stream may contain a prefix (e.g. '#' comment lines).
+    int64_t offset = 0;         // relative to the first vsplit record
+    int stride = _vsplits.num() ? _vsplits[0].num_bytes(_info) : 0;
+    Array<int64_t> block_offsets;
+    for_int(i, _vsplits.num()) {
+        if (i%block_size==0) block_offsets.push(offset);
+        int nbytes = _vsplits[i].num_bytes(_info);
+        if (nbytes!=stride) stride = 0;
+        _vsplits[i].write(os, _info);
+        offset += nbytes;
+    }
+    os << '\xFF';
+    os << "End of PM\n";
+    const int64_t records_size = offset+1+10; // up to the start of the index
+    write_binary_std(os, V(block_size, _vsplits.num(), stride).view());
+    write_binary_std(os, ArView(records_size));
+    int64_t index_size = 3*4+8;
+    if (!stride) {
+        write_binary_std(os, ArView(block_offsets.num()));
+        write_binary_std(os, CArrayView<int64_t>(block_offsets));
+        index_size += 4+block_offsets.num()*8;
+    }
+    write_binary_std(os, ArView(index_size));
+    os.write(k_index_magic, 8);
+    assertx(os);
+}
+
+void PMesh::write_header_and_base(std::ostream& os) const {
     os << "PM\n";
     os << "version=2\n";
     os << sform("nvsplits=%d nvertices=%d nwedges=%d nfaces=%d\n",
@@ -1418,12 +1519,6 @@ void PMesh::write(std::ostream& os) const {
     if (_info._has_wad2) os << sform("has_wad2=%d\n", _info._has_wad2);
     os << "PM base mesh:\n";
     _base_mesh.write(os, _info);
-    for_int(i, _vsplits.num()) {
-        _vsplits[i].write(os, _info);
-    }
-    os << '\xFF';
-    os << "End of PM\n";
-    assertx(os);
 }
 
 PMeshInfo PMesh::read_header(std::istream& is) {
@@ -1510,12 +1605,78 @@ void PMesh::truncate_prior(PMeshIter& pmi) {
     // really, should update all PMeshRStreams which are open on PMesh.
 }
 
+// *** MappedPMesh
+
+MappedPMesh::MappedPMesh(const string& filename) : _file(make_unique<MappedFile>(filename)) {
+    const char* data = _file->data();
+    const char* footer = assertx(find_index_footer(data, _file->size()));
+    const char* s = footer;
+    int64_t index_size; decode_std(s, ArView(index_size));
+    assertx(index_size>0 && index_size<footer-data);
+    const char* index = footer-index_size;
+    s = index;
+    Vec3<int> ar; decode_std(s, ar.view());
+    _block_size = ar[0]; const int nvsplits = ar[1]; _stride = ar[2];
+    int64_t records_size; decode_std(s, ArView(records_size));
+    assertx(records_size>0 && records_size<=index-data);
+    if (!_stride) {
+        int nblocks; decode_std(s, ArView(nblocks));
+        _block_offsets.init(nblocks);
+        decode_std(s, ArrayView<int64_t>(_block_offsets));
+    }
+    assertx(s==footer);
+    _records = index-records_size;
+    {
+        // The header and base mesh are small; parse them as text.
+        std::istringstream iss(string(data, _records));
+        _info = PMesh::read_header(iss);
+        _base_mesh.read(iss, _info);
+    }
+    assertx(_info._tot_nvsplits==nvsplits);
+    assertx(_block_size>0 && (_stride || _block_offsets.num()==(nvsplits+_block_size-1)/_block_size));
+}
+
+MappedPMesh::~MappedPMesh() {
+}
+
+bool MappedPMesh::is_indexed(const string& filename) {
+    if (file_requires_pipe(filename) || !file_exists(filename)) return false;
+    MappedFile file(filename);
+    return find_index_footer(file.data(), file.size())!=nullptr;
+}
+
+const char* MappedPMesh::record(int i) const {
+    ASSERTX(i>=0 && i<=num_vsplits());
+    if (_stride) return _records+int64_t{i}*_stride;
+    if (i==num_vsplits()) {
+        if (!i) return _records;
+        return skip_record(record(i-1), _info);
+    }
+    const char* s = _records+_block_offsets[i/_block_size];
+    for_int(j, i%_block_size) { s = skip_record(s, _info); }
+    return s;
+}
+
+const char* MappedPMesh::skip_record(const char* s, const PMeshInfo& pminfo) {
+    Vsplit vspl;
+    const char* s2 = s+sizeof(vspl.flclw);
+    decode_std(s2, ArView(vspl.vlr_offset1));
+    decode_std(s2, ArView(vspl.code));
+    return s+vspl.num_bytes(pminfo);
+}
+
 // *** PMeshRStream
 
-PMeshRStream::PMeshRStream(const PMesh& pm) : _is(nullptr), _pm(const_cast<PMesh*>(&pm)) {
+PMeshRStream::PMeshRStream(const PMesh& pm) : _pm(const_cast<PMesh*>(&pm)) {
     _info = _pm->_info;
 }
 
+PMeshRStream::PMeshRStream(const MappedPMesh& mpm, PMesh* ppm_construct) : _mpm(&mpm), _pm(ppm_construct) {
+    _info = _mpm->info();
+    if (_pm) _pm->_info = _info;
+    _mrec = _mpm->record(0);
+}
+
 PMeshRStream::PMeshRStream(std::istream& is, PMesh* ppm_construct) : _is(&is), _pm(ppm_construct) {
     _info = PMesh::read_header(*_is);
     if (_pm) _pm->_info = _info;
@@ -1528,7 +1689,10 @@ PMeshRStream::~PMeshRStream() {
 void PMeshRStream::read_base_mesh(AWMesh* bmesh) {
     assertx(_vspliti==-1);
     _vspliti = 0;
-    if (!_is) {
+    if (_mpm) {
+        if (_pm) _pm->_base_mesh = _mpm->base_mesh();
+        if (bmesh) *bmesh = _mpm->base_mesh();
+    } else if (!_is) {
         if (bmesh) *bmesh = _pm->_base_mesh;
     } else {
         if (!_pm & !bmesh) { Warning("strange, why are we doing this?"); }
@@ -1550,18 +1714,52 @@ const AWMesh& PMeshRStream::base_mesh() {
     return _pm ? _pm->_base_mesh : _lbase_mesh;
 }
 
+bool PMeshRStream::at_source_end() {
+    if (_mpm) return _mreci==_mpm->num_vsplits();
+    assertx(*_is);
+    return PMesh::at_trailer(*_is);
+}
+
+void PMeshRStream::read_source(Vsplit& vspl) {
+    if (_mpm) {
+        vspl.read(_mrec, _info);
+        _mreci++;
+    } else {
+        vspl.read(*_is, _info);
+    }
+}
+
+void PMeshRStream::seek_source(int i) {
+    if (i==_mreci) return;
+    const int block_size = _mpm->block_size();
+    const int iblock = i/block_size;
+    if (iblock!=_mblocki) {
+        // Locate all the records in the block, so that a backward traversal visits each one just once.
+        _mblocki = iblock;
+        _mblock.init(0);
+        const int ib = iblock*block_size;
+        const char* s = _mpm->record(ib);
+        for_intL(j, ib, min(ib+block_size, _mpm->num_vsplits())) {
+            _mblock.push(s);
+            s = MappedPMesh::skip_record(s, _info);
+        }
+        _mblock.push(s);
+    }
+    _mreci = i;
+    _mrec = _mblock[i-iblock*block_size];
+}
+
 const Vsplit* PMeshRStream::peek_next_vsplit() {
     assertx(_vspliti>=0);
     if (_pm) {
         if (_vspliti<_pm->_vsplits.num())
             return &_pm->_vsplits[_vspliti];
-        if (!_is) return nullptr; // end of array
+        if (!_is && !_mpm) return nullptr; // end of array
     } else if (_vspl_ready) {
         // have buffer record
         return &_tmp_vspl;
     }
-    assertx(*_is);
-    if (PMesh::at_trailer(*_is)) return nullptr;
+    if (at_source_end()) return nullptr;
     Vsplit* pvspl;
     if (_pm) {
         if (!_pm->_vsplits.num())
@@ -1572,7 +1770,7 @@ const Vsplit* PMeshRStream::peek_next_vsplit() {
         pvspl = &_tmp_vspl;
         _vspl_ready = true;
     }
-    pvspl->read(*_is, _info);
+    read_source(*pvspl);
     return pvspl;
 }
 
@@ -1583,14 +1781,14 @@ const Vsplit* PMeshRStream::next_vsplit() {
             _vspliti++;
             return &_pm->_vsplits[_vspliti-1];
         }
-        if (!_is) return nullptr; // end of array
+        if (!_is && !_mpm) return nullptr; // end of array
     } else if (_vspl_ready) {
         // use up buffer record
         _vspl_ready = false;
+        _vspliti++;
         return &_tmp_vspl;
     }
-    assertx(*_is);
-    if (PMesh::at_trailer(*_is)) return nullptr;
+    if (at_source_end()) return nullptr;
     Vsplit* pvspl;
     if (_pm) {
         if (!_pm->_vsplits.num()) _pm->_vsplits.reserve(_pm->_info._tot_nvsplits);
@@ -1599,17 +1797,23 @@ const Vsplit* PMeshRStream::next_vsplit() {
         pvspl = &_pm->_vsplits[_vspliti-1];
     } else {
         pvspl = &_tmp_vspl;
+        _vspliti++;
     }
-    pvspl->read(*_is, _info);
+    read_source(*pvspl);
     return pvspl;
 }
 
 const Vsplit* PMeshRStream::prev_vsplit() {
     assertx(_vspliti>=0);
-    assertx(is_reversible());      // die if !_pm
+    assertx(is_reversible());      // die if !_pm && !_mpm
     if (!_vspliti) return nullptr; // end of array
     --_vspliti;
-    return &_pm->_vsplits[_vspliti];
+    if (_pm) return &_pm->_vsplits[_vspliti];
+    // Decode the record again from the mapped file; it is then the peeked next record.
+    seek_source(_vspliti);
+    read_source(_tmp_vspl);
+    _vspl_ready = true;
+    return &_tmp_vspl;
 }
 
 // *** PMeshIter
@@ -1635,12 +1839,12 @@ bool PMeshIter::prev() {
 
 bool PMeshIter::goto_nvertices_ancestry(int nvertices, Ancestry* ancestry) {
     // If have PM and about to go to full mesh, reserve.
-    if (_pmrs._pm) {
-        const PMesh& pm = *_pmrs._pm;
-        if (nvertices>=pm._info._full_nvertices) {
-            _vertices.reserve(pm._info._full_nvertices);
-            _wedges.reserve(pm._info._full_nwedges);
-            _faces.reserve(pm._info._full_nfaces);
+    if (_pmrs._pm || _pmrs._mpm) {
+        const PMeshInfo& pminfo = _pmrs._pm ? _pmrs._pm->_info : _pmrs._info;
+        if (nvertices>=pminfo._full_nvertices) {
+            _vertices.reserve(pminfo._full_nvertices);
+            _wedges.reserve(pminfo._full_nwedges);
+            _faces.reserve(pminfo._full_nfaces);
         }
     }
     for (;;) {
@@ -11,7 +11,7 @@
 
 namespace hh {
 
-class GMesh; class Ancestry; class PMeshIter; struct PMeshInfo;
+class GMesh; class Ancestry; class PMeshIter; struct PMeshInfo; class MappedFile;
 
 // Vertex attributes.
 struct PMVertexAttrib {
@@ -93,7 +93,9 @@ struct WMesh {
 // Records the information necessary to split a vertex of the mesh, to add to the mesh 1 new vertex and 1/2 new faces.
 struct Vsplit {
     void read(std::istream& is, const PMeshInfo& pminfo);
+    void read(const char*& s, const PMeshInfo& pminfo); // decode the record at s in memory, and advance s past it
     void write(std::ostream& os, const PMeshInfo& pminfo) const;
+    int num_bytes(const PMeshInfo& pminfo) const; // size of the record written by write()
     void ok() const;
     bool adds_two_faces() const;
     // This format provides these limits:
@@ -282,32 +284,62 @@ class PMesh : noncopyable {
     // non-progressive read
     void read(std::istream& is); // die unless empty
     void write(std::ostream& os) const;
+    // Same as write(), followed by an index giving the byte offset of every block_size'th vsplit record (or a fixed
+    //  record stride), so that a MappedPMesh can locate records without parsing those before them.
+    void write_indexed(std::ostream& os, int block_size = 1024) const;
     void truncate_beyond(PMeshIter& pmi); // remove all vsplits beyond iterator
     void truncate_prior(PMeshIter& pmi);  // advance base mesh
  public:
     friend class PMeshRStream;
+    friend class MappedPMesh;
     AWMesh _base_mesh;
     Array<Vsplit> _vsplits;
     PMeshInfo _info;
  private:
+    void write_header_and_base(std::ostream& os) const;
     static PMeshInfo read_header(std::istream& is);
     static bool at_trailer(std::istream& is);
     // const AWMesh& base_mesh const { return _base_mesh; }
 };
 
+// Progressive mesh file written by PMesh::write_indexed(), memory-mapped so that its vsplit records are decoded
+//  only when accessed (e.g. by a PMeshRStream) and can be located directly using the index.
+class MappedPMesh : noncopyable {
+ public:
+    explicit MappedPMesh(const string& filename);
+    ~MappedPMesh();
+    static bool is_indexed(const string& filename); // ret: false if not an uncompressed file with an index
+    const PMeshInfo& info() const               { return _info; }
+    const AWMesh& base_mesh() const             { return _base_mesh; }
+    int num_vsplits() const                     { return _info._tot_nvsplits; }
+    int block_size() const                      { return _block_size; }
+    const char* record(int i) const;            // start of encoded vsplit i; fast if i%block_size()==0
+    static const char* skip_record(const char* s, const PMeshInfo& pminfo); // start of the following record
+ private:
+    unique_ptr<MappedFile> _file;
+    PMeshInfo _info;
+    AWMesh _base_mesh;
+    int _block_size;
+    int _stride;                // size of every vsplit record, or 0 if they vary
+    const char* _records;       // start of vsplit 0
+    Array<int64_t> _block_offsets; // if !_stride, offset of vsplit i*_block_size relative to _records
+};
+
 // Progressive mesh stream
 // Can be either:
 //  - read from an existing PMesh, or
 //  - read from an input streamm, or
-//  - read from an input stream and archived to a PMesh
+//  - read from an input stream and archived to a PMesh, or
+//  - read from a MappedPMesh (reversible even without a PMesh), and possibly archived to a PMesh
 class PMeshRStream : noncopyable {
  public:
     explicit PMeshRStream(const PMesh& pm);
     explicit PMeshRStream(std::istream& is, PMesh* ppm_construct = nullptr);
+    explicit PMeshRStream(const MappedPMesh& mpm, PMesh* ppm_construct = nullptr);
     ~PMeshRStream();
     void read_base_mesh(AWMesh* bmesh = nullptr); // always call this first!
     const AWMesh& base_mesh();
-    bool is_reversible() const { return !!_pm; }
+    bool is_reversible() const { return _pm || _mpm; }
     const Vsplit* next_vsplit();
     const Vsplit* prev_vsplit();      // die if !is_reversible()
     const Vsplit* peek_next_vsplit(); // peek without using it
@@ -315,12 +347,21 @@ class PMeshRStream : noncopyable {
  private:
     friend PMeshIter;
     friend PMesh;               // for PMesh::truncate_*()
-    std::istream* _is;          // may be nullptr
+    std::istream* _is {nullptr};        // may be nullptr
+    const MappedPMesh* _mpm {nullptr};  // may be nullptr
     PMesh* _pm;                 // may be nullptr
-    int _vspliti {-1};          // def if _pm, next to read from _pm->_vsplits; -1 before base_mesh is read
+    int _vspliti {-1};          // next to read from _pm->_vsplits (or from _mpm if !_pm); -1 before base_mesh is read
     Vsplit _tmp_vspl;           // def if !_pm
     bool _vspl_ready {false};   // def if !_pm, true if _vspl is only peeked
     AWMesh _lbase_mesh;         // used to store basemesh if !_pm
+    // Position of the next record to decode from _mpm, and the located records of one index block.
+    int _mreci {0};
+    const char* _mrec {nullptr};
+    int _mblocki {-1};
+    Array<const char*> _mblock;
+    bool at_source_end();
+    void read_source(Vsplit& vspl);
+    void seek_source(int i);
 };
 
 // Progressive mesh iterator (is a AWMesh!)
@@ -124,12 +124,12 @@ const int k_omp_min_iterations = 8;              // sufficient number of loop it
 // destruction.  The member function execute(num_tasks, task_function) allows parallel execution of an indexed task,
 // i.e. calling task_function(0), ..., task_function(num_tasks-1) and waiting for all these calls to finish.
 // The function execute() can be called successively on different tasks with low overhead as it reuses the
-// same set of threads.
+// same set of threads.  A smaller number of threads may be requested explicitly.
 class ThreadPoolIndexedTask : noncopyable {
  public:
     using Task = std::function<void(int)>;
-    ThreadPoolIndexedTask() {
-        const int num_threads = get_max_threads();
+    explicit ThreadPoolIndexedTask(int num_threads = get_max_threads()) {
+        assertx(num_threads>=1);
         _threads.reserve(num_threads);
         for_int(i, num_threads) _threads.emplace_back(&ThreadPoolIndexedTask::worker_main, this);
     }
@@ -170,9 +170,9 @@ class ThreadPoolIndexedTask : noncopyable {
     bool _running = true;
     std::vector<std::thread> _threads;
     Task _task_function;
-    int _num_tasks;
+    int _num_tasks = 0;
     int _num_remaining_tasks = 0;
-    int _task_index;
+    int _task_index = 0;
     std::condition_variable _condition_variable_worker;
     std::condition_variable _condition_variable_master;
 
@@ -181,8 +181,8 @@ class ThreadPoolIndexedTask : noncopyable {
         // Consider: https://stackoverflow.com/questions/233127/how-can-i-propagate-exceptions-between-threads
         // However, rethrowing the exception in the main thread loses the stack state, so not useful for debugging.
         while (_running) {
-            // _condition_variable_worker.wait(lock, [this]() { return _task_index<_num_tasks || !_running; });
-            _condition_variable_worker.wait(lock);
+            // The predicate guards against a lost wakeup when execute() is called before this thread first waits.
+            _condition_variable_worker.wait(lock, [this]() { return _task_index<_num_tasks || !_running; });
             for (;;) {
                 if (_task_index==_num_tasks) break;
                 int i = _task_index++;
@@ -0,0 +1,133 @@
+// -*- C++ -*-  Copyright (c) Microsoft Corporation; see license.txt
+#include "PointGraph.h"
+
+#include <algorithm>            // std::nth_element()
+
+#include "Spatial.h"            // StaticPointSpatial
+#include "Parallel.h"           // parallel_for_each()
+#include "RangeOp.h"            // sort(), contains()
+
+namespace hh {
+
+namespace {
+
+const int k_chunk_size = 1<<14; // number of edges or vertices per parallel task
+
+// Union-find over the dense range [0, n), using union by size and path halving.
+class DenseUnionFind {
+ public:
+    explicit DenseUnionFind(int n) : _parent(n), _size(n, 1) { for_int(i, n) { _parent[i] = i; } }
+    int find(int i) {
+        while (_parent[i]!=i) { _parent[i] = _parent[_parent[i]]; i = _parent[i]; }
+        return i;
+    }
+    int find_const(int i) const { while (_parent[i]!=i) i = _parent[i]; return i; } // safe for concurrent callers
+    bool unify(int i, int j) {  // ret: were_different
+        i = find(i); j = find(j);
+        if (i==j) return false;
+        if (_size[i]<_size[j]) std::swap(i, j);
+        _parent[j] = i; _size[i] += _size[j];
+        return true;
+    }
+ private:
+    Array<int> _parent;
+    Array<int> _size;
+};
+
+// Edges satisfying pred, in their original order, selected concurrently.
+template<typename Pred> Array<WEdge> filter_edges(CArrayView<WEdge> edges, Pred pred) {
+    const int nchunks = (edges.num()+k_chunk_size-1)/k_chunk_size;
+    Array<Array<WEdge>> chunks(nchunks);
+    parallel_for_each(range(nchunks), [&](const int ichunk) {
+        for_intL(i, ichunk*k_chunk_size, min((ichunk+1)*k_chunk_size, edges.num())) {
+            if (pred(edges[i])) chunks[ichunk].push(edges[i]);
+        }
+    }, k_chunk_size*uint64_t{10});
+    int num = 0; for (const Array<WEdge>& chunk : chunks) { num += chunk.num(); }
+    Array<WEdge> result; result.reserve(num);
+    for (const Array<WEdge>& chunk : chunks) { result.push_array(chunk); }
+    return result;
+}
+
+void filter_kruskal(Array<WEdge>& edges, int nv, DenseUnionFind& uf, Array<WEdge>& tree) {
+    const int k_base_size = 1<<16;
+    const int k_sample_size = 255;
+    if (tree.num()==nv-1) return; // the forest is already a spanning tree
+    if (edges.num()>k_base_size) {
+        Array<WEdge> sample(k_sample_size);
+        for_int(i, k_sample_size) { sample[i] = edges[int(int64_t{i}*edges.num()/k_sample_size)]; }
+        std::nth_element(sample.begin(), sample.begin()+k_sample_size/2, sample.end(), wedge_less);
+        const WEdge pivot = sample[k_sample_size/2];
+        Array<WEdge> light = filter_edges(edges, [&](const WEdge& e) { return !wedge_less(pivot, e); });
+        if (light.num()<edges.num()) {
+            Array<WEdge> heavy = filter_edges(edges, [&](const WEdge& e) { return wedge_less(pivot, e); });
+            edges.clear();
+            filter_kruskal(light, nv, uf, tree);
+            light.clear();
+            // Discard the heavy edges whose vertices are already connected by the lighter edges.
+            heavy = filter_edges(heavy, [&](const WEdge& e) { return uf.find_const(e.v1)!=uf.find_const(e.v2); });
+            filter_kruskal(heavy, nv, uf, tree);
+            return;
+        }
+    }
+    sort(edges, wedge_less);
+    for (const WEdge& e : edges) {
+        if (!uf.unify(e.v1, e.v2)) continue;
+        tree.push(e);
+        if (tree.num()==nv-1) break;
+    }
+}
+
+} // namespace
+
+Array<WEdge> adjacency_edges(CArrayView<int> nei_beg, CArrayView<int> nei) {
+    const int nv = nei_beg.num()-1;
+    assertx(nv>=0 && nei_beg[nv]==nei.num());
+    auto neighbors = [&](int i) { return nei.slice(nei_beg[i], nei_beg[i+1]); };
+    const int nchunks = (nv+k_chunk_size-1)/k_chunk_size;
+    Array<Array<WEdge>> chunks(nchunks);
+    parallel_for_each(range(nchunks), [&](const int ichunk) {
+        for_intL(i, ichunk*k_chunk_size, min((ichunk+1)*k_chunk_size, nv)) {
+            for (int j : neighbors(i)) {
+                ASSERTX(j>=0 && j<nv);
+                if (j>i) {
+                    chunks[ichunk].push(WEdge{i, j, 0.f});
+                } else if (j<i && !contains(neighbors(j), i)) { // else the edge is entered by vertex j
+                    chunks[ichunk].push(WEdge{j, i, 0.f});
+                }
+            }
+        }
+    }, k_chunk_size*uint64_t{200});
+    int num = 0; for (const Array<WEdge>& chunk : chunks) { num += chunk.num(); }
+    Array<WEdge> edges; edges.reserve(num);
+    for (const Array<WEdge>& chunk : chunks) { edges.push_array(chunk); }
+    return edges;
+}
+
+Array<WEdge> knn_graph_edges(const StaticPointSpatial& sp, CArrayView<Point> pa, int k) {
+    assertx(k>=1);
+    Matrix<int> mid = sp.knn(pa, k+1); // includes the point itself
+    Array<int> nei_beg(pa.num()+1); nei_beg[0] = 0;
+    Array<int> nei; nei.reserve(pa.num()*k);
+    for_int(i, pa.num()) {
+        for (int j : mid[i]) { if (j>=0 && j!=i) nei.push(j); }
+        nei_beg[i+1] = nei.num();
+    }
+    mid.clear();
+    Array<WEdge> edges = adjacency_edges(nei_beg, nei);
+    parallel_for_each(range(edges.num()), [&](const int i) {
+        edges[i].w = dist(pa[edges[i].v1], pa[edges[i].v2]);
+    }, uint64_t{20});
+    return edges;
+}
+
+Array<WEdge> mst_edges(int nv, CArrayView<WEdge> edges) {
+    assertx(nv>=0);
+    DenseUnionFind uf(nv);
+    Array<WEdge> tree;
+    Array<WEdge> ar_edges(edges);
+    filter_kruskal(ar_edges, nv, uf, tree);
+    return tree;
+}
+
+} // namespace hh
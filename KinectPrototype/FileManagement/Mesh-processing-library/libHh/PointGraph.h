@@ -0,0 +1,51 @@
+// -*- C++ -*-  Copyright (c) Microsoft Corporation; see license.txt
+#ifndef MESH_PROCESSING_LIBHH_POINTGRAPH_H_
+#define MESH_PROCESSING_LIBHH_POINTGRAPH_H_
+
+#include "Array.h"
+#include "Geometry.h"
+
+#if 0
+{
+    StaticPointSpatial sp(60, pa);
+    Array<WEdge> edges = knn_graph_edges(sp, pa, 8);
+    Array<WEdge> tree = mst_edges(pa.num(), edges); // an approximate Euclidean MST (exact if connected)
+    SHOW(pa.num()-tree.num());                      // number of connected components
+}
+#endif
+
+namespace hh {
+
+class StaticPointSpatial;
+
+// Graphs on large point sets stored as flat arrays of undirected edges, in contrast to the hashed Graph<T> of
+//  Graph.h and GraphOp.h.  The edge array is built and processed concurrently.
+
+// An undirected weighted edge, with v1<v2.
+struct WEdge {
+    int v1, v2;
+    float w;
+};
+
+// Ordering by increasing weight, with ties broken by the vertex indices (a strict total order on distinct edges).
+inline bool wedge_less(const WEdge& a, const WEdge& b) {
+    return a.w<b.w || (a.w==b.w && (a.v1<b.v1 || (a.v1==b.v1 && a.v2<b.v2)));
+}
+
+// Undirected edges of a graph given by (possibly asymmetric) adjacency lists, each pair appearing once;
+//  the neighbors of vertex i are nei[nei_beg[i]] .. nei[nei_beg[i+1]-1], and self-loops are ignored.
+// The edge weights are left zero.
+Array<WEdge> adjacency_edges(CArrayView<int> nei_beg, CArrayView<int> nei);
+
+// Symmetric k-nearest-neighbor graph of the points pa (which sp must index): each pair (i, j) where j is among the
+//  k closest points of i, or vice versa, weighted by the Euclidean distance.
+Array<WEdge> knn_graph_edges(const StaticPointSpatial& sp, CArrayView<Point> pa, int k);
+
+// Minimum spanning forest of the graph over vertices [0, nv) with the given edges, using the filter-Kruskal
+//  algorithm (parallel partitioning and filtering of the edges about sampled pivots).  The number of connected
+//  components is nv minus the number of returned edges, which are in wedge_less order.
+Array<WEdge> mst_edges(int nv, CArrayView<WEdge> edges);
+
+} // namespace hh
+
+#endif // MESH_PROCESSING_LIBHH_POINTGRAPH_H_
@@ -4,6 +4,8 @@
 
 #include "Hh.h"
 
+#include <mutex>                // mutex, lock_guard
+
 #if 0
 // *.h
 class Polygon {
@@ -47,13 +49,22 @@ namespace hh {
         static int count;                                                     \
     }
 
+// Same as HH_POOL_ALLOCATION_3 but thread-safe; see ConcurrentPool.
+#define HH_CONCURRENT_POOL_ALLOCATION_3(T)                                    \
+    static hh::ConcurrentPool pool;                                           \
+    struct PoolInit {                                                         \
+        PoolInit() { if (!count++) pool.construct(#T, 0, 0); }                \
+        ~PoolInit() { if (!--count) pool.destroy(); }                         \
+        static int count;                                                     \
+    }
+
 #define HH_INITIALIZE_POOL(T) HH_INITIALIZE_POOL_NESTED(T, T)
 
 #define HH_INITIALIZE_POOL_NESTED(T, name)                                    \
     static T::PoolInit pool_init_##name
 
 #define HH_ALLOCATE_POOL(T)                                                   \
-    hh::Pool T::pool;                                                         \
+    decltype(T::pool) T::pool;                                                \
     int T::PoolInit::count
 
 
@@ -86,8 +97,7 @@ class Pool : noncopyable {
     }
     void destroy() {
         assertx(_name);
-        int n = 0;
-        for (Link* p = _h; p; p = p->next) n++;
+        int n = num_free();
         if (sdebug>=2 || (sdebug && _nalloc) || n!=_nalloc)
             showf("Pool %-20s: (size %2d) %6d/%-6d elements outstanding%s\n",
                   _name, _esize, _nalloc-n, _nalloc, (n!=_nalloc ? " **" : ""));
@@ -118,6 +128,7 @@ class Pool : noncopyable {
         // Pool::free(pp);
         Link* p = static_cast<Link*>(pp); p->next = _h; _h = p;
     }
+    int num_outstanding() const { return _nalloc-num_free(); } // elements allocated and not yet freed
  private:
     static constexpr int k_pagesize = 16*1024;   // could refer to getpagesize();
     static constexpr int k_malloc_overhead = 64; // high just to be safe, multiple of 16; was 32
@@ -133,6 +144,7 @@ class Pool : noncopyable {
     int _nalloc;
     int _offset;
     //
+    int num_free() const { int n = 0; for (Link* p = _h; p; p = p->next) n++; return n; }
     void init() {
         // make allocated size a multiple of sizeof(Link)!
         _esize = ((_esize+sizeof(Link)-1)/sizeof(Link))*sizeof(Link);
@@ -171,6 +183,104 @@ class Pool : noncopyable {
     }
 };
 
+
+//----------------------------------------------------------------------------
+
+// Thread-safe variant of Pool (allocation based on size of first alloc_size() call).
+// Each thread allocates from and frees into its own free list; these lists are refilled in batches from a
+//  shared Pool and spill back into it when they grow long, so an element may be freed by a thread other than
+//  the one that allocated it.  A thread's list returns to the shared Pool when the thread exits.
+class ConcurrentPool : noncopyable {
+ public:
+    ConcurrentPool() {
+        // this constructor must be a no-op as it may be called after construct() has been called!
+    }
+    void construct(const char* name, unsigned esize, int ealign) {
+        assertx(!_esize);
+        _pool.construct(name, 0, 0);
+        _esize = esize;
+        _ealign = ealign;
+        std::lock_guard<std::mutex> lg(s_f_mutex());
+        _slot = s_num_slots()++;
+        assertx(_slot<k_max_pools);
+    }
+    void destroy() {
+        // Elements freed by this thread after its exit flush (e.g. by destructors of static objects).
+        spill(thread_caches().caches[_slot], std::numeric_limits<int>::max());
+        _esize = 0;
+        _pool.destroy();
+    }
+    void* alloc() {
+        return alloc_size(_esize, _ealign);
+    }
+    void free(void* p) {
+        free_size(p, _esize);
+    }
+    void* alloc_size(size_t s, int align) {
+        Cache& cache = get_cache();
+        if (!cache.h) refill(cache, s, align);
+        Link* p = cache.h; cache.h = p->next; cache.n--; return p;
+    }
+    void free_size(void* pp, size_t s) {
+        dummy_use(s);
+        Cache& cache = get_cache();
+        Link* p = static_cast<Link*>(pp); p->next = cache.h; cache.h = p;
+        if (++cache.n>2*k_batch) spill(cache, k_batch);
+    }
+    // Elements not in the shared Pool, i.e. in use or held in the free lists of running threads.
+    int num_outstanding() const {
+        std::lock_guard<std::mutex> lg(s_f_mutex());
+        return _pool.num_outstanding();
+    }
+ private:
+    static constexpr int k_max_pools = 16; // maximum number of ConcurrentPool objects in the program
+    static constexpr int k_batch = 64;     // number of elements moved between a thread and the shared Pool
+    struct Link { Link* next; };
+    struct Cache { Link* h; int n; };
+    struct ThreadCaches { ConcurrentPool* pools[k_max_pools]; Cache caches[k_max_pools]; };
+    struct ThreadExit { ~ThreadExit() { flush_thread_caches(); } };
+    Pool _pool;                 // shared; accessed only while holding s_f_mutex()
+    unsigned _esize;
+    int _ealign;
+    int _slot;
+    //
+    static std::mutex& s_f_mutex() { static auto m = new std::mutex; return *m; } // singleton pattern function
+    static int& s_num_slots() { static int n; return n; }
+    // Trivially destructible so that it remains usable by destructors of static objects.
+    static ThreadCaches& thread_caches() { static thread_local ThreadCaches t; return t; }
+    static void flush_thread_caches() {
+        ThreadCaches& t = thread_caches();
+        for_int(i, k_max_pools) {
+            if (t.pools[i]) t.pools[i]->spill(t.caches[i], std::numeric_limits<int>::max());
+        }
+    }
+    Cache& get_cache() {
+        // Register flush_thread_caches() at exit of any thread that allocates or frees (even if it only frees).
+        static thread_local ThreadExit thread_exit;
+        dummy_use(thread_exit);
+        ThreadCaches& t = thread_caches();
+        t.pools[_slot] = this;
+        return t.caches[_slot];
+    }
+    void refill(Cache& cache, size_t s, int align) {
+        std::lock_guard<std::mutex> lg(s_f_mutex());
+        Link** pp = &cache.h;   // preserve the address order of the shared free list, for memory locality
+        for_int(i, k_batch) {
+            Link* p = static_cast<Link*>(_pool.alloc_size(s, align)); *pp = p; pp = &p->next;
+        }
+        *pp = nullptr;
+        cache.n += k_batch;
+    }
+    void spill(Cache& cache, int n) {
+        if (!cache.h) return;
+        std::lock_guard<std::mutex> lg(s_f_mutex());
+        for (; n>0 && cache.h; --n) {
+            Link* p = cache.h; cache.h = p->next; cache.n--;
+            _pool.free(p);
+        }
+    }
+};
+
 } // namespace hh
 
 #endif // MESH_PROCESSING_LIBHH_POOL_H_
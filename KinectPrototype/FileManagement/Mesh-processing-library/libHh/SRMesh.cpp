@@ -1364,6 +1364,20 @@ void SRMesh::extract_gmesh(GMesh& gmesh) const {
     }
 }
 
+void SRMesh::extract_indexed(Array<Point>& points, Array<Vector>& normals, Array<Vec3<int>>& faces) const {
+    points.init(0); normals.init(0); faces.init(0);
+    points.reserve(_num_active_vertices); normals.reserve(_num_active_vertices); faces.reserve(_num_active_faces);
+    Map<const SRAVertex*,int> mvi;
+    for (SRAVertex* va : EList_outer_range(_active_vertices, SRAVertex, activev)) {
+        mvi.enter(va, points.num());
+        points.push(va->vgeom.point);
+        normals.push(va->vgeom.vnormal);
+    }
+    for (SRAFace* fa : EList_outer_range(_active_faces, SRAFace, activef)) {
+        faces.push(V(mvi.get(fa->vertices[0]), mvi.get(fa->vertices[1]), mvi.get(fa->vertices[2])));
+    }
+}
+
 void SRMesh::ok() const {
     Set<const SRAVertex*> setva; {
         for (SRAVertex* va : EList_outer_range(_active_vertices, SRAVertex, activev)) {
@@ -209,6 +209,9 @@ class SRMesh {
     void construct_geomorph(SRGeomorphInfo& geoinfo);
     void extract_gmesh(GMesh& gmesh) const;
     void extract_gmesh(GMesh& gmesh, const SRGeomorphInfo& geoinfo) const;
+    // Extract the active mesh as flat buffers (e.g. to serve it without a GPU): the faces index the active vertices,
+    //  which are numbered contiguously in the order of the active vertex list.
+    void extract_indexed(Array<Point>& points, Array<Vector>& normals, Array<Vec3<int>>& faces) const;
     int num_active_vertices() const             { return _num_active_vertices; }
     int num_active_faces() const                { return _num_active_faces; }
     void ok() const;
@@ -120,7 +120,7 @@ template<typename T> BSac::Func Sac<T>::dfuncs[k_max] = {};
     }                                                                                   \
     static void* operator new[](size_t) = delete;                                       \
     static void operator delete[](void*, size_t) = delete;                              \
-    HH_POOL_ALLOCATION_3(T)
+    HH_CONCURRENT_POOL_ALLOCATION_3(T)
 
 #define HH_SACABLE(T)                                                                       \
     static void sac_construct_##T(void* p) { new(p)T; }                                     \
@@ -1,6 +1,8 @@
 // -*- C++ -*-  Copyright (c) Microsoft Corporation; see license.txt
 #include "Spatial.h"
 
+#include "Parallel.h"           // parallel_for_each()
+
 namespace hh {
 
 // Given 10000 random data points uniformly sampled over the unit cube,
@@ -98,6 +100,97 @@ Univ IPointSpatial::pq_id(Univ id) const {
     return id;
 }
 
+// *** StaticPointSpatial
+
+StaticPointSpatial::StaticPointSpatial(int gn, CArrayView<Point> arp) : Spatial(gn) {
+    assertx(_gn<=k_max_gn);
+    const int ncells = _gn*_gn*_gn;
+    _cellstart.init(ncells+1, 0);
+    Array<int> arcell(arp.num());
+    for_int(i, arp.num()) {
+        Ind ci = point_to_indices(arp[i]); assertx(indices_inbounds(ci));
+        arcell[i] = cell_index(ci);
+        _cellstart[arcell[i]+1]++;
+    }
+    for_int(ic, ncells) { _cellstart[ic+1] += _cellstart[ic]; }
+    Array<int> arnext(_cellstart.head(ncells));
+    _points.init(arp.num()); _ids.init(arp.num());
+    for_int(i, arp.num()) {
+        int j = arnext[arcell[i]]++;
+        _points[j] = arp[i]; _ids[j] = i;
+    }
+}
+
+void StaticPointSpatial::clear() {
+    for_int(ic, _cellstart.num()-1) {
+        int n = _cellstart[ic+1]-_cellstart[ic];
+        if (n) HH_SSTAT(Sstaticcelln, n);
+    }
+    _cellstart.clear(); _points.clear(); _ids.clear();
+}
+
+void StaticPointSpatial::add_cell(const Ind& ci, Pqueue<Univ>& pq, const Point& pcenter, Set<Univ>&) const {
+    int ic = cell_index(ci);
+    for_intL(j, _cellstart[ic], _cellstart[ic+1]) {
+        pq.enter(Conv<int>::e(j), dist2(pcenter, _points[j]));
+    }
+}
+
+Univ StaticPointSpatial::pq_id(Univ pqe) const {
+    return Conv<int>::e(_ids[Conv<int>::d(pqe)]);
+}
+
+// Visit shells of cells of increasing radius around the cell containing p, keeping the k best (dis2, id) pairs
+//  sorted in best, until the distance from p to the boundary of the visited cells exceeds the k'th distance.
+void StaticPointSpatial::knn_point(const Point& p, int k, Array<std::pair<float,int>>& best) const {
+    best.init(0);
+    Ind cc = point_to_indices(p);
+    for (int s = 0; ; s++) {
+        Vec2<Ind> bi; for_int(c, 3) { bi[0][c] = max(cc[c]-s, 0); bi[1][c] = min(cc[c]+s, _gn-1); }
+        for (const Ind& ci : range(bi[0], bi[1]+1)) {
+            if (max_abs_element(ci-cc)!=s) continue; // visited in an earlier shell
+            int ic = cell_index(ci);
+            for_intL(j, _cellstart[ic], _cellstart[ic+1]) {
+                std::pair<float,int> e(dist2(p, _points[j]), _ids[j]);
+                if (best.num()==k) {
+                    if (!(e<best.last())) continue;
+                    best.last() = e;
+                } else {
+                    best.push(e);
+                }
+                for (int i = best.num()-1; i>0 && best[i]<best[i-1]; --i) std::swap(best[i], best[i-1]);
+            }
+        }
+        float disb = BIGFLOAT;  // distance from p to the boundary of the cells visited so far
+        for_int(c, 3) {
+            if (cc[c]-s>0) disb = min(disb, p[c]-index_to_float(cc[c]-s));
+            if (cc[c]+s<_gn-1) disb = min(disb, index_to_float(cc[c]+s+1)-p[c]);
+        }
+        if (disb==BIGFLOAT) break; // all cells visited
+        if (best.num()==k && best.last().first<=square(disb)) break;
+    }
+}
+
+Matrix<int> StaticPointSpatial::knn(CArrayView<Point> pts, int k, Matrix<float>* pdis2) const {
+    assertx(k>=1);
+    Matrix<int> mid(pts.num(), k);
+    if (pdis2) pdis2->init(pts.num(), k);
+    const int chunk_size = 256;
+    const int nchunks = (pts.num()+chunk_size-1)/chunk_size;
+    parallel_for_each(range(nchunks), [&](const int ichunk) {
+        Array<std::pair<float,int>> best;
+        for_intL(i, ichunk*chunk_size, min((ichunk+1)*chunk_size, pts.num())) {
+            knn_point(pts[i], k, best);
+            for_int(j, k) {
+                bool have = j<best.num();
+                mid[i][j] = have ? best[j].second : -1;
+                if (pdis2) (*pdis2)[i][j] = have ? best[j].first : BIGFLOAT;
+            }
+        }
+    }, chunk_size*k*uint64_t{100});
+    return mid;
+}
+
 // *** SpatialSearch
 
 BSpatialSearch::BSpatialSearch(const Spatial* sp, const Point& p, float maxdis)
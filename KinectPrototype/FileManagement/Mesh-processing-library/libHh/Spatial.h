@@ -12,6 +12,7 @@
 #include "Stat.h"
 #include "Bbox.h"
 #include "Vec.h"
+#include "Matrix.h"
 
 namespace hh {
 
@@ -81,6 +82,30 @@ class IPointSpatial : public Spatial {
     Map<int, Array<int>> _map;  // encoded cube index -> Array of point indices
 };
 
+// Read-only spatial data structure for points indexed by an integer, built in bulk.
+// The points are copied into flat arrays sorted by cell, with a dense table of cell offsets, so that searches
+//  access contiguous memory and involve no hashing.  Suited to building once and querying many times (concurrently).
+class StaticPointSpatial : public Spatial {
+ public:
+    StaticPointSpatial(int gn, CArrayView<Point> arp);
+    ~StaticPointSpatial()                       { clear(); }
+    void clear() override;
+    // Find the k closest points to each query point pts[i], concurrently.  Row i of the result lists their indices
+    //  by increasing distance (ties by increasing index), padded with -1 if there are fewer than k points;
+    //  the corresponding squared distances are optionally returned in *pdis2.
+    Matrix<int> knn(CArrayView<Point> pts, int k, Matrix<float>* pdis2 = nullptr) const;
+    // Find the k closest (dis2, index) pairs to the single point p, in the same order; may be called concurrently.
+    void knn_point(const Point& p, int k, Array<std::pair<float,int>>& best) const;
+ private:
+    static constexpr int k_max_gn = 256; // size of the dense cell table
+    void add_cell(const Ind& ci, Pqueue<Univ>& pq, const Point& pcenter, Set<Univ>& set) const override;
+    Univ pq_id(Univ pqe) const override;
+    int cell_index(const Ind& ci) const         { return (ci[0]*_gn+ci[1])*_gn+ci[2]; }
+    Array<int> _cellstart;      // cell_index() -> first entry in _points and _ids; size _gn^3+1
+    Array<Point> _points;       // points sorted by cell
+    Array<int> _ids;            // their indices in the original array
+};
+
 // Spatial data structure for more general objects.
 template<typename Approx2 = float(const Point& p, Univ id), typename Exact2 = float(const Point& p, Univ id)>
 class ObjectSpatial : public Spatial {
@@ -105,6 +130,7 @@ class ObjectSpatial : public Spatial {
 };
 
 // Search for nearest element(s) from a given query point.
+// All search state is held in this object, so multiple searches may run concurrently on the same const Spatial.
 class BSpatialSearch : noncopyable {
  public:
     // pmaxdis is only a request, you may get objects that lie farther
@@ -2,6 +2,8 @@
 #include "Stat.h"
 
 #include <vector>
+#include <atomic>               // std::atomic<>
+#include <mutex>                // std::mutex, std::lock_guard
 
 namespace hh {
 
@@ -9,27 +11,52 @@ class Stats {                   // friend of Stat
  public:
     ~Stats()                                    { if (0) flush(); } // unlikely to come before all static ~Stat()
     void flush() {
-        if (_vecstat.empty()) return;
+        std::vector<Stat*> vecstat;
+        {
+            std::lock_guard<std::mutex> lg(_mutex);
+            merge_shards(nullptr);
+            vecstat.swap(_vecstat);
+        }
+        if (vecstat.empty()) return;
         int ntoprint = 0;
-        for (Stat* stat : _vecstat) {
+        for (Stat* stat : vecstat) {
             if (stat->_print && stat->num()) ntoprint++;
         }
         if (ntoprint) showdf("Summary of statistics:\n");
-        for (Stat* stat : _vecstat) { stat->terminate(); }
-        _vecstat.clear();
+        for (Stat* stat : vecstat) { stat->terminate(); }
+    }
+    // Add the per-thread shards into their static Stat (all of them if stat==nullptr); the shards remain allocated
+    //  since their threads keep pointers to them.  _mutex must be held.
+    void merge_shards(Stat* stat) {
+        for (auto& pair : _shards) {
+            if (!pair.first || (stat && pair.first!=stat)) continue;
+            pair.first->add(*pair.second);
+            pair.second->zero();
+            pair.first = nullptr;
+        }
     }
+    std::mutex _mutex;          // static Stats may be created and sharded in concurrent threads
     std::vector<Stat*> _vecstat; // do not take dependency on Array.h
+    std::vector<std::pair<Stat*, unique_ptr<Stat>>> _shards; // (static Stat, shard of one thread)
 };
 
 namespace {
 
 class Stats_init {
-    Stats* _ptr;                // statically initialized to nullptr
+    std::atomic<Stats*> _ptr;   // statically initialized to nullptr
     bool _post_destruct;        // statically initialized to false
  public:
     // Unusual constructors and destructors to be robust even before or after static lifetime.
-    Stats* get()                                { return !_ptr && !_post_destruct ? (_ptr = new Stats) : _ptr; }
-    ~Stats_init()                               { delete _ptr; _ptr = nullptr; _post_destruct = true; }
+    // The first get() may occur in concurrent threads, so the allocation is published atomically.
+    Stats* get() {
+        Stats* p = _ptr.load(std::memory_order_acquire);
+        if (p || _post_destruct) return p;
+        Stats* pnew = new Stats;
+        if (_ptr.compare_exchange_strong(p, pnew, std::memory_order_acq_rel)) return pnew;
+        delete pnew;
+        return p;
+    }
+    ~Stats_init()                              { delete _ptr.exchange(nullptr); _post_destruct = true; }
 } g_pstats;
 
 } // namespace
@@ -47,6 +74,7 @@ Stat::Stat(string pname, bool pprint, bool is_static) : _name(std::move(pname)),
     }
     if (is_static) {
         if (Stats* pstats = g_pstats.get()) {
+            std::lock_guard<std::mutex> lg(pstats->_mutex);
             pstats->_vecstat.push_back(this);
         } else {
             static int count = 0;
@@ -62,6 +90,7 @@ void swap(Stat& l, Stat& r) noexcept {
     swap(l._name, r._name);
     swap(l._print, r._print);
     swap(l._setrms, r._setrms);
+    swap(l._sharded, r._sharded);
     swap(l._n, r._n);
     swap(l._sum, r._sum);
     swap(l._sum2, r._sum2);
@@ -71,6 +100,13 @@ void swap(Stat& l, Stat& r) noexcept {
 }
 
 void Stat::terminate() {
+    if (_sharded) {
+        _sharded = false;
+        if (Stats* pstats = g_pstats.get()) {
+            std::lock_guard<std::mutex> lg(pstats->_mutex);
+            pstats->merge_shards(this);
+        }
+    }
     if (_print && num()) showdf("%s", name_string().c_str());
     _print = false;
 }
@@ -92,6 +128,16 @@ void Stat::add(const Stat& st) {
     if (st._max>_max) _max = st._max;
 }
 
+Stat* Stat::thread_shard() {
+    if (_pofs) return this;     // the STAT_FILES output cannot be sharded, so assume a single thread
+    Stats* pstats = g_pstats.get();
+    if (!pstats) return this;
+    std::lock_guard<std::mutex> lg(pstats->_mutex);
+    _sharded = true;
+    pstats->_shards.emplace_back(this, make_unique<Stat>());
+    return pstats->_shards.back().second.get();
+}
+
 string Stat::short_string() const {
     float tavg = _n>0 ? avg() : 0.f, tsdv = _n>1 ? sdv() : 0.f, trms = _n>0 ? rms() : 0.f;
     // (on _WIN32, could also use "(%-7I64d)")
@@ -8,7 +8,7 @@
 #if 0
 {
     { HH_STAT(Svdeg); for_int(i, 10) Svdeg.enter(vdeg[i]); }
-    HH_SSTAT(Svanum, va.num());
+    HH_SSTAT(Svanum, va.num());  // may be used concurrently; per-thread values are merged at program end
     SHOW(Stat(V(1., 4., 5., 6.)).sdv());
     // getenv_bool("STAT_FILES") -> store all data values in files.
 }
@@ -37,6 +37,7 @@ class Stat {
     void enter_multiple(float f, int fac); // fac could be negative
     void remove(float f)                        { enter_multiple(f, -1); }
     void add(const Stat& st);
+    Stat* thread_shard();       // for a static Stat: Stat of the current thread, added to this one at program end
     const string& name() const                  { return _name; }
     int64_t num() const                         { return _n; }
     int inum() const                            { return narrow_cast<int>(_n); }
@@ -57,6 +58,7 @@ class Stat {
     string _name;
     bool _print;                // print statistics in destructor
     bool _setrms {false};
+    bool _sharded {false};      // has per-thread shards in Stats
     int64_t _n;
     double _sum;
     double _sum2;
@@ -84,8 +86,13 @@ template<typename R, typename = enable_if_range_t<R> > R standardize_rms(R&& ran
 
 #define HH_STAT(S) hh::Stat S{#S, true}
 #define HH_STATNP(S) hh::Stat S{#S, false} // no print
-#define HH_SSTAT(S, v) do { static hh::Stat S(#S, true, true); S.enter(v); } while (false) // static Stat
-#define HH_SSTAT_RMS(S, v) do { static hh::Stat S(#S, true, true); S.set_rms(); S.enter(v); } while (false)
+// Static Stat; each thread enters values into its own shard, which is added to S at program end.
+#define HH_SSTAT(S, v) do { static hh::Stat S(#S, true, true);                                                  \
+        static thread_local hh::Stat* const S##_shard = S.thread_shard(); S##_shard->enter(v); } while (false)
+// (S.set_rms() is called once, by the thread-safe initialization of a function-local static.)
+#define HH_SSTAT_RMS(S, v) do { static hh::Stat S(#S, true, true); static const bool S##_rms = (S.set_rms(), true); \
+        static thread_local hh::Stat* const S##_shard = (void(S##_rms), S.thread_shard()); S##_shard->enter(v); \
+    } while (false)
 #define HH_RSTAT(S, range) do { HH_STAT(S); for (auto e : range) { S.enter(e); } } while (false) // range Stat
 #define HH_RSTAT_RMS(S, range) do { HH_STAT(S); S.set_rms(); for (auto e : range) { S.enter(e); } } while (false)
 
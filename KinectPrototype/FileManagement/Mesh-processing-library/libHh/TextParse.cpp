@@ -0,0 +1,148 @@
+// -*- C++ -*-  Copyright (c) Microsoft Corporation; see license.txt
+#include "TextParse.h"
+
+#include <cstdlib>              // strtof()
+#include <cstring>              // memchr()
+
+#include "Parallel.h"           // parallel_for_each()
+
+namespace hh {
+
+namespace {
+
+inline bool is_digit(char ch) { return ch>='0' && ch<='9'; }
+
+// Characters which, immediately after a number, indicate a form that the fast path does not handle.
+inline bool continues_number(char ch) {
+    return is_digit(ch) || ch=='.' || (ch>='a' && ch<='z') || (ch>='A' && ch<='Z');
+}
+
+inline const char* skip_blanks(const char* s) {
+    while (*s==' ' || *s=='\t') s++;
+    return s;
+}
+
+// All exactly representable in float.
+const float k_pow10[] = {1e0f, 1e1f, 1e2f, 1e3f, 1e4f, 1e5f, 1e6f, 1e7f, 1e8f, 1e9f, 1e10f};
+const int k_max_pow10 = 10;
+
+} // namespace
+
+bool parse_float(const char*& s, float& f) {
+    const char* beg = skip_blanks(s);
+    const char* p = beg;
+    bool negative = *p=='-';
+    if (*p=='-' || *p=='+') p++;
+    uint32_t m = 0;             // significant digits
+    int nsig = 0, exp10 = 0;
+    bool exact = true, any = false;
+    for (; is_digit(*p); p++) {
+        any = true;
+        if (nsig || *p!='0') {
+            if (nsig<9) { m = m*10+(*p-'0'); nsig++; } else { exact = false; break; }
+        }
+    }
+    if (exact && *p=='.') {
+        for (p++; is_digit(*p); p++) {
+            any = true;
+            if (nsig || *p!='0') {
+                if (nsig<9) { m = m*10+(*p-'0'); nsig++; } else { exact = false; break; }
+            }
+            exp10--;
+        }
+    }
+    if (exact && any && (*p=='e' || *p=='E')) {
+        const char* q = p+1;
+        bool eneg = *q=='-';
+        if (*q=='-' || *q=='+') q++;
+        if (!is_digit(*q)) {
+            exact = false;
+        } else {
+            int e = 0;
+            for (; is_digit(*q); q++) { if (e<10000) e = e*10+(*q-'0'); }
+            exp10 += eneg ? -e : e;
+            p = q;
+        }
+    }
+    if (exact && any && !continues_number(*p) && (m==0 || (m<=(1u<<24) && abs(exp10)<=k_max_pow10))) {
+        // Both operands are exact, so the single rounding gives the correctly rounded result, as strtof() does.
+        float v = float(m);
+        if (exp10<0) v /= k_pow10[-exp10]; else if (exp10>0) v *= k_pow10[exp10];
+        f = negative ? -v : v;
+        s = p;
+        return true;
+    }
+    if (!any) {                 // quickly reject text that cannot be a number
+        const char* q = beg;
+        if (*q=='-' || *q=='+') q++;
+        if (!continues_number(*q)) return false;
+    }
+    char* end;
+    float v = std::strtof(beg, &end);
+    if (end==beg) return false;
+    f = v; s = end;
+    return true;
+}
+
+bool parse_int(const char*& s, int& i) {
+    const char* p = skip_blanks(s);
+    bool negative = *p=='-';
+    if (*p=='-' || *p=='+') p++;
+    int v = 0, ndigits = 0;
+    for (; is_digit(*p); p++) {
+        if (++ndigits>9) return false;
+        v = v*10+(*p-'0');
+    }
+    if (!ndigits || continues_number(*p)) return false;
+    i = negative ? -v : v; s = p;
+    return true;
+}
+
+TextLines::TextLines(std::istream& is) {
+    const size_t k_block = 1<<22;
+    for (;;) {
+        size_t n = _buffer.size();
+        _buffer.resize(n+k_block);
+        is.read(&_buffer[n], k_block);
+        _buffer.resize(n+size_t(is.gcount()));
+        if (!is) break;
+    }
+    index_lines();
+}
+
+TextLines::TextLines(string buffer) : _buffer(std::move(buffer)) {
+    index_lines();
+}
+
+void TextLines::index_lines() {
+    const size_t size = _buffer.size(), k_block = 1<<20;
+    const int nblocks = int((size+k_block-1)/k_block);
+    Array<Array<size_t>> block_ends(nblocks); // positions of '\n'
+    parallel_for_each(range(nblocks), [&](const int iblock) {
+        const char* buf = _buffer.data();
+        size_t i = iblock*k_block, ub = min(i+k_block, size);
+        for (;;) {
+            const char* p = static_cast<const char*>(std::memchr(buf+i, '\n', ub-i));
+            if (!p) break;
+            i = p-buf;
+            block_ends[iblock].push(i++);
+        }
+    }, k_block);
+    if (size && _buffer.back()!='\n') block_ends.last().push(size); // unterminated last line
+    int nlines = 0;
+    for_int(iblock, nblocks) { nlines += block_ends[iblock].num(); }
+    _line_begs.init(nlines+1); _line_ends.init(nlines);
+    _line_begs[0] = 0;
+    int nl = 0; bool dos_eol = false;
+    for_int(iblock, nblocks) {
+        for (size_t i : block_ends[iblock]) {
+            _line_begs[nl+1] = min(i+1, size);
+            bool cr = i>_line_begs[nl] && _buffer[i-1]=='\r';
+            _line_ends[nl++] = cr ? i-1 : i;
+            if (cr) dos_eol = true;
+        }
+    }
+    if (dos_eol) Warning("TextLines: stripping out control-M from DOS file");
+}
+
+} // namespace hh
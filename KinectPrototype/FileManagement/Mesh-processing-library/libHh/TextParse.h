@@ -0,0 +1,57 @@
+// -*- C++ -*-  Copyright (c) Microsoft Corporation; see license.txt
+#ifndef MESH_PROCESSING_LIBHH_TEXTPARSE_H_
+#define MESH_PROCESSING_LIBHH_TEXTPARSE_H_
+
+#include "Array.h"
+
+#if 0
+{
+    TextLines lines(std::cin);  // reads the remainder of the stream
+    Array<float> values(lines.num());
+    parallel_for_each(range(lines.num_chunks()), [&](int ichunk) {
+        for (int i : lines.chunk_lines(ichunk)) {
+            const char* s = lines.line(i); float f;
+            values[i] = parse_float(s, f) ? f : 0.f;
+        }
+    }, TextLines::k_chunk_cycles);
+}
+#endif
+
+namespace hh {
+
+// Parse a number at s (after optional spaces or tabs) and advance s past it; return false (and leave s unchanged)
+//  if there is no number.  The parse is locale-free for ordinary decimal numbers, and the result is identical to
+//  that of sscanf("%g")/strtof(): decimals with few significant digits are converted exactly in float arithmetic,
+//  and other forms (long mantissas, hexadecimal, inf) are passed to strtof().
+bool parse_float(const char*& s, float& f);
+bool parse_int(const char*& s, int& i); // at most 9 digits
+
+// The remainder of a stream read into memory, with its lines indexed (in parallel) for concurrent parsing.
+// Each line is terminated by '\n' (or by the final '\0' of buffer()), so parsing never runs past it.
+class TextLines : noncopyable {
+ public:
+    explicit TextLines(std::istream& is);
+    explicit TextLines(string buffer);
+    const string& buffer() const                { return _buffer; }
+    int num() const                             { return _line_begs.num()-1; }
+    const char* line(int i) const               { return _buffer.data()+_line_begs[i]; }
+    const char* line_end(int i) const           { return _buffer.data()+_line_ends[i]; } // excludes "\n" or "\r\n"
+    size_t line_offset(int i) const             { return _line_begs[i]; }
+    string line_string(int i) const             { return string(line(i), line_end(i)); }
+// Contiguous groups of lines, each worth parsing as one task.
+    static constexpr int k_chunk_size = 4096;
+    static constexpr uint64_t k_chunk_cycles = k_chunk_size*300;
+    int num_chunks() const                      { return (num()+k_chunk_size-1)/k_chunk_size; }
+    details::Range<int> chunk_lines(int ichunk) const {
+        return range(ichunk*k_chunk_size, min((ichunk+1)*k_chunk_size, num()));
+    }
+ private:
+    string _buffer;
+    Array<size_t> _line_begs;   // one extra entry at end
+    Array<size_t> _line_ends;
+    void index_lines();
+};
+
+} // namespace hh
+
+#endif // MESH_PROCESSING_LIBHH_TEXTPARSE_H_
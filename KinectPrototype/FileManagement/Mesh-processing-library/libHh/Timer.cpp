@@ -5,7 +5,10 @@
 #include <cctype>               // std::isdigit()
 #include <array>
 #include <thread>               // std::thread::hardware_concurrency()
-#include <mutex>                // std::once_flag, std::call_once()
+#include <atomic>               // std::atomic<>
+#include <mutex>                // std::once_flag, std::call_once(), std::mutex
+#include <fstream>              // std::ofstream
+#include <limits>               // std::numeric_limits<>
 
 #if defined(_WIN32)
 
@@ -113,6 +116,7 @@ string timing_host() {
 struct Timers {
     ~Timers()                                   { flush(); }
     void flush() {
+        std::lock_guard<std::mutex> lg(_mutex);
         if (_vec_timer_info.empty()) return;
         for (const auto& timer_info : _vec_timer_info) {
             if (timer_info.stat.num()>1) _have_some_mult = true;
@@ -159,6 +163,7 @@ struct Timers {
         _map.clear();
         _vec_timer_info.clear();
     }
+    std::mutex _mutex;          // guards all members
     // Map<string,int> _map; // avoid dependency on Map.h
     std::unordered_map<string,int> _map;
     struct TimerInfo {
@@ -173,26 +178,157 @@ struct Timers {
     bool _have_some_mult {false};
 };
 
+// Spans of each thread are recorded into a buffer owned by Traces, which outlives the thread; the buffer mutex is
+//  uncontended except during a flush.  Each flush appends the buffered spans of all threads to the HH_TRACE file,
+//  which stays open until program end so that spans recorded after an early flush (e.g. in hh_clean_up()) do not
+//  overwrite earlier ones.
+struct Traces {
+    ~Traces() {
+        flush();
+        if (_os) *_os << "\n]\n";
+    }
+    struct Event {
+        string name;
+        int64_t counter_begin;
+        int64_t counter_end;
+    };
+    struct Buffer {
+        int tid;
+        bool named {false};     // thread_name metadata has been written
+        std::mutex mutex;       // guards events
+        std::vector<Event> events;
+    };
+    Buffer* new_buffer() {
+        std::lock_guard<std::mutex> lg(_mutex);
+        _buffers.push_back(make_unique<Buffer>());
+        Buffer* buffer = _buffers.back().get();
+        buffer->tid = narrow_cast<int>(_buffers.size())-1;
+        return buffer;
+    }
+    void flush() {
+        std::lock_guard<std::mutex> lg(_mutex);
+        // Take the events of each buffer, whose thread may still be recording spans.
+        std::vector<std::vector<Event>> vevents(_buffers.size());
+        size_t nevents = 0;
+        for_size_t(i, _buffers.size()) {
+            Buffer& buffer = *_buffers[i];
+            {
+                std::lock_guard<std::mutex> lgb(buffer.mutex);
+                vevents[i].swap(buffer.events);
+            }
+            nevents += vevents[i].size();
+        }
+        if (!nevents || _failed) return;
+        const string filename = getenv_string("HH_TRACE");
+        if (!_os) {
+            // Chrome trace event format (chrome://tracing, https://ui.perfetto.dev): times in microseconds.
+            // The JSON array form is used because its closing bracket is optional, so the file stays valid
+            //  between flushes.
+            _os = make_unique<std::ofstream>(filename);
+            if (!*_os) { Warning("Could not write HH_TRACE file"); _os = nullptr; _failed = true; return; }
+            *_os << "[\n";
+            // Times are relative to the earliest span of the first flush (spans still open then may precede it).
+            _counter_origin = std::numeric_limits<int64_t>::max();
+            for (const auto& events : vevents) {
+                for (const Event& event : events) _counter_origin = std::min(_counter_origin, event.counter_begin);
+            }
+        }
+        std::ostream& os = *_os;
+        const double us_per_counter = get_seconds_per_counter()*1e6;
+        for_size_t(i, _buffers.size()) {
+            Buffer* buffer = _buffers[i].get();
+            if (vevents[i].empty()) continue;
+            if (!buffer->named) {
+                os << (_first ? "" : ",\n")
+                   << sform(R"({"name":"thread_name","ph":"M","pid":0,"tid":%d,"args":{"name":"thread %d"}})",
+                            buffer->tid, buffer->tid);
+                _first = false;
+                buffer->named = true;
+            }
+            for (const Event& event : vevents[i]) {
+                string name;
+                for (char ch : event.name) { if (ch=='"' || ch=='\\') name += '\\'; name += ch; }
+                os << sform(",\n" R"({"name":"%s","ph":"X","pid":0,"tid":%d,"ts":%.3f,"dur":%.3f})",
+                            name.c_str(), buffer->tid, (event.counter_begin-_counter_origin)*us_per_counter,
+                            (event.counter_end-event.counter_begin)*us_per_counter);
+            }
+        }
+        os.flush();
+        showdf("Wrote %lld trace events to '%s'\n", static_cast<long long>(nevents), filename.c_str());
+    }
+    std::mutex _mutex;
+    std::vector<unique_ptr<Buffer>> _buffers; // avoid dependency on Array.h
+    unique_ptr<std::ofstream> _os;              // opened at the first flush that has events
+    bool _failed {false};
+    bool _first {true};                         // no record has been written yet
+    int64_t _counter_origin {0};
+};
+
+class Traces_init {
+    std::atomic<Traces*> _ptr;
+    bool _post_destruct;
+ public:
+    // Unusual constructors and destructors to be robust even before or after static lifetime.
+    // The first get() may occur in concurrent threads, so the allocation is published atomically.
+    Traces* get() {
+        Traces* p = _ptr.load(std::memory_order_acquire);
+        if (p || _post_destruct) return p;
+        Traces* pnew = new Traces;
+        if (_ptr.compare_exchange_strong(p, pnew, std::memory_order_acq_rel)) return pnew;
+        delete pnew;
+        return p;
+    }
+    ~Traces_init()                              { delete _ptr.exchange(nullptr); _post_destruct = true; }
+} g_ptraces;
+
 class Timers_init {
-    Timers* _ptr;
+    std::atomic<Timers*> _ptr;
     bool _post_destruct;
  public:
     // Unusual constructors and destructors to be robust even before or after static lifetime.
-    Timers* get()                               { return !_ptr && !_post_destruct ? (_ptr = new Timers) : _ptr; }
-    ~Timers_init()                              { delete _ptr; _ptr = nullptr; _post_destruct = true; }
+    // The first get() may occur in concurrent threads, so the allocation is published atomically.
+    Timers* get() {
+        Timers* p = _ptr.load(std::memory_order_acquire);
+        if (p || _post_destruct) return p;
+        Timers* pnew = new Timers;
+        if (_ptr.compare_exchange_strong(p, pnew, std::memory_order_acq_rel)) return pnew;
+        delete pnew;
+        return p;
+    }
+    ~Timers_init()                              { delete _ptr.exchange(nullptr); _post_destruct = true; }
 } g_ptimers;
 
 } // namespace
 
-void flush_timers() { if (Timers* ptimers = g_ptimers.get()) ptimers->flush(); }
+void flush_timers() {
+    if (Timers* ptimers = g_ptimers.get()) ptimers->flush();
+    if (Timer::tracing()) {
+        if (Traces* ptraces = g_ptraces.get()) ptraces->flush();
+    }
+}
+
+void record_trace_span(const char* name, int64_t counter_begin, int64_t counter_end) {
+    static thread_local Traces::Buffer* buffer = nullptr;
+    if (!buffer) {
+        Traces* ptraces = g_ptraces.get();
+        if (!ptraces) return;   // beyond the lifetime of Traces
+        buffer = ptraces->new_buffer();
+    }
+    Traces::Event event{name, counter_begin, counter_end};
+    std::lock_guard<std::mutex> lg(buffer->mutex);
+    buffer->events.push_back(std::move(event));
+}
 
 #else
 
 void flush_timers() { }
 
+void record_trace_span(const char*, int64_t, int64_t) { }
+
 #endif  // !defined(HH_NO_TIMERS_CLASS)
 
 int Timer::_s_show = getenv_int("SHOW_TIMES");
+bool Timer::_s_trace = getenv_string("HH_TRACE")!="";
 
 Timer::Timer(string pname, EMode mode) : _name(std::move(pname)), _mode(mode) {
     if (_name!="" && _s_show>=2)
@@ -206,7 +342,10 @@ void Timer::terminate() {
     if (_s_show<0) _mode = EMode::noprint;
     EMode cmode = _mode;
     _mode = EMode::noprint;
-    if (cmode==EMode::possibly || cmode==EMode::noprint || _name=="" || !_ever_started) return;
+    if (cmode==EMode::possibly || cmode==EMode::noprint || _name=="" || !_ever_started) {
+        if (_s_trace && _started) stop(); // record the trace span
+        return;
+    }
     if (!_started) {
         Warning("Timer not restarted");
     } else {
@@ -217,8 +356,8 @@ void Timer::terminate() {
     if (Timers* ptimers = g_ptimers.get()) {
         bool is_new; int i;
         // i = ptimers->_map.enter(_name, narrow_cast<int>(ptimers->_vec_timer_info.size()), is_new); // for hh::Map
+        std::unique_lock<std::mutex> lock(ptimers->_mutex); // Timers may terminate in concurrent threads
         {
-            // Note: not thread-safe.  (I assume that the timers are created outside multi-threading sections.)
             auto p = ptimers->_map.emplace(_name, narrow_cast<int>(ptimers->_vec_timer_info.size()));
             is_new = p.second; i = p.first->second;
         }
@@ -232,6 +371,7 @@ void Timer::terminate() {
         timer_info.sum_real_time += real();
         if (cmode==EMode::abbrev && timer_info.stat.num()>1) return;
         if (cmode==EMode::summary) { ptimers->_have_some_mult = true; return; }
+        lock.unlock();
         static std::once_flag flag;
         std::call_once(flag, [] {
             if (!getenv_bool("NO_DIAGNOSTICS_IN_STDOUT"))
@@ -273,6 +413,7 @@ void Timer::zero() {
     _thread_cpu_time = 0.;
     _process_cpu_time = 0.;
     _real_counter = 0;
+    _trace_counter = 0;
 }
 
 #if defined(_WIN32)
@@ -304,7 +445,9 @@ void Timer::start() {
     assertx(!clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &ti));
     _process_cpu_time -= double(ti.tv_sec)+double(ti.tv_nsec)*1e-9;
 #endif  // defined(_WIN32)
-    _real_counter -= get_precise_counter();
+    const int64_t counter = get_precise_counter();
+    _real_counter -= counter;
+    if (_s_trace) _trace_counter = counter;
 }
 
 void Timer::stop() {
@@ -324,7 +467,9 @@ void Timer::stop() {
     assertx(!clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &ti));
     _process_cpu_time += double(ti.tv_sec)+double(ti.tv_nsec)*1e-9;
 #endif  // defined(_WIN32)
-    _real_counter += get_precise_counter();
+    const int64_t counter = get_precise_counter();
+    _real_counter += counter;
+    if (_s_trace && _name!="") record_trace_span(_name.c_str(), _trace_counter, counter);
 }
 
 double Timer::real() const {
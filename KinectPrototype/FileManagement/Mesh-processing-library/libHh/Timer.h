@@ -15,6 +15,8 @@
     // getenv_int("SHOW_TIMES")==-1 : all -> noprint
     // getenv_int("SHOW_TIMES")==1  : all but noprint -> normal
     Timer::set_show_times(-1);  // disable printing of all timers
+    // getenv_string("HH_TRACE")=="trace.json" : write all named timer intervals and spans to a Chrome trace
+    parallel_for_each(range(n), [&](const int i) { HH_SPAN(item); process(i); }); // per-thread scoped span
 }
 #endif
 
@@ -23,7 +25,8 @@ namespace hh {
 // Object that tracks elapsed time, per-thread computation, and per-process computation over its lifetime.
 // It reports effective multithreading factor (for parallelism defined inside its scope, not outside).
 // Timing data associated with multiple Timers with the same name are accumulated and reported at program end.
-//  (This accumulation is not thread-safe; I assume that the timers are created outside multi-threading sections.)
+//  (This accumulation is thread-safe, but a Timer created inside a parallel loop reports the cpu time of its own
+//  thread.)
 class Timer : noncopyable {
  public:
     enum class EMode { normal, diagnostic, abbrev, summary, possibly, noprint };
@@ -43,6 +46,7 @@ class Timer : noncopyable {
     //
     static int show_times()                     { return _s_show; }
     static void set_show_times(int val)         { _s_show = val; }
+    static bool tracing()                       { return _s_trace; } // getenv_string("HH_TRACE")!=""
  private:
     string _name;
     EMode _mode;
@@ -51,10 +55,31 @@ class Timer : noncopyable {
     double _thread_cpu_time;    // thread  user+system time
     double _process_cpu_time;   // process user+system time
     int64_t _real_counter;
+    int64_t _trace_counter;     // get_precise_counter() at start(), if tracing()
     static int _s_show;
+    static bool _s_trace;
     void zero();
 };
 
+// Record the interval [counter_begin, counter_end) of get_precise_counter() under name in the trace of the
+//  current thread (written at program end).
+void record_trace_span(const char* name, int64_t counter_begin, int64_t counter_end);
+
+// Scoped span of the trace: lighter than a Timer (no cpu times, no summary), so it may be used inside parallel
+//  loops; when tracing is disabled, its only cost is a test of a static flag.
+class TraceSpan : noncopyable {
+ public:
+    explicit TraceSpan(const char* name)        : _name(Timer::tracing() ? name : nullptr) {
+        if (_name) _counter = get_precise_counter();
+    }
+    ~TraceSpan() {
+        if (_name) record_trace_span(_name, _counter, get_precise_counter());
+    }
+ private:
+    const char* _name;
+    int64_t _counter;
+};
+
 #if !defined(HH_NO_TIMERS)
 
 #define HH_TIMER_VAR(id) Timer_##id   // variable name used internally
@@ -66,6 +91,7 @@ class Timer : noncopyable {
 #define HH_STIMER(id)           HH_TIMER_AUX(id, hh::Timer::EMode::summary)
 #define HH_PTIMER(id)           HH_TIMER_AUX(id, hh::Timer::EMode::possibly)
 #define HH_TIMER_END(id)        HH_TIMER_VAR(id).terminate() // terminate a HH_TIMER(id) earlier than its scope
+#define HH_SPAN(id)             hh::TraceSpan TraceSpan_##id(#id)
 
 #else
 
@@ -76,6 +102,7 @@ class Timer : noncopyable {
 #define HH_STIMER(id)           HH_EAT_SEMICOLON
 #define HH_PTIMER(id)           HH_EAT_SEMICOLON
 #define HH_TIMER_END(id)        HH_EAT_SEMICOLON
+#define HH_SPAN(id)             HH_EAT_SEMICOLON
 
 #endif  // !defined(HH_NO_TIMERS)
 
@@ -0,0 +1,232 @@
+// -*- C++ -*-  Copyright (c) Microsoft Corporation; see license.txt
+#include "TriangleBvh.h"
+
+#include <algorithm>            // std::partition()
+
+#include "PArray.h"
+#include "Parallel.h"
+#include "Vector4.h"
+
+namespace hh {
+
+namespace {
+
+constexpr int k_nbins = 16;             // number of centroid bins per axis in the SAH sweep
+constexpr int k_max_leaf = 8;           // a leaf never holds more triangles, even if the SAH prefers it
+constexpr float k_cost_traversal = 1.f; // cost of a node box test relative to a triangle test
+
+float half_area(const Bbox& bbox) {
+    Vector di = bbox[1]-bbox[0];
+    return di[0]*di[1]+di[1]*di[2]+di[2]*di[0];
+}
+
+// Avoid 0.f*inf (NaN) in the slab tests by replacing a zero direction component with a tiny one.
+inline float safe_inverse(float f) { return 1.f/(f ? f : 1e-20f); }
+
+} // namespace
+
+struct TriangleBvh::BuildTri {
+    Bbox bbox;
+    Point centroid;
+    int i;                      // index in the original triangles
+};
+
+void TriangleBvh::build(CArrayView<Vec3<Point>> triangles) {
+    clear();
+    if (!triangles.num()) return;
+    Array<BuildTri> btris(triangles.num());
+    for_int(i, triangles.num()) {
+        const Vec3<Point>& tri = triangles[i];
+        BuildTri& btri = btris[i];
+        btri.bbox.clear(); for_int(j, 3) { btri.bbox.union_with(tri[j]); }
+        btri.centroid = interp(btri.bbox[0], btri.bbox[1]);
+        btri.i = i;
+    }
+    _nodes.reserve(2*triangles.num());
+    _tris.reserve(triangles.num());
+    _tri_index.reserve(triangles.num());
+    build_rec(btris);
+    for (int i : _tri_index) {
+        const Vec3<Point>& tri = triangles[i];
+        _tris.push(Tri{tri[0], tri[1]-tri[0], tri[2]-tri[0]});
+    }
+}
+
+// Create the subtree over btris, whose triangles are reordered; ret: index of its root node.
+int TriangleBvh::build_rec(ArrayView<BuildTri> btris) {
+    const int n = btris.num();
+    const int ni = _nodes.add(1);
+    Bbox bbox; bbox.clear();
+    Bbox cbbox; cbbox.clear();  // bounding box of the centroids
+    for (const BuildTri& btri : btris) { bbox.union_with(btri.bbox); cbbox.union_with(btri.centroid); }
+    _nodes[ni].bbox = bbox;
+    auto func_make_leaf = [&]() {
+        _nodes[ni].axis = 0; _nodes[ni].index = _tri_index.num(); _nodes[ni].ntris = n;
+        for (const BuildTri& btri : btris) { _tri_index.push(btri.i); }
+        return ni;
+    };
+    if (n<=2) return func_make_leaf();
+    // Find the bin boundary (along any axis) minimizing the expected cost of splitting this node.
+    float best_cost = BIGFLOAT; int best_axis = -1; int best_bin = 0;
+    float rarea = 1.f/max(half_area(bbox), 1e-30f);
+    for_int(axis, 3) {
+        float cmin = cbbox[0][axis], cext = cbbox[1][axis]-cmin;
+        if (cext<=0.f) continue;
+        float fbin = k_nbins/cext;
+        Vec<Bbox, k_nbins> bin_bbox; for_int(b, k_nbins) { bin_bbox[b].clear(); }
+        Vec<int, k_nbins> bin_n; fill(bin_n, 0);
+        for (const BuildTri& btri : btris) {
+            int b = min(int((btri.centroid[axis]-cmin)*fbin), k_nbins-1);
+            bin_n[b]++; bin_bbox[b].union_with(btri.bbox);
+        }
+        Vec<float, k_nbins> right_cost; // cost of bins [b, k_nbins) for b>0
+        Bbox bb; bb.clear(); int nr = 0;
+        for (int b = k_nbins-1; b>0; --b) {
+            bb.union_with(bin_bbox[b]); nr += bin_n[b];
+            right_cost[b] = nr ? nr*half_area(bb) : 0.f;
+        }
+        bb.clear(); int nl = 0;
+        for_int(b, k_nbins-1) {
+            bb.union_with(bin_bbox[b]); nl += bin_n[b];
+            if (!nl || nl==n) continue;
+            float cost = k_cost_traversal+(nl*half_area(bb)+right_cost[b+1])*rarea;
+            if (cost<best_cost) { best_cost = cost; best_axis = axis; best_bin = b+1; }
+        }
+    }
+    int nleft;
+    if (best_axis<0) {          // all centroids coincide
+        if (n<=k_max_leaf) return func_make_leaf();
+        nleft = n/2;
+        best_axis = 0;
+    } else {
+        if (best_cost>=float(n) && n<=k_max_leaf) return func_make_leaf();
+        float cmin = cbbox[0][best_axis], fbin = k_nbins/(cbbox[1][best_axis]-cmin);
+        auto it = std::partition(btris.begin(), btris.end(), [&](const BuildTri& btri) {
+            return min(int((btri.centroid[best_axis]-cmin)*fbin), k_nbins-1)<best_bin;
+        });
+        nleft = int(it-btris.begin());
+        assertx(nleft>0 && nleft<n);
+    }
+    _nodes[ni].axis = best_axis; _nodes[ni].ntris = 0;
+    build_rec(btris.head(nleft));
+    int right = build_rec(btris.tail(n-nleft));
+    _nodes[ni].index = right;
+    return ni;
+}
+
+int TriangleBvh::first_along_segment(const Point& p1, const Point& p2, Point& ret_pint) const {
+    if (!_nodes.num()) return -1;
+    Vector dir = p2-p1;
+    Vector idir; for_int(c, 3) { idir[c] = safe_inverse(dir[c]); }
+    float tmax = 1.f;
+    int found = -1;
+    PArray<int, 64> stack;
+    stack.push(0);
+    while (stack.num()) {
+        const Node& node = _nodes[stack.pop()];
+        float tnear = 0.f, tfar = tmax;
+        for_int(c, 3) {
+            float t0 = (node.bbox[0][c]-p1[c])*idir[c], t1 = (node.bbox[1][c]-p1[c])*idir[c];
+            tnear = max(tnear, min(t0, t1)); tfar = min(tfar, max(t0, t1));
+        }
+        if (tnear>tfar) continue;
+        if (!node.ntris) {
+            int inext = int(&node-_nodes.data())+1, ifar = node.index;
+            if (dir[node.axis]<0.f) std::swap(inext, ifar);
+            stack.push(ifar); stack.push(inext);
+            continue;
+        }
+        for_int(i, node.ntris) {
+            // Moller-Trumbore ray-triangle intersection.
+            const Tri& tri = _tris[node.index+i];
+            Vector pvec = cross(dir, tri.e2);
+            float rdet = 1.f/dot(tri.e1, pvec);
+            Vector tvec = p1-tri.p0;
+            float u = dot(tvec, pvec)*rdet;
+            Vector qvec = cross(tvec, tri.e1);
+            float v = dot(dir, qvec)*rdet;
+            float t = dot(tri.e2, qvec)*rdet;
+            // Comparisons are false for NaN (from a degenerate triangle or a segment in its plane).
+            if (u>=0.f && v>=0.f && u+v<=1.f && t>=0.f && t<=tmax) { tmax = t; found = node.index+i; }
+        }
+    }
+    if (found<0) return -1;
+    ret_pint = p1+dir*tmax;
+    return _tri_index[found];
+}
+
+void TriangleBvh::first_along_segments(CArrayView<Vec2<Point>> segments, ArrayView<int> ret_tris,
+                                       ArrayView<Point> ret_pints) const {
+    assertx(ret_tris.num()==segments.num() && ret_pints.num()==segments.num());
+    const int npackets = (segments.num()+3)/4;
+    parallel_for_each(range(npackets), [&](const int ipacket) {
+        int i0 = ipacket*4, n = min(4, segments.num()-i0);
+        intersect_packet(segments.segment(i0, n), ret_tris.segment(i0, n), ret_pints.segment(i0, n));
+    }, 20000);
+}
+
+// Traverse the tree once for up to 4 segments, testing each node box and leaf triangle against all of them
+//  using Vector4 (SIMD) arithmetic.  Each lane holds one segment; unused lanes have tmax<0 so never hit.
+void TriangleBvh::intersect_packet(CArrayView<Vec2<Point>> segments, ArrayView<int> ret_tris,
+                                   ArrayView<Point> ret_pints) const {
+    const int n = segments.num();
+    Vec4<int> found; fill(found, -1);
+    if (!_nodes.num()) { for_int(k, n) { ret_tris[k] = -1; } return; }
+    Vec3<Vec4<float>> aorg, adir, aidir;
+    Vec4<float> atmax;
+    for_int(k, 4) {
+        const Vec2<Point>& seg = segments[min(k, n-1)];
+        Vector dir = seg[1]-seg[0];
+        for_int(c, 3) { aorg[c][k] = seg[0][c]; adir[c][k] = dir[c]; aidir[c][k] = safe_inverse(dir[c]); }
+        atmax[k] = k<n ? 1.f : -1.f;
+    }
+    Vec3<Vector4> org, dir, idir;
+    for_int(c, 3) { org[c] = Vector4(aorg[c]); dir[c] = Vector4(adir[c]); idir[c] = Vector4(aidir[c]); }
+    Vector4 tmax(atmax);
+    const Vector4 zero(0.f), one(1.f);
+    PArray<int, 64> stack;
+    stack.push(0);
+    while (stack.num()) {
+        const Node& node = _nodes[stack.pop()];
+        Vector4 tnear = zero, tfar = tmax;
+        for_int(c, 3) {
+            Vector4 t0 = (Vector4(node.bbox[0][c])-org[c])*idir[c], t1 = (Vector4(node.bbox[1][c])-org[c])*idir[c];
+            tnear = max(tnear, min(t0, t1)); tfar = min(tfar, max(t0, t1));
+        }
+        int mask = 0; for_int(k, 4) { if (tnear[k]<=tfar[k]) mask |= 1<<k; }
+        if (!mask) continue;
+        if (!node.ntris) {
+            int inext = int(&node-_nodes.data())+1, ifar = node.index;
+            int kfirst = mask&1 ? 0 : mask&2 ? 1 : mask&4 ? 2 : 3; // order children for first active segment
+            if (dir[node.axis][kfirst]<0.f) std::swap(inext, ifar);
+            stack.push(ifar); stack.push(inext);
+            continue;
+        }
+        for_int(i, node.ntris) {
+            const Tri& tri = _tris[node.index+i];
+            Vec3<Vector4> e1, e2, tvec, pvec, qvec;
+            for_int(c, 3) { e1[c] = Vector4(tri.e1[c]); e2[c] = Vector4(tri.e2[c]); tvec[c] = org[c]-tri.p0[c]; }
+            for_int(c, 3) {
+                int c1 = mod3(c+1), c2 = mod3(c+2);
+                pvec[c] = dir[c1]*e2[c2]-dir[c2]*e2[c1];
+                qvec[c] = tvec[c1]*e1[c2]-tvec[c2]*e1[c1];
+            }
+            Vector4 rdet = one/(e1[0]*pvec[0]+e1[1]*pvec[1]+e1[2]*pvec[2]);
+            Vector4 u = (tvec[0]*pvec[0]+tvec[1]*pvec[1]+tvec[2]*pvec[2])*rdet;
+            Vector4 v = (dir[0]*qvec[0]+dir[1]*qvec[1]+dir[2]*qvec[2])*rdet;
+            Vector4 t = (e2[0]*qvec[0]+e2[1]*qvec[1]+e2[2]*qvec[2])*rdet;
+            for_int(k, 4) {
+                if (!(mask&(1<<k))) continue;
+                if (u[k]>=0.f && v[k]>=0.f && u[k]+v[k]<=1.f && t[k]>=0.f && t[k]<=tmax[k]) {
+                    tmax[k] = t[k]; found[k] = node.index+i;
+                }
+            }
+        }
+    }
+    for_int(k, n) {
+        ret_tris[k] = found[k]<0 ? -1 : _tri_index[found[k]];
+        if (found[k]>=0) ret_pints[k] = segments[k][0]+(segments[k][1]-segments[k][0])*tmax[k];
+    }
+}
+
+} // namespace hh
@@ -0,0 +1,66 @@
+// -*- C++ -*-  Copyright (c) Microsoft Corporation; see license.txt
+#ifndef MESH_PROCESSING_LIBHH_TRIANGLEBVH_H_
+#define MESH_PROCESSING_LIBHH_TRIANGLEBVH_H_
+
+#include "Bbox.h"
+#include "Array.h"
+
+#if 0
+{
+    Array<Vec3<Point>> triangles;
+    for (Face f : mesh.faces()) {
+        Vec3<Vertex> va; mesh.triangle_vertices(f, va);
+        triangles.push(map(va, [&](Vertex v) { return mesh.point(v); }));
+    }
+    TriangleBvh bvh(triangles);
+    Point pint; int tri = bvh.first_along_segment(p1, p2, pint); // -1 if no intersection
+    Array<Vec2<Point>> segments; ...;
+    Array<int> tris(segments.num()); Array<Point> pints(segments.num());
+    bvh.first_along_segments(segments, tris, pints);
+}
+#endif
+
+namespace hh {
+
+// A bounding volume hierarchy over a static set of triangles, to find the first triangle hit along a segment.
+// The tree is built top-down by minimizing the surface area heuristic (SAH) over binned triangle centroids,
+//  so it adapts to meshes with very uneven triangle sizes (where a uniform grid like PolygonFaceSpatial does not).
+// Batched queries traverse packets of 4 segments together using Vector4 arithmetic and run in parallel.
+// All queries are const and may run concurrently.
+class TriangleBvh : noncopyable {
+ public:
+    TriangleBvh()                               = default;
+    explicit TriangleBvh(CArrayView<Vec3<Point>> triangles) { build(triangles); }
+    void clear()                                { _nodes.clear(); _tris.clear(); _tri_index.clear(); }
+    void build(CArrayView<Vec3<Point>> triangles); // triangles are copied; degenerate ones are never intersected
+    int num() const                             { return _tris.num(); }
+    // Find the first triangle intersected by segment (p1, p2), i.e. closest to p1.
+    // ret: its index in the triangles given to build(), or -1 if there is none (then ret_pint is unchanged).
+    int first_along_segment(const Point& p1, const Point& p2, Point& ret_pint) const;
+    // Same query for each segment (p1, p2) in segments.  Segments adjacent in the array are traversed together,
+    //  so ordering them coherently (similar origins and directions) is faster.
+    void first_along_segments(CArrayView<Vec2<Point>> segments, ArrayView<int> ret_tris,
+                              ArrayView<Point> ret_pints) const;
+ private:
+    struct Node {
+        Bbox bbox;
+        int axis;               // split axis, used to visit the nearer child first
+        int index;              // interior node: index of second child (first child is next node); leaf: first tri
+        int ntris;              // number of triangles in leaf; 0 for interior node
+    };
+    struct Tri {
+        Point p0;
+        Vector e1, e2;          // p1-p0, p2-p0
+    };
+    struct BuildTri;
+    Array<Node> _nodes;         // _nodes[0] is the root
+    Array<Tri> _tris;           // triangles in the order of the leaves
+    Array<int> _tri_index;      // index of each of _tris in the original triangles
+    int build_rec(ArrayView<BuildTri> btris);
+    void intersect_packet(CArrayView<Vec2<Point>> segments, ArrayView<int> ret_tris,
+                          ArrayView<Point> ret_pints) const;
+};
+
+} // namespace hh
+
+#endif // MESH_PROCESSING_LIBHH_TRIANGLEBVH_H_
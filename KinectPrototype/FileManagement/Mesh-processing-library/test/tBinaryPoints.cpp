@@ -0,0 +1,40 @@
+// -*- C++ -*-  Copyright (c) Microsoft Corporation; see license.txt
+#include "BinaryPoints.h"
+
+#include <sstream>              // std::ostringstream
+
+#include "FileIO.h"
+using namespace hh;
+
+int main() {
+    Array<Point> pa; Array<Vector> na;
+    for_int(i, 5) { pa.push(Point(float(i), i*.5f, -1.f)); na.push(Vector(0.f, 0.f, i%2 ? 1.f : -1.f)); }
+    SHOW(BinaryPoints::is_binary_points("nonexistent.bpts"));
+    for (bool with_normals : {false, true}) {
+        TmpFile tmpfile("bpts");
+        {
+            WFile fo(tmpfile.filename());
+            fo() << "# comment line\n";
+            write_binary_points(fo(), pa, with_normals ? CArrayView<Vector>(na) : CArrayView<Vector>(nullptr, 0));
+        }
+        SHOW(BinaryPoints::is_binary_points(tmpfile.filename()));
+        BinaryPoints bpoints(tmpfile.filename());
+        SHOW(bpoints.points()==CArrayView<Point>(pa), bpoints.normals().num());
+        if (with_normals) SHOW(bpoints.normals()==CArrayView<Vector>(na));
+    }
+    {
+        std::ostringstream oss;
+        write_binary_points(oss, pa.head(3), CArrayView<Vector>(nullptr, 0));
+        string s = oss.str();
+        SHOW(s.substr(0, s.find('\n')), s.size());
+        SHOW(BinaryPoints::recognize(s.data(), 40), BinaryPoints::recognize(s.data(), 64)); // header only
+        s.insert(0, "#\n");     // misaligned, so the points are copied
+        BinaryPoints bpoints(s.data(), s.size());
+        SHOW(BinaryPoints::recognize(s.data(), s.size()));
+        SHOW(bpoints.points());
+    }
+    {
+        string s = "p 1 2 3\n";
+        SHOW(BinaryPoints::recognize(s.data(), s.size()));
+    }
+}
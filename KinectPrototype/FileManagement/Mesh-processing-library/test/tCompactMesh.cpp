@@ -0,0 +1,101 @@
+// -*- C++ -*-  Copyright (c) Microsoft Corporation; see license.txt
+#include "CompactMesh.h"
+
+#include <sstream>              // std::ostringstream, std::istringstream
+
+#include "GMesh.h"
+#include "Matrix.h"
+using namespace hh;
+
+namespace {
+
+// Grid of (ny-1)*(nx-1)*2 triangles, with some vertex and face attributes.
+void make_grid(GMesh& mesh, int ny, int nx) {
+    Matrix<Vertex> verts(ny, nx);
+    string str;
+    for_int(y, ny) for_int(x, nx) {
+        Vertex v = mesh.create_vertex();
+        mesh.set_point(v, Point(float(x), float(y), float((x*y)%3)));
+        mesh.update_string(v, "normal", csform_vec(str, V(0.f, 0.f, 1.f)));
+        if (x==y) mesh.update_string(v, "rgb", csform_vec(str, V(1.f, .5f, float(x))));
+        if (x==0 && y==0) mesh.update_string(v, "cusp", "");
+        verts[y][x] = v;
+    }
+    for_int(y, ny-1) for_int(x, nx-1) {
+        Face f1 = mesh.create_face(verts[y][x], verts[y][x+1], verts[y+1][x+1]);
+        Face f2 = mesh.create_face(verts[y][x], verts[y+1][x+1], verts[y+1][x]);
+        mesh.update_string(f1, "matid", csform(str, "%d", x%2));
+        dummy_use(f2);
+    }
+}
+
+string mesh_string(const GMesh& mesh) { std::ostringstream oss; mesh.write(oss); return oss.str(); }
+
+string mesh_string(const CompactMesh& cmesh) { std::ostringstream oss; cmesh.write(oss); return oss.str(); }
+
+} // namespace
+
+int main() {
+    {
+        GMesh mesh;
+        make_grid(mesh, 4, 5);
+        {                       // create a hole and non-contiguous ids
+            Vertex v = mesh.id_vertex(13);
+            for (Face f : Array<Face>(mesh.faces(v))) mesh.destroy_face(f);
+            mesh.destroy_vertex(v);
+        }
+        CompactMesh cmesh(mesh);
+        cmesh.ok();
+        SHOW(cmesh.num_vertices(), cmesh.num_faces(), cmesh.num_edges(), cmesh.num_boundary_edges());
+        assertx(cmesh.num_edges()==mesh.num_edges());
+        int nmismatch = 0;
+        for_int(v, cmesh.num_vertices()) {
+            Vertex gv = mesh.id_vertex(cmesh.vertex_id(v));
+            if (cmesh.degree(v)!=mesh.degree(gv) || cmesh.is_boundary(v)!=mesh.is_boundary(gv)) nmismatch++;
+            // Neighbors in counterclockwise order.
+            Array<int> ar;
+            for (int h = cmesh.vertex_hedge(v), h0 = h; h>=0; ) {
+                ar.push(cmesh.vertex_id(cmesh.vertex2(h)));
+                int hn = cmesh.ccw_hedge(h);
+                if (hn<0) ar.push(cmesh.vertex_id(cmesh.vertex1(CompactMesh::prev(h))));
+                if (hn==h0) break;
+                h = hn;
+            }
+            if (cmesh.vertex_id(v)==8) SHOW(ar);
+        }
+        SHOW(nmismatch);
+        SHOW(cmesh.vertex_flags(0).flag(GMesh::vflag_cusp));
+        for (const CompactMesh::Column& col : cmesh.vertex_columns()) SHOW(col.key, col.dim, col.parens);
+        for (const CompactMesh::Column& col : cmesh.face_columns()) SHOW(col.key, col.dim, col.parens);
+        const CompactMesh::Column* col = cmesh.vertex_column("rgb");
+        SHOW(col->values.slice(0, 3), col->values[3]==CompactMesh::k_missing);
+        string s = mesh_string(mesh);
+        SHOW(mesh_string(cmesh)==s);
+        GMesh mesh2; cmesh.extract_gmesh(mesh2);
+        mesh2.ok();
+        SHOW(mesh_string(mesh2)==s);
+        CompactMesh cmesh2; std::istringstream iss(s); assertx(cmesh2.read(iss));
+        cmesh2.ok();
+        SHOW(mesh_string(cmesh2)==s);
+        SHOW(cmesh2.vertex_flags(0).flag(GMesh::vflag_cusp));
+        SHOW(cmesh2.is_nice());
+    }
+    {
+        CompactMesh cmesh;
+        std::istringstream iss("Vertex 1 0 0 0\nVertex 2 1 0 0\nVertex 3 1 1 0\nVertex 4 0 1 0\nFace 1 1 2 3 4\n");
+        SHOW(cmesh.read(iss), cmesh.num_vertices());
+    }
+    {                           // two triangles touching at vertex 1
+        CompactMesh cmesh;
+        std::istringstream iss("Vertex 1 0 0 0\nVertex 2 1 0 0\nVertex 3 1 1 0\nVertex 4 -1 0 0\n"
+                               "Vertex 5 -1 -1 0\nFace 1 1 2 3\nFace 2 1 4 5\n");
+        SHOW(cmesh.read(iss), cmesh.is_nice());
+    }
+    {
+        GMesh mesh;
+        make_grid(mesh, 100, 100);
+        CompactMesh cmesh(mesh);
+        SHOW(cmesh.memory_usage());
+        SHOW(float(cmesh.memory_usage())/cmesh.num_vertices());
+    }
+}
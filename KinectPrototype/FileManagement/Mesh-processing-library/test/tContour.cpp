@@ -3,6 +3,7 @@
 #include "A3dStream.h"
 #include "FileIO.h"
 #include "MathOp.h"
+#include "RangeOp.h"
 using namespace hh;
 
 namespace {
@@ -96,6 +97,89 @@ void testmesh() {
     mesh.write(fmesh());
 }
 
+Array<Point> sorted_points(const GMesh& mesh) {
+    Array<Point> ar; for (Vertex v : mesh.vertices()) { ar.push(mesh.point(v)); }
+    return sort(std::move(ar), [](const Point& p1, const Point& p2) {
+        return std::lexicographical_compare(p1.begin(), p1.end(), p2.begin(), p2.end());
+    });
+}
+
+void testbrickmesh() {
+    GMesh mesh; {
+        Contour3DMesh<feval3D> contour(10, &mesh); // its summary is the same as that of the bricks
+        contour.set_vertex_tolerance(1e-4f);
+        contour.march_from(Point(.35f, .3f, .3f));
+        contour.march_from(Point(.25f, .65f, .7f));
+    }
+    string smesh1;
+    for (int num_threads : {1, 3}) {
+        GMesh bmesh; {
+            // Bricks of 3^3 cubes, so that the contour crosses many brick faces.
+            BrickContour3DMesh<feval3D> contour(10, &bmesh, feval3D(), num_threads, 3);
+            contour.set_vertex_tolerance(1e-4f);
+            contour.march_from(Point(.35f, .3f, .3f));
+            contour.march_from(Point(.25f, .65f, .7f));
+            int nc = contour.march();
+            SHOW(num_threads, nc);
+        }
+        SHOW(bmesh.num_vertices()==mesh.num_vertices(), bmesh.num_faces()==mesh.num_faces());
+        Array<Point> bpts = sorted_points(bmesh), pts = sorted_points(mesh);
+        float maxd2 = 0.f;
+        for_int(i, min(bpts.num(), pts.num())) { maxd2 = max(maxd2, dist2(bpts[i], pts[i])); }
+        SHOW(maxd2<1e-10f);
+        std::ostringstream oss; bmesh.write(oss);
+        if (num_threads==1) smesh1 = oss.str(); else SHOW(oss.str()==smesh1); // independent of num_threads
+    }
+}
+
+struct feval3D_batch : feval3D {
+    using feval3D::operator();
+    void operator()(CArrayView<Vec3<float>> points, ArrayView<float> vals) const {
+        assertx(vals.num()==points.num());
+        for_int(i, points.num()) { vals[i] = (*this)(points[i]); }
+        _nbatches++; _npoints += points.num();
+    }
+    static int _nbatches, _npoints;
+};
+int feval3D_batch::_nbatches, feval3D_batch::_npoints;
+
+template<typename Contour> void march_two_spheres(Contour& contour) {
+    contour.set_ostream(nullptr);
+    contour.set_vertex_tolerance(1e-4f);
+    contour.march_from(Point(.35f, .3f, .3f));
+    contour.march_from(Point(.25f, .65f, .7f));
+}
+
+void testbatcheval() {
+    string smesh[2];
+    for_int(batch, 2) {
+        GMesh mesh; {
+            if (batch) {
+                Contour3DMesh<feval3D_batch> contour(10, &mesh); march_two_spheres(contour);
+            } else {
+                Contour3DMesh<feval3D> contour(10, &mesh); march_two_spheres(contour);
+            }
+        }
+        std::ostringstream oss; mesh.write(oss); smesh[batch] = oss.str();
+    }
+    SHOW(feval3D_batch::_nbatches>1, feval3D_batch::_npoints);
+    SHOW(smesh[1]==smesh[0]);
+    feval3D_batch::_nbatches = feval3D_batch::_npoints = 0;
+    for_int(batch, 2) {
+        GMesh mesh; {
+            if (batch) {
+                BrickContour3DMesh<feval3D_batch> contour(10, &mesh, feval3D_batch(), 2, 3);
+                march_two_spheres(contour); contour.march();
+            } else {
+                BrickContour3DMesh<feval3D> contour(10, &mesh, feval3D(), 2, 3);
+                march_two_spheres(contour); contour.march();
+            }
+        }
+        std::ostringstream oss; mesh.write(oss); smesh[batch] = oss.str();
+    }
+    SHOW(feval3D_batch::_nbatches>1, feval3D_batch::_npoints);
+    SHOW(smesh[1]==smesh[0]);
+}
 
 struct fmonkey {
     float operator()(const Point& p) const {
@@ -147,6 +231,27 @@ void do_sphere() {
     mesh.write(std::cout);
 }
 
+// Benchmark of the node storage, with each configuration in a separate process so that its peak memory is meaningful:
+//  for gn in 10 100 1000 2000; do for h in 0 1; do CONTOUR_HASHED_NODES=$h CONTOUR_BENCH=$gn tContour; done; done
+void do_bench(int gn) {
+    // Contour3D (without a mesh) of a sphere, so that the node storage dominates memory usage.
+    auto func_sphere = [](const Vec3<float>& p) { return dist(p, V(.5f, .5f, .5f))-.4f; };
+    int ntriangles = 0;
+    auto func_contour = [&](const Array<Vec3<float>>&) { ntriangles++; };
+    size_t mem0 = peak_memory_usage();
+    double time0 = get_precise_time();
+    int ncubes; {
+        Contour3D<decltype(func_sphere), decltype(func_contour)> contour(gn, func_contour, func_sphere);
+        contour.set_ostream(nullptr);
+        ncubes = contour.march_near(Point(.9f, .5f, .5f));
+    }
+    double time = get_precise_time()-time0;
+    size_t mem = peak_memory_usage();
+    showf("gn=%d nodes=%s cubes=%d triangles=%d time=%.3fs cubes/sec=%.3g peak_memory=%.1fMB (+%.1fMB)\n",
+          gn, getenv_bool("CONTOUR_HASHED_NODES") ? "Set" : "blocks", ncubes, ntriangles, time, ncubes/time,
+          mem/1e6, (mem-mem0)/1e6);
+}
+
 } // namespace
 
 int main() {
@@ -166,9 +271,13 @@ int main() {
         do_monkey();
     } else if (getenv_bool("DENSE_MONKEY")) {
         do_densemonkey();
+    } else if (getenv_int("CONTOUR_BENCH")) {
+        do_bench(getenv_int("CONTOUR_BENCH"));
     } else {
         testmesh();
         test2D();
         test3D();
+        testbrickmesh();
+        testbatcheval();
     }
 }
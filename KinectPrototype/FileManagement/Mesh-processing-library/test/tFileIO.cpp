@@ -0,0 +1,39 @@
+// -*- C++ -*-  Copyright (c) Microsoft Corporation; see license.txt
+#include "FileIO.h"
+
+using namespace hh;
+
+namespace {
+
+string read_all(const string& filename, bool need_cfile) {
+    RFile fi(filename, need_cfile);
+    string s, sline;
+    while (my_getline(fi(), sline, false)) { s += sline; s += '\n'; }
+    return s;
+}
+
+} // namespace
+
+int main() {
+    // 200000 lines span several compressed blocks; 800000 lines (about 20 MiB) span more than one parallel batch.
+    for (int n : {0, 3, 200000, 800000}) {
+        string s;
+        for_int(i, n) { s += sform("v %d  %g %g 0\n", i, i*.5f, i*.25f); }
+        TmpFile tmpfile("gz");
+        {
+            WFile fo(tmpfile.filename());
+#if !defined(HH_NO_ZLIB) && !defined(HH_NO_IMAGE_IO) // else the in-process compression is absent
+            SHOW(!fo.cfile());
+#endif
+            fo() << s;
+        }
+        string s1 = read_all(tmpfile.filename(), false);
+        string s2 = read_all(tmpfile.filename(), true); // through a "gzip -d" pipe
+        SHOW(n, s1.size()==s.size(), s1==s, s2==s);
+    }
+    {
+        TmpFile tmpfile("gz");
+        { WFile fo(tmpfile.filename(), true); SHOW(!!fo.cfile()); fo() << "pipe\n"; }
+        SHOW(read_all(tmpfile.filename(), false));
+    }
+}
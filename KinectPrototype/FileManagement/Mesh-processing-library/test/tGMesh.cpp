@@ -1,5 +1,9 @@
 // -*- C++ -*-  Copyright (c) Microsoft Corporation; see license.txt
 #include "GMesh.h"
+
+#include <sstream>              // std::ostringstream, std::istringstream
+
+#include "Timer.h"              // get_precise_time()
 using namespace hh;
 
 namespace {
@@ -33,6 +37,39 @@ void showmesh(GMesh& mesh) {
     SHOW("  } EndFaces\n} EndMesh");
 }
 
+string text_string(const GMesh& mesh) { std::ostringstream oss; mesh.write_text(oss); return oss.str(); }
+
+string binary_string(const GMesh& mesh) { std::ostringstream oss; mesh.write_binary(oss); return oss.str(); }
+
+// Compare the load times of the text and binary formats on an n*n grid with vertex normals.
+void bench_binary(int n) {
+    GMesh mesh;
+    {
+        Array<Vertex> va;
+        string str;
+        for_int(y, n) for_int(x, n) {
+            Vertex v = mesh.create_vertex(); va.push(v);
+            mesh.set_point(v, Point(x*.1f, y*.1f, float((x*y)%7)*.01f));
+            mesh.update_string(v, "normal", csform_vec(str, V(.6f, 0.f, .8f)));
+        }
+        for_int(y, n-1) for_int(x, n-1) {
+            mesh.create_face(va[y*n+x], va[y*n+x+1], va[(y+1)*n+x+1]);
+            mesh.create_face(va[y*n+x], va[(y+1)*n+x+1], va[(y+1)*n+x]);
+        }
+    }
+    string stext = text_string(mesh), sbinary = binary_string(mesh);
+    mesh.clear();
+    for (const string* ps : {&stext, &sbinary}) {
+        std::istringstream iss(*ps);
+        GMesh mesh2;
+        double t0 = get_precise_time();
+        mesh2.read(iss);
+        double t1 = get_precise_time();
+        showf("%s: nf=%d size=%.1fMB read=%.2fs\n", ps==&stext ? "text  " : "binary",
+              mesh2.num_faces(), ps->size()*1e-6, t1-t0);
+    }
+}
+
 } // namespace
 
 int main() {
@@ -89,4 +126,33 @@ int main() {
         // The mesh faces are destroyed in a non-sorted order.
         SHOW(sum_destruct);
     }
+    {
+        // Binary format: round trip against the text format.
+        std::istringstream iss(
+            "Vertex 1  0 0 0 {normal=(0 0 1) rgb=(1 0.5 0) wid=1 tag}\n"
+            "Vertex 2  1 0 0 {rgb=(1 0.5 0) normal=(0 0 1)}\n"
+            "Vertex 3  1 1 0.25 {normal=(0.10 0 1) cusp}\n"
+            "Vertex 5  0 1 1e-7 {uv=(0.25 0.75) mat=\"a b\"}\n"
+            "Vertex 6  2 0.5 0\n"
+            "Face 1  1 2 3 5 {rgb=(0.2 0.3 0.4) matid=3}\n"
+            "Face 3  2 6 3\n"
+            "Edge 2 3 {sharp}\n"
+            "Corner 3 1 {normal=(0 1 0) wid=7}\n"
+            "Corner 2 3 {uv=(1 0)}\n");
+        GMesh mesh; mesh.read(iss);
+        string stext = text_string(mesh), sbinary = binary_string(mesh);
+        std::cout << stext;
+        SHOW(stext.size(), sbinary.size());
+        GMesh mesh2;
+        std::istringstream iss2("# comment\n"+sbinary); mesh2.read(iss2);
+        mesh2.ok();
+        SHOW(text_string(mesh2)==stext);
+        SHOW(mesh2.flags(mesh2.id_vertex(3)).flag(GMesh::vflag_cusp));
+        SHOW(mesh2.flags(mesh2.edge(mesh2.id_vertex(2), mesh2.id_vertex(3))).flag(GMesh::eflag_sharp));
+        std::ostringstream oss; mesh2.write(oss, true);
+        SHOW(oss.str()==sbinary);
+        std::ostringstream oss2; mesh2.write(oss2, false);
+        SHOW(oss2.str()==stext);
+    }
+    if (getenv_int("GMESH_BENCH")) bench_binary(getenv_int("GMESH_BENCH"));
 }
@@ -13,6 +13,7 @@ static unique_ptr<LLS> make_lls(int c, int m, int n, int nd) {
     if (c==3) return make_unique<SvdLLS>(m, n, nd);
     if (c==4) return make_unique<SvdDoubleLLS>(m, n, nd);
     if (c==5) return make_unique<QrdLLS>(m, n, nd);
+    if (c==6) { auto up_lls = make_unique<SparseLLS>(m, n, nd); up_lls->set_preconditioned(true); return up_lls; }
     assertnever("");
 }
 
@@ -87,7 +88,7 @@ int main() {
             b[i] = float(abs(i-4));
             // SHOW(b[i]);
         }
-        for_int(c, 6) {
+        for_int(c, 7) {
             SHOW(c);
             const int nd = 2;
             auto up_lls = make_lls(c, n, n, nd); LLS& lls = *up_lls;
@@ -104,7 +105,7 @@ int main() {
         }
     }
     {
-        for_int(c, 6) {
+        for_int(c, 7) {
             SHOW(c);
             auto up_lls = make_lls(c, 2, 1, 1); LLS& lls = *up_lls;
             lls.enter_a_rc(0, 0, 1.f);
@@ -117,7 +118,7 @@ int main() {
         }
     }
     {
-        for_int(c, 6) {
+        for_int(c, 7) {
             SHOW(c);
             auto up_lls = make_lls(c, 3, 2, 1); LLS& lls = *up_lls;
             lls.enter_a_rc(0, 0, 1.f);
@@ -136,6 +137,30 @@ int main() {
             SHOW(round_fraction_digits(lls.get_x_rc(1, 0)));
         }
     }
+    {
+        // Preconditioned CG on a larger sparse system agrees with CG, in fewer iterations.
+        const int m = 3000, n = 1000, nd = 3;
+        Array<Vec3<int>> cols(m); Array<Vec3<float>> vals(m); Matrix<float> b(m, nd);
+        for_int(i, m) {
+            for_int(k, 3) { cols[i][k] = (i/3+k*(k+1)*7)%n; vals[i][k] = .1f+Random::G.unif()*(i%7==0 ? 20.f : 1.f); }
+            for_int(d, nd) { b[i][d] = Random::G.unif(); }
+        }
+        Matrix<float> x(n, nd);
+        Vec2<int> niter;
+        for_int(ipcg, 2) {
+            SparseLLS lls(m, n, nd);
+            lls.set_preconditioned(ipcg==1);
+            for_int(i, m) { for_int(k, 3) { lls.enter_a_rc(i, cols[i][k], vals[i][k]); } }
+            lls.enter_b(b);
+            bool success = lls.solve();
+            if (ipcg==1) assertx(success);
+            niter[ipcg] = lls.num_iterations();
+            if (ipcg==0) { lls.get_x(x); continue; }
+            float maxdiff = 0.f;
+            for_int(j, n) for_int(d, nd) { maxdiff = max(maxdiff, abs(lls.get_x_rc(j, d)-x[j][d])); }
+            SHOW(maxdiff<1e-4f, niter[1]<niter[0]);
+        }
+    }
     {
         using Real = float;
         for_int(imode, 2) {
@@ -3,6 +3,8 @@
 #include "Matrix.h"
 #include "MeshOp.h"
 #include "Timer.h"
+#include "Parallel.h"
+#include "Random.h"
 using namespace hh;
 
 int main() {
@@ -56,4 +58,39 @@ int main() {
             SHOW(mesh.face_id(f), bary, clp, d2);
         }
     }
+    {
+        // Concurrent searches give the same point-to-face assignments as sequential searches.
+        GMesh mesh;
+        const int n = 30;
+        Matrix<Vertex> matv(n, n);
+        for_int(y, n) for_int(x, n) {
+            matv[y][x] = mesh.create_vertex();
+            mesh.set_point(matv[y][x], Point(x/(n-1.f), y/(n-1.f), .1f*sin(x*.7f)*cos(y*.4f)));
+        }
+        for_int(y, n-1) for_int(x, n-1) {
+            mesh.create_face(matv[y][x], matv[y+1][x], matv[y+1][x+1]);
+            mesh.create_face(matv[y][x], matv[y+1][x+1], matv[y][x+1]);
+        }
+        const int npts = 5000;
+        Array<Point> pts(npts);
+        for_int(i, npts) { for_int(c, 3) { pts[i][c] = Random::G.unif(); } pts[i][2] = (pts[i][2]-.5f)*.3f; }
+        for (bool allow_local_project : {false, true}) {
+            MeshSearch msearch(&mesh, allow_local_project);
+            Array<Face> ar_face(npts), ar_hint(npts); Array<Point> ar_clp(npts);
+            Face hintf = nullptr;
+            for_int(i, npts) {
+                Bary bary; float d2;
+                ar_hint[i] = hintf;
+                ar_face[i] = hintf = msearch.search(pts[i], hintf, bary, ar_clp[i], d2);
+            }
+            Array<Face> par_face(npts); Array<Point> par_clp(npts);
+            parallel_for_each(range(npts), [&](const int i) {
+                Bary bary; float d2;
+                par_face[i] = msearch.search(pts[i], ar_hint[i], bary, par_clp[i], d2);
+            });
+            int nmismatch = 0;
+            for_int(i, npts) { if (par_face[i]!=ar_face[i] || par_clp[i]!=ar_clp[i]) nmismatch++; }
+            SHOW(allow_local_project, nmismatch);
+        }
+    }
 }
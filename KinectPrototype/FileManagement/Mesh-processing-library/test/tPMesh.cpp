@@ -0,0 +1,101 @@
+// -*- C++ -*-  Copyright (c) Microsoft Corporation; see license.txt
+#include "PMesh.h"
+
+#include "FileIO.h"
+#include "Random.h"
+using namespace hh;
+
+namespace {
+
+// Vsplit records with arbitrary (but consistently encoded) contents; they are not applied to a mesh.
+void add_random_vsplits(PMesh& pmesh, int num, bool vary_size, Random& r) {
+    for_int(i, num) {
+        Vsplit vspl;
+        vspl.flclw = int(r.get_unsigned(1u<<20));
+        vspl.vlr_offset1 = short(r.get_unsigned(6));
+        vspl.code = ushort(r.get_unsigned(1u<<14));
+        vspl.code = ushort((vspl.code&~Vsplit::II_MASK) | (r.get_unsigned(3)<<Vsplit::II_SHIFT));
+        if (vary_size && r.get_unsigned(4)==0) vspl.code |= Vsplit::FLN_MASK;
+        vspl.fl_matid = (vspl.code&Vsplit::FLN_MASK) ? ushort(r.get_unsigned(100)) : 0;
+        vspl.fr_matid = 0;
+        for_int(c, 3) { vspl.vad_large.dpoint[c] = r.unif(); vspl.vad_small.dpoint[c] = r.unif(); }
+        vspl.ar_wad.init(vspl.expected_wad_num(pmesh._info));
+        for (PMWedgeAttribD& wad : vspl.ar_wad) {
+            for_int(c, 3) { wad.dnormal[c] = r.unif(); wad.drgb[c] = 0.f; }
+            for_int(c, 2) { wad.duv[c] = pmesh._info._has_uv ? r.unif() : 0.f; }
+        }
+        vspl.resid_uni = r.unif(); vspl.resid_dir = r.unif();
+        pmesh._vsplits.push(std::move(vspl));
+    }
+    pmesh._info._tot_nvsplits = num;
+}
+
+bool same_vsplit(const Vsplit& a, const Vsplit& b) {
+    if (a.flclw!=b.flclw || a.vlr_offset1!=b.vlr_offset1 || a.code!=b.code || a.fl_matid!=b.fl_matid ||
+        a.fr_matid!=b.fr_matid || a.vad_large.dpoint!=b.vad_large.dpoint ||
+        a.vad_small.dpoint!=b.vad_small.dpoint || a.ar_wad.num()!=b.ar_wad.num() ||
+        a.resid_uni!=b.resid_uni || a.resid_dir!=b.resid_dir) return false;
+    for_int(i, a.ar_wad.num()) {
+        if (a.ar_wad[i].dnormal!=b.ar_wad[i].dnormal || a.ar_wad[i].duv!=b.ar_wad[i].duv) return false;
+    }
+    return true;
+}
+
+} // namespace
+
+int main() {
+    Random r(1);
+    for (bool vary_size : {true, false}) {
+        PMesh pmesh;
+        pmesh._info._read_version = 2;
+        pmesh._info._has_rgb = false;
+        pmesh._info._has_uv = vary_size;
+        pmesh._info._has_resid = true;
+        pmesh._info._has_wad2 = !vary_size; // with no face materials, all records then have the same size
+        pmesh._info._full_bbox[0] = Point(0.f, 0.f, 0.f);
+        pmesh._info._full_bbox[1] = Point(1.f, 1.f, 1.f);
+        pmesh._base_mesh._vertices.init(3);
+        for_int(v, 3) { pmesh._base_mesh._vertices[v].attrib.point = Point(float(v==1), float(v==2), 0.f); }
+        pmesh._base_mesh._wedges.init(3);
+        for_int(w, 3) {
+            PMWedge& wedge = pmesh._base_mesh._wedges[w];
+            wedge.vertex = w; wedge.attrib.normal = Vector(0.f, 0.f, 1.f); wedge.attrib.uv = UV(0.f, 0.f);
+        }
+        pmesh._base_mesh._faces.init(1);
+        pmesh._base_mesh._faces[0].wedges = V(0, 1, 2);
+        pmesh._base_mesh._faces[0].attrib.matid = 0;
+        pmesh._base_mesh._materials.set(0, "");
+        add_random_vsplits(pmesh, 5000, vary_size, r);
+        pmesh._info._full_nvertices = 3+pmesh._vsplits.num();
+        pmesh._info._full_nwedges = pmesh._info._full_nvertices;
+        pmesh._info._full_nfaces = 1+pmesh._vsplits.num()*2;
+        TmpFile tmpfile("pm");
+        { WFile fo(tmpfile.filename()); pmesh.write_indexed(fo(), 100); }
+        SHOW(MappedPMesh::is_indexed(tmpfile.filename()));
+        {
+            // The standard reader ignores the index.
+            PMesh pmesh2;
+            { RFile fi(tmpfile.filename()); pmesh2.read(fi()); }
+            int nbad = 0;
+            for_int(i, pmesh._vsplits.num()) { if (!same_vsplit(pmesh._vsplits[i], pmesh2._vsplits[i])) nbad++; }
+            SHOW(pmesh2._vsplits.num(), nbad);
+        }
+        MappedPMesh mpm(tmpfile.filename());
+        SHOW(mpm.num_vsplits(), mpm.base_mesh()._faces.num(), mpm.record(mpm.num_vsplits())-mpm.record(0));
+        PMeshRStream pmrs(mpm);
+        SHOW(pmrs.is_reversible());
+        pmrs.read_base_mesh();
+        int nbad = 0, i = 0;
+        auto check = [&](const Vsplit* vspl, int j) { if (!vspl || !same_vsplit(*vspl, pmesh._vsplits[j])) nbad++; };
+        // Forward into the middle, backward across several blocks, then interleaved peeks and reversals.
+        for (; i<2345; i++) check(pmrs.next_vsplit(), i);
+        for (; i>1111; --i) check(pmrs.prev_vsplit(), i-1);
+        check(pmrs.peek_next_vsplit(), i);
+        check(pmrs.prev_vsplit(), i-1); --i;
+        check(pmrs.peek_next_vsplit(), i);
+        for (; i<pmesh._vsplits.num(); i++) check(pmrs.next_vsplit(), i);
+        SHOW(nbad, !pmrs.next_vsplit(), !pmrs.peek_next_vsplit());
+        for (; i>0; --i) check(pmrs.prev_vsplit(), i-1);
+        SHOW(nbad, !pmrs.prev_vsplit());
+    }
+}
@@ -0,0 +1,56 @@
+// -*- C++ -*-  Copyright (c) Microsoft Corporation; see license.txt
+#include "PointGraph.h"
+
+#include "Spatial.h"
+#include "UnionFind.h"
+#include "Random.h"
+#include "RangeOp.h"            // sort()
+using namespace hh;
+
+namespace {
+
+// Reference Kruskal using a full sort and the hashed UnionFind.
+Array<WEdge> simple_mst(CArrayView<WEdge> pedges) {
+    Array<WEdge> edges(pedges);
+    sort(edges, wedge_less);
+    UnionFind<int> uf;
+    Array<WEdge> tree;
+    for (const WEdge& e : edges) { if (uf.unify(e.v1, e.v2)) tree.push(e); }
+    return tree;
+}
+
+bool same_edges(CArrayView<WEdge> a, CArrayView<WEdge> b) {
+    if (a.num()!=b.num()) return false;
+    for_int(i, a.num()) { if (a[i].v1!=b[i].v1 || a[i].v2!=b[i].v2 || a[i].w!=b[i].w) return false; }
+    return true;
+}
+
+Array<Point> random_points(int n, Random& r) {
+    Array<Point> pa(n);
+    for_int(i, n) { for_int(c, 3) { pa[i][c] = r.unif(); } }
+    return pa;
+}
+
+} // namespace
+
+int main() {
+    {
+        Array<int> nei_beg = {0, 2, 3, 5, 5};
+        Array<int> nei = {1, 2,  0,  0, 2};
+        for (const WEdge& e : adjacency_edges(nei_beg, nei)) SHOW(e.v1, e.v2);
+        Array<WEdge> edges = {{0, 1, 2.f}, {1, 2, 1.f}, {0, 2, 1.f}, {3, 4, 5.f}};
+        Array<WEdge> tree = mst_edges(5, edges);
+        for (const WEdge& e : tree) SHOW(e.v1, e.v2, e.w);
+        SHOW(5-tree.num());
+    }
+    Random r(1);
+    for (int n : {1000, 100000}) {  // the second one exercises the partitioning about pivots
+        Array<Point> pa = random_points(n, r);
+        StaticPointSpatial sp(20, pa);
+        Array<WEdge> edges = knn_graph_edges(sp, pa, 6);
+        int nbad = 0;
+        for (const WEdge& e : edges) { if (!(e.v1<e.v2) || e.w!=dist(pa[e.v1], pa[e.v2])) nbad++; }
+        Array<WEdge> tree = mst_edges(n, edges);
+        SHOW(n, edges.num()>=n*3, nbad, n-tree.num(), same_edges(tree, simple_mst(edges)));
+    }
+}
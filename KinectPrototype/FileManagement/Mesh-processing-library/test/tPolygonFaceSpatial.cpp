@@ -42,6 +42,57 @@ void test2(int pspn) {
     }
 }
 
+// Interleave enter() with segment queries: the grid finds each polygon as soon as it is entered, and the
+//  TriangleBvh finds it after the next build_bvh().  (The grid walk stops at the first cells containing an
+//  intersection, so it may report a polygon that is not the first one along the segment.)
+void test_interleaved() {
+    const int np = 40, nseg = 100;
+    Array<PolygonFace> ar_polyface; ar_polyface.reserve(np);
+    for_int(i, np) {
+        Polygon poly;
+        for_int(j, 3) {
+            Point p; for_int(c, 3) { p[c] = .1f+.8f*Random::G.unif(); }
+            poly.push(p);
+        }
+        ar_polyface.push(PolygonFace(std::move(poly), Face(intptr_t{i})));
+    }
+    Array<Vec2<Point>> segments(nseg);
+    for (auto& segment : segments) { for_int(j, 2) { for_int(c, 3) { segment[j][c] = Random::G.unif(); } } }
+    // Index of the first polygon among the first n along the segment, or -1.
+    auto func_first = [&](int n, const Point& p1, const Point& p2) {
+        int imin = -1; float fmin = BIGFLOAT;
+        for_int(i, n) {
+            Point pint;
+            if (!ar_polyface[i].poly.intersect_segment(p1, p2, pint)) continue;
+            float f = dot(pint-p1, p2-p1);
+            if (f<fmin) { fmin = f; imin = i; }
+        }
+        return imin;
+    };
+    PolygonFaceSpatial psp(10);
+    int nfound = 0, nbad = 0;
+    for_int(i, np) {
+        psp.enter(&ar_polyface[i]);
+        const bool use_bvh = i%10==9;
+        if (use_bvh) psp.build_bvh();
+        for (const auto& segment : segments) {
+            const Point& p1 = segment[0]; const Point& p2 = segment[1];
+            int bi = func_first(i+1, p1, p2);
+            const PolygonFace* polyface; Point pint;
+            bool gfound = psp.first_along_segment(p1, p2, polyface, pint);
+            int gi = gfound ? int(polyface-ar_polyface.data()) : -1;
+            int hi = bi;
+            if (use_bvh) {
+                bool hfound = psp.first_along_segment_bvh(p1, p2, polyface, pint);
+                hi = hfound ? int(polyface-ar_polyface.data()) : -1;
+            }
+            if (bi>=0) nfound++;
+            if ((gi>=0)!=(bi>=0) || gi>i || hi!=bi) { nbad++; SHOW(i, bi, gi, hi); }
+        }
+    }
+    SHOW(nfound, nbad);
+}
+
 } // namespace
 
 int main() {
@@ -79,4 +130,5 @@ int main() {
     }
     test2(5);
     test2(20);
+    test_interleaved();
 }
@@ -1,8 +1,11 @@
 // -*- C++ -*-  Copyright (c) Microsoft Corporation; see license.txt
 #include <cstdio>               // printf()
 #include <cstdlib>              // malloc(), free()
+#include <thread>               // thread; C++11
 
 #include "Pool.h"
+#include "GMesh.h"
+#include "Matrix.h"
 using namespace hh;
 
 #if 0
@@ -44,6 +47,69 @@ class A {
     int e;
 };
 
+unique_ptr<GMesh> build_grid_mesh(int n) {
+    auto mesh = make_unique<GMesh>();
+    Matrix<Vertex> verts(n, n);
+    for_int(y, n) for_int(x, n) {
+        verts[y][x] = mesh->create_vertex();
+        mesh->set_point(verts[y][x], Point(float(x), float(y), 0.f));
+    }
+    for_int(y, n-1) for_int(x, n-1) {
+        mesh->create_face(verts[y][x], verts[y][x+1], verts[y+1][x+1]);
+        mesh->create_face(verts[y][x], verts[y+1][x+1], verts[y+1][x]);
+    }
+    return mesh;
+}
+
+// Build and tear down meshes concurrently; meshes built in one thread are destroyed in another.
+void test_concurrent_meshes() {
+    const int nthreads = 4, niter = 20;
+    Array<unique_ptr<GMesh>> meshes(nthreads);
+    Array<int> checksums(nthreads, 0);
+    {
+        Array<std::thread> threads;
+        for_int(t, nthreads) {
+            threads.push(std::thread([&, t]() {
+                for_int(iter, niter) {
+                    unique_ptr<GMesh> mesh = build_grid_mesh(20+t+iter);
+                    int i = 0;
+                    for (Face f : mesh->ordered_faces()) {
+                        if (i++%3==0) mesh->destroy_face(f);
+                    }
+                    checksums[t] += mesh->num_vertices()+mesh->num_faces()+mesh->num_edges();
+                    if (iter==niter-1) meshes[t] = std::move(mesh);
+                }
+            }));
+        }
+        for (auto& thread : threads) thread.join();
+    }
+    {
+        Array<std::thread> threads;
+        for_int(t, nthreads) {
+            threads.push(std::thread([&, t]() {
+                meshes[(t+1)%nthreads] = nullptr;
+                for_int(iter, niter) checksums[t] += build_grid_mesh(10+iter)->num_faces();
+            }));
+        }
+        for (auto& thread : threads) thread.join();
+    }
+    for_int(t, nthreads) assertx(!meshes[t]);
+    SHOW(checksums);
+}
+
+// A thread that only frees elements (allocated by another thread) returns them to the shared pool at its exit.
+void test_free_only_thread() {
+    static ConcurrentPool cpool;
+    cpool.construct("tPool_free_only", 16, 8);
+    const int n = 100;
+    Array<void*> elements; for_int(i, n) { elements.push(cpool.alloc()); }
+    SHOW(cpool.num_outstanding());
+    std::thread thread([&]() { for (void* p : elements) { cpool.free(p); } });
+    thread.join();
+    SHOW(cpool.num_outstanding());
+    cpool.destroy();
+}
+
 } // namespace
 
 int main() {
@@ -57,4 +123,6 @@ int main() {
         SHOW("make_unique");
         auto pa = make_unique<A>();
     }
+    test_concurrent_meshes();
+    test_free_only_thread();
 }
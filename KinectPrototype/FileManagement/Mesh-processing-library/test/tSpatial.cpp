@@ -1,6 +1,7 @@
 // -*- C++ -*-  Copyright (c) Microsoft Corporation; see license.txt
 #include "Spatial.h"
 #include "Random.h"
+#include "RangeOp.h"          // sort()
 using namespace hh;
 
 int main() {
@@ -51,4 +52,27 @@ int main() {
         }
         assertx(i==n);
     }
+    {
+        const int n = 2000, k = 7;
+        Array<Point> arpts(n); for_int(i, n) { for_int(c, 3) { arpts[i][c] = Random::G.unif(); } }
+        StaticPointSpatial sp(12, arpts);
+        PointSpatial<int> psp(12); for_int(i, n) { psp.enter(i, &arpts[i]); }
+        Array<Point> arq(300); for_int(i, arq.num()) { for_int(c, 3) { arq[i][c] = Random::G.unif(); } }
+        Matrix<float> mdis2;
+        Matrix<int> mknn = sp.knn(arq, k, &mdis2);
+        int nmismatch = 0, nsearch_mismatch = 0;
+        for_int(i, arq.num()) {
+            Array<std::pair<float,int>> ar; for_int(j, n) { ar.push({dist2(arq[i], arpts[j]), j}); }
+            sort(ar);
+            for_int(j, k) { if (mknn[i][j]!=ar[j].second || mdis2[i][j]!=ar[j].first) nmismatch++; }
+            SpatialSearch<int> ss(&sp, arq[i]), pss(&psp, arq[i]);
+            for_int(j, k) {
+                float d1, d2; ss.next(&d1); pss.next(&d2);
+                if (d1!=ar[j].first || d2!=ar[j].first) nsearch_mismatch++;
+            }
+        }
+        SHOW(nmismatch, nsearch_mismatch);
+        Matrix<int> mknn2 = StaticPointSpatial(12, arpts.head(3)).knn(arq.head(2), 5);
+        SHOW(mknn2);
+    }
 }
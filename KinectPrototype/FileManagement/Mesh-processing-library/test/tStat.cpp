@@ -2,6 +2,7 @@
 #include "Stat.h"
 #include "Array.h"
 #include "Vec.h"
+#include "Parallel.h"
 using namespace hh;
 
 // Optionally, run with:    rm -f Stat.tStat; (setenv STAT_FILES; tStat); cat Stat.tStat
@@ -48,5 +49,8 @@ int main() {
         SHOW(Stat(V(1., 4., 5., 6.)).short_string());
         SHOW(Stat(V(1., 4., 5., 6.)).sdv());
     }
+    {
+        parallel_for_each(range(10000), [](const int i) { HH_SSTAT(Sconcurrent, i%10); });
+    }
     hh_clean_up();
 }
@@ -0,0 +1,77 @@
+// -*- C++ -*-  Copyright (c) Microsoft Corporation; see license.txt
+#include "TextParse.h"
+
+#include <cstdlib>              // strtof()
+#include <sstream>              // std::istringstream
+
+#include "Random.h"
+using namespace hh;
+
+namespace {
+
+// Compare parse_float() with strtof() on a string; return true if they agree.
+bool same_as_strtof(const string& str) {
+    const char* s = str.c_str();
+    float f = -1.f;
+    bool success = parse_float(s, f);
+    char* end; float f2 = std::strtof(str.c_str(), &end);
+    if (!success) return end==str.c_str();
+    if (s!=end || f!=f2) { SHOW(str, f, f2, s-str.c_str(), end-str.c_str()); return false; }
+    return true;
+}
+
+} // namespace
+
+int main() {
+    {
+        for (const char* str : {"0", "-0", "1", " 2.5", "\t-3.25e2", "+.5", "5.", "1e-07", "1E5", "0.740241",
+                                "123456789012", "0.1234567890123", "3e38", "0x1p3", "-",
+                                ".", "e5", "{", "", "1.5x", "7 8"}) {
+            const char* s = str; float f = -1.f;
+            bool success = parse_float(s, f);
+            SHOW(str, success, f, s-str, same_as_strtof(str));
+        }
+        for (const char* str : {"12", "-7", " +3", "1234567890", "1.5", "x", "8}"}) {
+            const char* s = str; int i = -1;
+            bool success = parse_int(s, i);
+            SHOW(str, success, i, s-str);
+        }
+    }
+    {
+        Random r(1);
+        int nmismatch = 0;
+        string str;
+        for_int(i, 100000) {
+            float f = r.unif()*2.f-1.f;
+            if (i%4==1) f *= 1000.f;
+            if (i%4==2) f *= 1e-5f;
+            const char* format = i%3==0 ? "%g" : i%3==1 ? "%.9g" : "%.4f";
+            if (!same_as_strtof(csform(str, format, f))) nmismatch++;
+        }
+        SHOW(nmismatch);
+    }
+    {
+        std::istringstream iss("# comment\r\nVertex 1  0 0 0\n\nFace 1  1 2 3\nlast");
+        TextLines lines(iss);
+        SHOW(lines.num(), lines.num_chunks());
+        for_int(i, lines.num()) { SHOW(lines.line_string(i), lines.line_offset(i)); }
+        std::istringstream iss2("");
+        SHOW(TextLines(iss2).num());
+    }
+    {
+        string s;
+        for_int(i, 10000) { s += sform("p %d %g 0\n", i, i*.5f); }
+        TextLines lines(s);
+        SHOW(lines.num(), lines.num_chunks());
+        float sum = 0.f;
+        for_int(ichunk, lines.num_chunks()) {
+            for (int i : lines.chunk_lines(ichunk)) {
+                const char* p = lines.line(i)+1; Vec3<float> f;
+                for_int(c, 3) { assertx(parse_float(p, f[c])); }
+                assertx(p==lines.line_end(i));
+                sum += f[1];
+            }
+        }
+        SHOW(sum);
+    }
+}
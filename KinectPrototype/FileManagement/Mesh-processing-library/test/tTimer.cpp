@@ -1,5 +1,6 @@
 // -*- C++ -*-  Copyright (c) Microsoft Corporation; see license.txt
 #include "Timer.h"
+#include "Parallel.h"
 using namespace hh;
 
 int main() {
@@ -22,4 +23,5 @@ int main() {
         HH_TIMER(t7);
     }
     { HH_DTIMER(t8); }
+    parallel_for_each(range(100), [](const int) { HH_STIMER(tconcurrent); HH_SPAN(span); });
 }
@@ -0,0 +1,97 @@
+// -*- C++ -*-  Copyright (c) Microsoft Corporation; see license.txt
+#include "TriangleBvh.h"
+
+#include "MeshSearch.h"         // PolygonFaceSpatial
+#include "Polygon.h"
+#include "Random.h"
+using namespace hh;
+
+namespace {
+
+// Reference result by testing every triangle.
+int brute_first_along_segment(CArrayView<Vec3<Point>> triangles, const Point& p1, const Point& p2,
+                              Point& ret_pint) {
+    int found = -1; float fmin = BIGFLOAT;
+    for_int(i, triangles.num()) {
+        Polygon poly(V(triangles[i][0], triangles[i][1], triangles[i][2]));
+        Point pint;
+        if (!poly.intersect_segment(p1, p2, pint)) continue;
+        float f = dist2(p1, pint);
+        if (f<fmin) { fmin = f; found = i; ret_pint = pint; }
+    }
+    return found;
+}
+
+// Many small triangles in a corner plus a few large ones, like a detailed scan on a flat base.
+Array<Vec3<Point>> uneven_triangles(Random& r) {
+    Array<Vec3<Point>> triangles;
+    for_int(i, 400) {
+        Point p; for_int(c, 3) { p[c] = .1f+.1f*r.unif(); }
+        Vec3<Point> tri; for_int(j, 3) { for_int(c, 3) { tri[j][c] = p[c]+.02f*r.unif(); } }
+        triangles.push(tri);
+    }
+    for_int(i, 20) {
+        Vec3<Point> tri; for_int(j, 3) { for_int(c, 3) { tri[j][c] = .05f+.9f*r.unif(); } }
+        triangles.push(tri);
+    }
+    return triangles;
+}
+
+} // namespace
+
+int main() {
+    {
+        Array<Vec3<Point>> triangles;
+        triangles.push(V(Point(.2f, .2f, .2f), Point(.2f, .8f, .8f), Point(.2f, .8f, .2f)));
+        triangles.push(V(Point(.8f, .2f, .2f), Point(.8f, .8f, .8f), Point(.8f, .8f, .2f)));
+        TriangleBvh bvh(triangles);
+        SHOW(bvh.num());
+        Point pint;
+        SHOW(bvh.first_along_segment(Point(.1f, .5f, .3f), Point(.9f, .5f, .3f), pint), pint);
+        SHOW(bvh.first_along_segment(Point(.9f, .5f, .3f), Point(.1f, .5f, .3f), pint), pint);
+        SHOW(bvh.first_along_segment(Point(.3f, .5f, .3f), Point(.7f, .5f, .3f), pint));
+        SHOW(bvh.first_along_segment(Point(.1f, .1f, .3f), Point(.9f, .1f, .3f), pint));
+    }
+    {
+        Random r(7);
+        Array<Vec3<Point>> triangles = uneven_triangles(r);
+        TriangleBvh bvh(triangles);
+        Array<PolygonFace> ar_polyface;
+        for_int(i, triangles.num()) {
+            ar_polyface.push(PolygonFace(Polygon(V(triangles[i][0], triangles[i][1], triangles[i][2])),
+                                         Face(intptr_t{i})));
+        }
+        PolygonFaceSpatial psp(20);
+        for (const PolygonFace& polyface : ar_polyface) { psp.enter(&polyface); }
+        psp.build_bvh();
+        const int nseg = 1000;
+        Array<Vec2<Point>> segments(nseg);
+        for_int(i, nseg) {
+            for_int(j, 2) { for_int(c, 3) { segments[i][j][c] = i%2 ? r.unif() : .08f+.15f*r.unif(); } }
+        }
+        Array<int> tris(nseg); Array<Point> pints(nseg);
+        bvh.first_along_segments(segments, tris, pints);
+        int nfound = 0, nbad = 0;
+        for_int(i, nseg) {
+            const Point& p1 = segments[i][0]; const Point& p2 = segments[i][1];
+            Point bpint; int bi = brute_first_along_segment(triangles, p1, p2, bpint);
+            Point spint; int si = bvh.first_along_segment(p1, p2, spint);
+            const PolygonFace* polyface = nullptr; Point gpint;
+            bool gfound = psp.first_along_segment_bvh(p1, p2, polyface, gpint);
+            int gi = gfound ? int(polyface-ar_polyface.data()) : -1;
+            if (bi>=0) nfound++;
+            if (si!=bi || tris[i]!=bi || gi!=bi ||
+                (bi>=0 && max({dist(spint, bpint), dist(pints[i], bpint), dist(gpint, bpint)})>1e-5f)) {
+                nbad++; SHOW(i, bi, si, tris[i], gi);
+            }
+        }
+        SHOW(nseg, nfound, nbad);
+    }
+    {
+        Array<Vec2<Point>> segments(3, V(Point(0.f, 0.f, 0.f), Point(1.f, 1.f, 1.f)));
+        Array<int> tris(3); Array<Point> pints(3);
+        TriangleBvh bvh;
+        bvh.first_along_segments(segments, tris, pints);
+        SHOW(tris);
+    }
+}